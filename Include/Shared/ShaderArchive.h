@@ -0,0 +1,76 @@
+#pragma once
+#include "ShaderIncludes.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// every permutation's SPIR-V packed into one file by ShaderBuilder
+// header, then an entry table sorted by ShaderKey, then the blobs, each starting on a ShaderArchiveAlignment boundary
+const uint32_t ShaderArchiveMagic = 0x4B415053; // "SPAK"
+const uint32_t ShaderArchiveVersion = 1;
+const uint64_t ShaderArchiveAlignment = 8;
+const char* const ShaderArchiveName = "Shaders.pack";
+
+struct ShaderArchiveHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t reserved;
+};
+
+struct ShaderArchiveEntry
+{
+  ShaderKey key;
+  uint32_t reserved;
+  // from the start of the archive
+  uint64_t offset;
+  uint64_t size;
+  // ShaderContentHash of the blob
+  uint64_t hash;
+};
+
+static_assert(sizeof(ShaderArchiveHeader) == 16 && sizeof(ShaderArchiveEntry) == 32, "archive layout is written as is");
+
+// 64 bit FNV-1a, chain calls by passing the previous hash as seed
+inline uint64_t ShaderContentHash(const void* data, size_t size, uint64_t seed = 0xCBF29CE484222325ull)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    seed ^= bytes[i];
+    seed *= 0x100000001B3ull;
+  }
+  return seed;
+}
+
+// null if the archive is malformed
+inline const ShaderArchiveEntry* GetShaderArchiveEntries(const void* archive, size_t size)
+{
+  if (size < sizeof(ShaderArchiveHeader))
+    return nullptr;
+  const ShaderArchiveHeader* header = static_cast<const ShaderArchiveHeader*>(archive);
+  if (header->magic != ShaderArchiveMagic || header->version != ShaderArchiveVersion)
+    return nullptr;
+  if (size < sizeof(ShaderArchiveHeader) + uint64_t(header->entryCount) * sizeof(ShaderArchiveEntry))
+    return nullptr;
+
+  const ShaderArchiveEntry* entries = reinterpret_cast<const ShaderArchiveEntry*>(header + 1);
+  for (uint32_t i = 0; i < header->entryCount; ++i)
+  {
+    if (entries[i].offset > size || entries[i].size > size - entries[i].offset || entries[i].offset % ShaderArchiveAlignment)
+      return nullptr;
+    if (i && entries[i - 1].key >= entries[i].key)
+      return nullptr;
+  }
+  return entries;
+}
+
+// binary search over the sorted entry table, null if the key is not in it
+inline const ShaderArchiveEntry* FindShaderArchiveEntry(const ShaderArchiveEntry* entries, uint32_t entryCount, ShaderKey key)
+{
+  const ShaderArchiveEntry* end = entries + entryCount;
+  const ShaderArchiveEntry* entry = std::lower_bound(entries, end, key, [](const ShaderArchiveEntry& a, ShaderKey b) { return a.key < b; });
+  return entry != end && entry->key == key ? entry : nullptr;
+}
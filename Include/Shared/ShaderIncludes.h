@@ -30,9 +30,38 @@ inline ShaderKey CombineShaderKey(ShaderKey mainKey, ShaderKey defineKey)
 }
 
 
+// reflected from the SPIR-V by ShaderBuilder, over every permutation of a shader
+struct ShaderBinding
+{
+  uint32_t set;
+  uint32_t binding;
+  VkDescriptorType descriptorType;
+  // array size, 0 for a runtime sized array
+  uint32_t count;
+  // bytes of a uniform or storage buffer block without its runtime array, 0 for anything else
+  uint32_t size;
+};
+
+struct ShaderVertexInput
+{
+  uint32_t location;
+  // the type the shader declares (eg. R32G32_SFLOAT for vec2), the vertex buffer format may differ as long as the
+  // numeric type matches
+  VkFormat format;
+};
+
 struct ShaderInfo {
   virtual operator uint32_t() = 0;
   virtual operator std::string() = 0;
   virtual uint32_t GetNumDefines() = 0;
   virtual uint32_t GetShaderStage() = 0;
+  // define keys of the permutations that were built
+  virtual uint32_t GetNumPermutations() = 0;
+  virtual uint32_t GetPermutation(uint32_t index) = 0;
+  virtual uint32_t GetNumBindings() = 0;
+  virtual const ShaderBinding& GetBinding(uint32_t index) = 0;
+  // 0 without push constants
+  virtual uint32_t GetPushConstantSize() = 0;
+  virtual uint32_t GetNumVertexInputs() = 0;
+  virtual const ShaderVertexInput& GetVertexInput(uint32_t index) = 0;
 };
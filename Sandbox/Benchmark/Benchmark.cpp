@@ -0,0 +1,29 @@
+#include "Benchmark.h"
+#include "FrameBenchmark.h"
+
+#include <cstring>
+
+namespace
+{
+    struct StandaloneBenchmark
+    {
+        const char* name;
+        int (*run)(const EngineConfig& config);
+    };
+
+    const StandaloneBenchmark c_standaloneBenchmarks[] =
+    {
+        { "logger", RunLoggerBenchmark },
+        { "jobs", RunJobBenchmark },
+    };
+}
+
+int RunBenchmark(const EngineConfig& config)
+{
+    for (const StandaloneBenchmark& benchmark : c_standaloneBenchmarks)
+    {
+        if (config.benchmark == benchmark.name)
+            return benchmark.run(config);
+    }
+    return RunFrameBenchmarks(config);
+}
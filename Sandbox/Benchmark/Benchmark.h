@@ -0,0 +1,10 @@
+#pragma once
+#include "Engine/Engine.h"
+
+// runs the benchmark named by config.benchmark instead of the sandbox scene, returns the process exit code
+// frame presets are listed in FrameBenchmark.cpp, the rest are standalone benchmarks that do not render
+int RunBenchmark(const EngineConfig& config);
+
+// standalone benchmarks
+int RunLoggerBenchmark(const EngineConfig& config);
+int RunJobBenchmark(const EngineConfig& config);
@@ -0,0 +1,154 @@
+#include "BenchmarkReport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdarg>
+#include <fstream>
+
+namespace
+{
+    // printf style append, the reports are small so going through a string is fine
+    void Append(std::string& out, const char* fmt, ...)
+    {
+        char buffer[512];
+        va_list args;
+        va_start(args, fmt);
+        int length = vsnprintf(buffer, sizeof(buffer), fmt, args);
+        va_end(args);
+        if (length > 0)
+            out.append(buffer, std::min<size_t>(size_t(length), sizeof(buffer) - 1));
+    }
+
+    bool WriteFile(const std::string& path, const std::string& content)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        file.write(content.data(), std::streamsize(content.size()));
+        return bool(file);
+    }
+}
+
+void BenchmarkReport::SetParameter(const std::string& name, double value)
+{
+    for (auto& param : m_parameters)
+    {
+        if (param.first == name)
+        {
+            param.second = value;
+            return;
+        }
+    }
+    m_parameters.emplace_back(name, value);
+}
+
+std::vector<double>& BenchmarkReport::Metric(const std::string& name)
+{
+    for (auto& metric : m_metrics)
+    {
+        if (metric.first == name)
+            return metric.second;
+    }
+    m_metrics.emplace_back(name, std::vector<double>{});
+    return m_metrics.back().second;
+}
+
+BenchmarkReport::Stats BenchmarkReport::ComputeStats(std::vector<double> samples)
+{
+    Stats stats;
+    if (samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+
+    // nearest rank percentile
+    auto percentile = [&samples](double p)
+    {
+        size_t rank = size_t(std::ceil(p / 100.0 * samples.size()));
+        return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+    };
+
+    double total = 0;
+    for (double sample : samples)
+        total += sample;
+
+    stats.mean = total / samples.size();
+    stats.min = samples.front();
+    stats.p50 = percentile(50);
+    stats.p90 = percentile(90);
+    stats.p95 = percentile(95);
+    stats.p99 = percentile(99);
+    stats.max = samples.back();
+    return stats;
+}
+
+void BenchmarkReport::Print() const
+{
+    printf("benchmark %s\n", m_name.c_str());
+    for (auto& param : m_parameters)
+    {
+        printf("  %s = %g\n", param.first.c_str(), param.second);
+    }
+    printf("  %-24s %10s %10s %10s %10s %10s %10s\n", "metric", "mean", "min", "p50", "p90", "p99", "max");
+    for (auto& metric : m_metrics)
+    {
+        Stats stats = ComputeStats(metric.second);
+        printf("  %-24s %10.4f %10.4f %10.4f %10.4f %10.4f %10.4f\n", metric.first.c_str(), stats.mean, stats.min, stats.p50, stats.p90, stats.p99, stats.max);
+    }
+}
+
+bool BenchmarkReport::WriteJson(const std::string& path, const std::string& tag) const
+{
+    std::string out;
+    Append(out, "{\n");
+    Append(out, "  \"benchmark\": \"%s\",\n", m_name.c_str());
+    Append(out, "  \"tag\": \"%s\",\n", tag.c_str());
+
+    Append(out, "  \"parameters\": {");
+    for (size_t i = 0; i < m_parameters.size(); ++i)
+    {
+        Append(out, "%s\n    \"%s\": %.17g", i ? "," : "", m_parameters[i].first.c_str(), m_parameters[i].second);
+    }
+    Append(out, "\n  },\n");
+
+    Append(out, "  \"metrics\": {");
+    for (size_t i = 0; i < m_metrics.size(); ++i)
+    {
+        Stats stats = ComputeStats(m_metrics[i].second);
+        Append(out, "%s\n    \"%s\": { \"samples\": %zu, \"mean\": %.6f, \"min\": %.6f, \"p50\": %.6f, \"p90\": %.6f, \"p95\": %.6f, \"p99\": %.6f, \"max\": %.6f }",
+            i ? "," : "", m_metrics[i].first.c_str(), m_metrics[i].second.size(),
+            stats.mean, stats.min, stats.p50, stats.p90, stats.p95, stats.p99, stats.max);
+    }
+    Append(out, "\n  }\n}\n");
+
+    return WriteFile(path, out);
+}
+
+bool BenchmarkReport::WriteCsv(const std::string& path) const
+{
+    std::string out;
+    size_t rows = 0;
+    Append(out, "sample");
+    for (auto& metric : m_metrics)
+    {
+        Append(out, ",%s", metric.first.c_str());
+        rows = std::max(rows, metric.second.size());
+    }
+    Append(out, "\n");
+
+    for (size_t row = 0; row < rows; ++row)
+    {
+        Append(out, "%zu", row);
+        for (auto& metric : m_metrics)
+        {
+            if (row < metric.second.size())
+                Append(out, ",%.6f", metric.second[row]);
+            else
+                Append(out, ",");
+        }
+        Append(out, "\n");
+    }
+
+    return WriteFile(path, out);
+}
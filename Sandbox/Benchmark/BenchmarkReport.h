@@ -0,0 +1,46 @@
+#pragma once
+#include <deque>
+#include <string>
+#include <vector>
+#include <utility>
+
+// collects per sample metrics of a benchmark run and writes them out with percentiles
+// so runs can be compared between commits
+class BenchmarkReport
+{
+public:
+    struct Stats
+    {
+        double mean = 0;
+        double min = 0;
+        double p50 = 0;
+        double p90 = 0;
+        double p95 = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+private:
+    std::string m_name;
+    std::vector<std::pair<std::string, double>> m_parameters;
+    // a deque so the references Metric hands out survive metrics added later
+    std::deque<std::pair<std::string, std::vector<double>>> m_metrics;
+
+public:
+    explicit BenchmarkReport(std::string name) : m_name{ std::move(name) } {}
+
+    const std::string& GetName() const { return m_name; }
+
+    void SetParameter(const std::string& name, double value);
+
+    // samples of a metric, created on first use, columns are written in creation order
+    // the reference stays valid for the lifetime of the report
+    std::vector<double>& Metric(const std::string& name);
+
+    static Stats ComputeStats(std::vector<double> samples);
+
+    void Print() const;
+    // tag is written as is, meant for a commit hash or build identifier
+    bool WriteJson(const std::string& path, const std::string& tag) const;
+    bool WriteCsv(const std::string& path) const;
+};
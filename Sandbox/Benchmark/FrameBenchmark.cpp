@@ -0,0 +1,412 @@
+#include "FrameBenchmark.h"
+#include "BenchmarkReport.h"
+
+#include "Engine/PlatformManager.h"
+#include "Engine/JobSystem.h"
+#include "Engine/AllocationCounter.h"
+#include "Graphics/GraphicCore/GraphicEngine.h"
+#include "Graphics/GraphicCore/GfxPipelineStateManager.h"
+#include "Graphics/GraphicCore/GfxResourceManager.h"
+#include "Graphics/GraphicCore/GfxObjectManager.h"
+#include "Graphics/GraphicCore/GfxDrawList.h"
+#include "Graphics/GraphicCore/GfxMeshRegistry.h"
+#include "Graphics/GraphicCore/GfxBuffer.h"
+#include "Graphics/GraphicCore/GfxVertex.h"
+#include "Graphics/GraphicCore/GfxUniformBuffer.hpp"
+#include "Graphics/ShaderManagement/GfxShaderManager.h"
+#include "shaderData.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+    const BenchmarkScene c_benchmarkScenes[] =
+    {
+        // name              objects  draws perms meshes churn uploads   frames warmup sorted instancing indirect zero allocs
+        { "baseline",            2,      1,    1,    1,    0,        0,  1000,  30, false, false, false, false },
+        { "objects",          4096,      1,    1,    1,    0,        0,  1000,  30, false, false, false, false },
+        { "draws",            4096,   4096,    1,    1,    0,        0,  1000,  30, false, false, false, false },
+        { "permutations",     4096,   4096,   16,    1,    0,        0,  1000,  30, false, false, false, false },
+        { "uploads",             2,      1,    1,    1,    0, 16 << 20,   500,  30, false, false, false, false },
+        { "zero_alloc",        256,    256,    4,    4,    0,        0,  1000,  30, true,  true,  true,  true  },
+        { "draws_unsorted",  50000,  50000,   16,    1,    0,        0,   300,  30, false, false, false, false },
+        { "draws_sorted",    50000,  50000,   16,    1,    0,        0,   300,  30, true,  false, false, true  },
+        { "instancing",      50000,  50000,   16,    1,    0,        0,   300,  30, true,  true,  false, true  },
+        { "meshes_direct",   50000,  50000,   16,  256,    0,        0,   300,  30, true,  true,  false, false },
+        { "meshes_indirect", 50000,  50000,   16,  256,    0,        0,   300,  30, true,  true,  true,  true  },
+        { "mesh_streaming",  50000,  50000,   16,  256,   16,        0,   300,  30, true,  true,  true,  false },
+    };
+
+    using BenchmarkCamera = ShaderStructs::UniformBufferObject;
+
+    using Clock = std::chrono::steady_clock;
+
+    double ElapsedMs(Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    void RunScene(const BenchmarkScene& scene, BenchmarkReport& report)
+    {
+        PlatformManager& pm = PlatformManager::GetInstance();
+        GraphicEngine& ge = GraphicEngine::GetInstance();
+        GfxPipelineStateManager& psm = GfxPipelineStateManager::GetInstance();
+        GfxObjectManager& om = GfxObjectManager::GetInstance();
+        JobSystem& js = JobSystem::GetInstance();
+        GfxDevice& device = ge.GetDevice();
+        const uint32_t framesInFlight = uint32_t(ge.MAX_FRAMES_IN_FLIGHT);
+
+        report.SetParameter("objects", scene.objectCount);
+        report.SetParameter("draws", scene.drawCount);
+        report.SetParameter("permutations", scene.permutationCount);
+        report.SetParameter("meshes", scene.meshCount);
+        report.SetParameter("mesh_churn", scene.meshChurn);
+        report.SetParameter("vertex_stride", GfxMeshRegistry::c_vertexStride);
+        report.SetParameter("upload_bytes", scene.uploadBytes);
+        report.SetParameter("sorted", scene.sortDraws);
+        report.SetParameter("instancing", scene.instancing);
+        report.SetParameter("indirect", scene.indirect);
+        report.SetParameter("multi_draw_indirect", device.GetEnabledFeatures().multiDrawIndirect);
+        report.SetParameter("frames", scene.frameCount);
+        report.SetParameter("warmup_frames", scene.warmupFrames);
+        report.SetParameter("job_threads", js.GetWorkerCount());
+
+        // scene setup
+        std::vector<GfxUniformBuffer<BenchmarkCamera>> cameras(framesInFlight);
+        GfxUniformBuffer<BenchmarkCamera>::CreateLayout(device);
+        for (auto& camera : cameras)
+        {
+            camera.CreateBuffer();
+        }
+
+        // quads of different sizes so every mesh has its own vertices
+        GfxMeshRegistry& meshRegistry = GfxMeshRegistry::GetInstance();
+        meshRegistry.RemoveAllMeshes();
+        std::vector<MeshID> meshes(std::max(scene.meshCount, 1u));
+        auto addQuad = [&](uint32_t mesh)
+        {
+            const float extent = 0.5f - 0.25f * float(mesh) / float(meshes.size());
+            const GfxStandardVertex vertices[] = {
+                {{-extent, -extent}, {1.0f, 0.0f, 0.0f}},
+                {{extent, -extent}, {0.0f, 1.0f, 0.0f}},
+                {{extent, extent}, {0.0f, 0.0f, 1.0f}},
+                {{-extent, extent}, {1.0f, 1.0f, 1.0f}}
+            };
+            const uint16_t indices[] = { 0, 1, 2, 2, 3, 0 };
+            meshes[mesh] = meshRegistry.AddMesh(vertices, indices);
+        };
+        for (uint32_t mesh = 0; mesh < meshes.size(); ++mesh)
+        {
+            addQuad(mesh);
+        }
+        meshRegistry.Upload();
+
+        // upload volume, one staging buffer per frame in flight so the cpu never writes memory the gpu reads
+        std::vector<GfxBuffer> uploadStaging;
+        std::vector<void*> uploadStagingMem;
+        GfxBuffer uploadTarget;
+        std::vector<uint8_t> uploadSource;
+        if (scene.uploadBytes)
+        {
+            uploadStaging.resize(framesInFlight);
+            for (auto& staging : uploadStaging)
+            {
+                staging.CreateBuffer(device, scene.uploadBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                uploadStagingMem.push_back(staging.Map());
+            }
+            uploadTarget.CreateBuffer(device, scene.uploadBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            uploadSource.resize(scene.uploadBytes);
+            for (size_t i = 0; i < uploadSource.size(); ++i)
+            {
+                uploadSource[i] = uint8_t(i);
+            }
+        }
+
+        if (om.GetCapacity() < scene.objectCount)
+            om.SetCapacity(scene.objectCount);
+        om.RemoveAllObjects();
+        std::vector<ObjectID> objects(scene.objectCount);
+        for (auto& object : objects)
+        {
+            object = om.AddObject();
+        }
+
+        // objects are laid out on a grid facing the camera
+        const uint32_t gridSize = std::max(1u, uint32_t(std::ceil(std::sqrt(double(scene.objectCount)))));
+        const float gridSpacing = 2.0f / gridSize;
+        const uint32_t objectsPerDraw = (scene.objectCount + scene.drawCount - 1) / scene.drawCount;
+        const uint32_t numPermutations = std::min(VS_BasicShader::NumPermutations, PS_BasicShader::NumPermutations);
+        const uint32_t permutationCount = std::clamp(scene.permutationCount, 1u, numPermutations);
+
+        // shader modules are created lazily, load the ones this scene draws with before measuring anything
+        {
+            GfxShaderManager& sm = GfxShaderManager::GetInstance();
+            std::vector<ShaderKey> shaders;
+            for (uint32_t permutation = 0; permutation < permutationCount; ++permutation)
+            {
+                shaders.push_back(CombineShaderKey(VS_BasicShader::Hash, VS_BasicShader::Permutations[permutation]));
+                shaders.push_back(CombineShaderKey(PS_BasicShader::Hash, PS_BasicShader::Permutations[permutation]));
+            }
+            Clock::time_point loadStart = Clock::now();
+            JobCounter shaderCounter;
+            sm.Prefetch(shaders.data(), uint32_t(shaders.size()), shaderCounter);
+            js.WaitForCounter(shaderCounter);
+            report.SetParameter("shader_prefetch_ms", ElapsedMs(loadStart, Clock::now()));
+            report.SetParameter("shader_modules_loaded", sm.GetLoadedCount());
+            report.SetParameter("shader_permutations", sm.GetShaderCount());
+        }
+
+        GfxGpuProfiler& gpuProfiler = ge.GetGpuProfiler();
+        uint64_t lastGpuFrame = gpuProfiler.GetLastFrameId();
+
+        std::vector<double>& cpuFrameMs = report.Metric("cpu_frame_ms");
+        std::vector<double>& startFrameMs = report.Metric("start_frame_ms");
+        std::vector<double>& updateMs = report.Metric("update_ms");
+        std::vector<double>& recordingMs = report.Metric("recording_ms");
+        std::vector<double>& submitMs = report.Metric("submit_ms");
+        std::vector<double>& flipMs = report.Metric("flip_ms");
+        std::vector<double>& gpuFrameMs = report.Metric("gpu_frame_ms");
+        // heap allocations made by this thread, the render loop should get these to 0
+        std::vector<double>& frameAllocations = report.Metric("heap_allocations");
+        std::vector<double>& recordingAllocations = report.Metric("recording_heap_allocations");
+        std::vector<double>& recordedDraws = report.Metric("recorded_draws");
+        std::vector<double>& indirectDraws = report.Metric("indirect_draws");
+        std::vector<double>& pipelineBinds = report.Metric("pipeline_binds");
+        std::vector<double>& descriptorBinds = report.Metric("descriptor_binds");
+        std::vector<double>& vertexBufferBinds = report.Metric("vertex_buffer_binds");
+
+        GfxDrawList drawList;
+        drawList.SetInstancing(scene.instancing);
+        drawList.SetIndirect(scene.indirect);
+
+        const uint32_t totalFrames = scene.warmupFrames + scene.frameCount;
+        // frame number recorded in each frame slot, gpu times arrive a few frames late
+        std::vector<uint32_t> slotFrame(framesInFlight, 0);
+        uint32_t frameNumber = 0;
+        while (frameNumber < totalFrames && !pm.CheckExit())
+        {
+            pm.HandleIO();
+            if (pm.IsMinimised())
+            {
+                pm.WaitEvents();
+                continue;
+            }
+
+            Clock::time_point frameStart = Clock::now();
+            const uint64_t frameStartAllocations = AllocationCounter::GetThreadAllocations().allocations;
+            if (!ge.StartFrame())
+                continue;
+            Clock::time_point startFrameEnd = Clock::now();
+
+            // the profiler resolved the previous frame recorded in this slot during StartFrame
+            const uint32_t frameIndex = ge.GetCurrentFrame();
+            if (gpuProfiler.GetLastFrameId() != lastGpuFrame)
+            {
+                lastGpuFrame = gpuProfiler.GetLastFrameId();
+                if (slotFrame[frameIndex] >= scene.warmupFrames)
+                {
+                    gpuFrameMs.push_back(gpuProfiler.GetLastFrameTime());
+                    for (const auto& timing : gpuProfiler.GetLastFrameTimings())
+                    {
+                        if (timing.depth > 0)
+                            report.Metric(std::string("gpu_") + timing.name + "_ms").push_back(timing.ms);
+                    }
+                }
+            }
+            slotFrame[frameIndex] = frameNumber;
+            Clock::time_point updateStart = Clock::now();
+
+            {
+                CPU_ProfileZone(BenchmarkUpdate);
+                const float time = frameNumber * (1.0f / 60.0f);
+                // every object writes its own slot so the updates can be split across the job system
+                js.ParallelFor(scene.objectCount, 256, [&](uint32_t begin, uint32_t end)
+                {
+                    GfxObject obj;
+                    for (uint32_t i = begin; i < end; ++i)
+                    {
+                        glm::vec3 position{ (i % gridSize + 0.5f) * gridSpacing - 1.0f, (i / gridSize + 0.5f) * gridSpacing - 1.0f, 0.0f };
+                        obj.globalTransform = glm::translate(glm::mat4(1.0f), position);
+                        obj.globalTransform = glm::rotate(obj.globalTransform, time + i * 0.1f, glm::vec3(0.0f, 0.0f, 1.0f));
+                        obj.globalTransform = glm::scale(obj.globalTransform, glm::vec3(gridSpacing));
+                        om.UpdateObject(objects[i], obj);
+                    }
+                });
+                om.UpdateBuffers(frameIndex);
+
+                BenchmarkCamera& camera = cameras[frameIndex].m_data;
+                camera.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 2.5f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                camera.proj = glm::perspective(glm::radians(45.0f), device.GetSwapChain().GetExtent().x / (float)device.GetSwapChain().GetExtent().y, 0.1f, 10.0f);
+                camera.proj[1][1] *= -1;
+                cameras[frameIndex].UpdateBuffer();
+
+                if (scene.uploadBytes)
+                    memcpy(uploadStagingMem[frameIndex], uploadSource.data(), scene.uploadBytes);
+
+                for (uint32_t churn = 0; churn < scene.meshChurn; ++churn)
+                {
+                    const uint32_t mesh = (frameNumber * scene.meshChurn + churn) % uint32_t(meshes.size());
+                    meshRegistry.RemoveMesh(meshes[mesh]);
+                    addQuad(mesh);
+                }
+            }
+            Clock::time_point updateEnd = Clock::now();
+            const uint64_t recordingStartAllocations = AllocationCounter::GetThreadAllocations().allocations;
+
+            GfxDrawListStats drawStats = {};
+            ge.BeginRecordingGraphics();
+            {
+                CPU_ProfileZone(Recording_Command_Buffer);
+
+                if (scene.uploadBytes)
+                {
+                    GPU_ProfileZone(BenchmarkUpload);
+                    uploadStaging[frameIndex].CopyTo(uploadTarget, ge.GetCurrentCommandBuffer(), scene.uploadBytes);
+                }
+
+                meshRegistry.FlushUploads();
+
+                GPU_ProfileZone(BenchmarkDraws);
+                psm.SetRenderTarget(0, device.GetSwapChain().GetCurrentImageView());
+                ge.BeginRenderPass();
+
+                GfxDrawPacket packet = {};
+                packet.uniformBuffer = &cameras[frameIndex];
+                packet.objectBuffer = &om.GetBuffer();
+                for (uint32_t draw = 0; draw < scene.drawCount; ++draw)
+                {
+                    uint32_t firstObject = draw * objectsPerDraw;
+                    if (firstObject >= scene.objectCount)
+                        break;
+
+                    const uint32_t permutation = draw % permutationCount;
+                    packet.vertexShader = &GfxShaderManager::GetShader(CombineShaderKey(VS_BasicShader::Hash, VS_BasicShader::Permutations[permutation]));
+                    packet.pixelShader = &GfxShaderManager::GetShader(CombineShaderKey(PS_BasicShader::Hash, PS_BasicShader::Permutations[permutation]));
+                    meshRegistry.FillPacket(packet, meshes[draw % meshes.size()]);
+                    packet.objectCount = std::min(objectsPerDraw, scene.objectCount - firstObject);
+                    packet.firstObject = firstObject;
+                    drawList.Add(packet, float(firstObject) / float(scene.objectCount));
+                }
+                drawStats = drawList.Submit(scene.sortDraws);
+
+                ge.EndRenderPass();
+            }
+            TracyVkCollect(ge.GetProfileContext(), ge.GetCurrentCommandBuffer());
+            ge.EndRecording();
+            Clock::time_point recordingEnd = Clock::now();
+            const uint64_t recordingEndAllocations = AllocationCounter::GetThreadAllocations().allocations;
+            // debug builds stop at the frame that allocated, the run still fails in release
+            assert(!scene.zeroAllocations || frameNumber < scene.warmupFrames || recordingEndAllocations == recordingStartAllocations);
+
+            ge.SubmitWithSync();
+            Clock::time_point submitEnd = Clock::now();
+
+            ge.Flip();
+            GfxResourceManager::CleanUpFrame();
+            Clock::time_point frameEnd = Clock::now();
+            const uint64_t frameEndAllocations = AllocationCounter::GetThreadAllocations().allocations;
+
+            FrameMark;
+
+            if (frameNumber >= scene.warmupFrames)
+            {
+                cpuFrameMs.push_back(ElapsedMs(frameStart, frameEnd));
+                startFrameMs.push_back(ElapsedMs(frameStart, startFrameEnd));
+                updateMs.push_back(ElapsedMs(updateStart, updateEnd));
+                recordingMs.push_back(ElapsedMs(updateEnd, recordingEnd));
+                submitMs.push_back(ElapsedMs(recordingEnd, submitEnd));
+                flipMs.push_back(ElapsedMs(submitEnd, frameEnd));
+                frameAllocations.push_back(double(frameEndAllocations - frameStartAllocations));
+                recordingAllocations.push_back(double(recordingEndAllocations - recordingStartAllocations));
+                recordedDraws.push_back(drawStats.draws);
+                indirectDraws.push_back(drawStats.indirectDraws);
+                pipelineBinds.push_back(drawStats.pipelineBinds);
+                descriptorBinds.push_back(drawStats.descriptorBinds);
+                vertexBufferBinds.push_back(drawStats.vertexBufferBinds);
+            }
+            ++frameNumber;
+        }
+        // gpu times of the last frames in flight are not collected
+        vkDeviceWaitIdle(device);
+        drawList.CleanUp();
+
+        // scene cleanup
+        om.RemoveAllObjects();
+        for (auto& staging : uploadStaging)
+        {
+            staging.Unmap();
+            staging.CleanUp();
+        }
+        if (scene.uploadBytes)
+            uploadTarget.CleanUp();
+        meshRegistry.RemoveAllMeshes();
+        for (auto& camera : cameras)
+        {
+            camera.CleanUp();
+        }
+    }
+}
+
+int RunFrameBenchmarks(const EngineConfig& config)
+{
+    bool runAll = config.benchmark == "all";
+    bool found = false;
+    int result = 0;
+    for (const BenchmarkScene& preset : c_benchmarkScenes)
+    {
+        if (!runAll && config.benchmark != preset.name)
+            continue;
+        found = true;
+
+        BenchmarkScene scene = preset;
+        if (config.frameLimit)
+            scene.frameCount = config.frameLimit;
+
+        BenchmarkReport report(scene.name);
+        RunScene(scene, report);
+        report.Print();
+
+        std::string outputPath = config.benchmarkOutput + "_" + scene.name;
+        if (!report.WriteJson(outputPath + ".json", config.benchmarkTag) || !report.WriteCsv(outputPath + ".csv"))
+        {
+            printf("Failed to write benchmark results to %s\n", outputPath.c_str());
+            return 1;
+        }
+
+        if (scene.zeroAllocations)
+        {
+            double allocations = 0;
+            for (double frameAllocations : report.Metric("recording_heap_allocations"))
+            {
+                allocations += frameAllocations;
+            }
+            if (allocations > 0)
+            {
+                printf("%s: recording made %.0f heap allocations over %u frames, expected none\n", scene.name, allocations, scene.frameCount);
+                result = 1;
+            }
+        }
+
+        if (PlatformManager::GetInstance().CheckExit())
+            break;
+    }
+
+    if (!found)
+    {
+        printf("Unknown benchmark %s, available:", config.benchmark.c_str());
+        for (const BenchmarkScene& preset : c_benchmarkScenes)
+        {
+            printf(" %s", preset.name);
+        }
+        printf(" all\n");
+        return 1;
+    }
+    return result;
+}
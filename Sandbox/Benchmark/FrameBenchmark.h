@@ -0,0 +1,38 @@
+#pragma once
+#include "Includes/Defines.h"
+#include "Engine/Engine.h"
+
+#include <cstdint>
+
+// fixed scenes rendered for a set number of frames, the amount of work per frame is
+// deterministic so timings can be compared between runs
+struct BenchmarkScene
+{
+    const char* name;
+    // objects in the object manager, all transforms are updated and uploaded every frame
+    uint32_t objectCount;
+    // draw calls the objects are split across
+    uint32_t drawCount;
+    // distinct shader permutations cycled through the draws, each is a separate pipeline
+    uint32_t permutationCount;
+    // distinct meshes in the mesh registry cycled through the draws
+    uint32_t meshCount;
+    // meshes removed and added again every frame, goes through the registry's free lists and staged uploads
+    uint32_t meshChurn;
+    // extra bytes copied from a staging buffer to a device local buffer every frame
+    uint32_t uploadBytes;
+    uint32_t frameCount;
+    // frames rendered before recording, covers pipeline creation and first uploads
+    uint32_t warmupFrames;
+    // submit the draws sorted by state instead of in the order they were added
+    bool sortDraws;
+    // merge neighbouring draws of the same mesh and state into instanced draws
+    bool instancing;
+    // record the draws as multi draw indirect batches
+    bool indirect;
+    // fails the run if recording any frame after the warmup allocates from the heap
+    bool zeroAllocations;
+};
+
+// runs the preset named by config.benchmark ("all" runs every preset), returns the process exit code
+int RunFrameBenchmarks(const EngineConfig& config);
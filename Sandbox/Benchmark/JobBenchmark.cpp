@@ -0,0 +1,131 @@
+#include "Benchmark.h"
+#include "BenchmarkReport.h"
+#include "Engine/JobSystem.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const uint32_t c_transformCount = 1 << 20;
+    const uint32_t c_transformGrain = 1024;
+    const uint32_t c_emptyJobCount = 100000;
+    // every job below the leaves spawns two children and waits on them
+    const uint32_t c_waitTreeCount = 16;
+    const uint32_t c_waitTreeDepth = 9;
+    const uint32_t c_defaultRepetitions = 50;
+
+    double ElapsedMs(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void WaitTreeJob(void*, uint32_t depth, uint32_t)
+    {
+        if (depth == 0)
+            return;
+
+        JobCounter counter;
+        Job children[2] = {
+            { WaitTreeJob, nullptr, depth - 1, 0, nullptr },
+            { WaitTreeJob, nullptr, depth - 1, 0, nullptr },
+        };
+        JobSystem::GetInstance().Run(children, 2, &counter);
+        JobSystem::GetInstance().WaitForCounter(counter);
+    }
+}
+
+int RunJobBenchmark(const EngineConfig& config)
+{
+    JobSystem& js = JobSystem::GetInstance();
+    const JobSystem::ThreadInitFunc threadInit = js.GetThreadInit();
+    const uint32_t repetitions = config.frameLimit ? config.frameLimit : c_defaultRepetitions;
+    const uint32_t maxThreads = std::min(std::max(std::thread::hardware_concurrency(), 1u), JobSystem::c_maxThreads);
+
+    // same work as the object updates, transforms built from a rotation and translation
+    std::vector<glm::mat4> transforms(c_transformCount);
+    auto transformRange = [&transforms](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(float(i % 1024), float(i / 1024), 0.0f));
+            transforms[i] = glm::rotate(transform, i * 0.001f, glm::vec3(0.0f, 0.0f, 1.0f));
+        }
+    };
+
+    // scheduling overhead only
+    std::vector<Job> emptyJobs(c_emptyJobCount, Job{ [](void*, uint32_t, uint32_t) {}, nullptr, 0, 0, nullptr });
+    // nested waits, parks fibers on the workers
+    std::vector<Job> waitTrees(c_waitTreeCount, Job{ WaitTreeJob, nullptr, c_waitTreeDepth, 0, nullptr });
+
+    double baseTransformMs = 0;
+    double baseEmptyMs = 0;
+    double baseWaitTreeMs = 0;
+    int result = 0;
+    for (uint32_t threadCount = 1; threadCount <= maxThreads; ++threadCount)
+    {
+        js.CleanUp();
+        js.Init(threadCount, threadInit);
+
+        BenchmarkReport report("jobs_" + std::to_string(threadCount) + "t");
+        report.SetParameter("threads", threadCount);
+        report.SetParameter("transforms", c_transformCount);
+        report.SetParameter("transform_grain", c_transformGrain);
+        report.SetParameter("empty_jobs", c_emptyJobCount);
+        report.SetParameter("wait_trees", c_waitTreeCount);
+        report.SetParameter("wait_tree_depth", c_waitTreeDepth);
+
+        std::vector<double>& transformMs = report.Metric("transform_ms");
+        std::vector<double>& emptyMs = report.Metric("empty_jobs_ms");
+        std::vector<double>& waitTreeMs = report.Metric("wait_tree_ms");
+        for (uint32_t i = 0; i < repetitions; ++i)
+        {
+            Clock::time_point start = Clock::now();
+            js.ParallelFor(c_transformCount, c_transformGrain, transformRange);
+            transformMs.push_back(ElapsedMs(start));
+
+            start = Clock::now();
+            JobCounter counter;
+            js.Run(emptyJobs.data(), c_emptyJobCount, &counter);
+            js.WaitForCounter(counter);
+            emptyMs.push_back(ElapsedMs(start));
+
+            start = Clock::now();
+            JobCounter treeCounter;
+            js.Run(waitTrees.data(), c_waitTreeCount, &treeCounter);
+            js.WaitForCounter(treeCounter);
+            waitTreeMs.push_back(ElapsedMs(start));
+        }
+
+        double meanTransformMs = BenchmarkReport::ComputeStats(transformMs).mean;
+        double meanEmptyMs = BenchmarkReport::ComputeStats(emptyMs).mean;
+        double meanWaitTreeMs = BenchmarkReport::ComputeStats(waitTreeMs).mean;
+        if (threadCount == 1)
+        {
+            baseTransformMs = meanTransformMs;
+            baseEmptyMs = meanEmptyMs;
+            baseWaitTreeMs = meanWaitTreeMs;
+        }
+        report.SetParameter("transform_speedup", baseTransformMs / meanTransformMs);
+        report.SetParameter("empty_jobs_speedup", baseEmptyMs / meanEmptyMs);
+        report.SetParameter("wait_tree_speedup", baseWaitTreeMs / meanWaitTreeMs);
+
+        report.Print();
+        std::string outputPath = config.benchmarkOutput + "_" + report.GetName();
+        if (!report.WriteJson(outputPath + ".json", config.benchmarkTag) || !report.WriteCsv(outputPath + ".csv"))
+        {
+            printf("Failed to write benchmark results to %s\n", outputPath.c_str());
+            result = 1;
+            break;
+        }
+    }
+
+    js.CleanUp();
+    js.Init(config.workerThreads, threadInit);
+    return result;
+}
@@ -0,0 +1,131 @@
+#include "Benchmark.h"
+#include "BenchmarkReport.h"
+#include "Includes/Defines.h"
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const uint32_t c_defaultMessagesPerThread = 100000;
+    const uint32_t c_threadCounts[] = { 1, 4 };
+
+    // both paths write to the same file so the comparison includes real output
+    std::ofstream g_logFile;
+    std::mutex g_syncMutex;
+
+    void FileSink(const char* text, uint32_t length, uint32_t level)
+    {
+        UNUSED_PARAM(level);
+        g_logFile.write(text, length);
+    }
+
+    // what Log did before the logger, format and write on the calling thread
+    template<typename... Args>
+    void SyncLog(const char* fmt, Args... args)
+    {
+        char buffer[Logger::c_maxLineLength];
+        int length = snprintf(buffer, sizeof(buffer), fmt, args...);
+        std::lock_guard<std::mutex> lock{ g_syncMutex };
+        g_logFile.write(buffer, std::min(length, int(sizeof(buffer)) - 1));
+    }
+
+    double ClockOverheadNs()
+    {
+        const uint32_t iterations = 100000;
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            Clock::now();
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+    }
+
+    template<typename LogFunc>
+    void RunThreads(uint32_t threadCount, uint32_t messagesPerThread, std::vector<double>& samples, LogFunc logFunc)
+    {
+        std::vector<std::vector<double>> threadSamples(threadCount);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                std::vector<double>& out = threadSamples[t];
+                out.reserve(messagesPerThread);
+                for (uint32_t i = 0; i < messagesPerThread; ++i)
+                {
+                    Clock::time_point start = Clock::now();
+                    logFunc(t, i);
+                    Clock::time_point end = Clock::now();
+                    out.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        for (auto& out : threadSamples)
+        {
+            samples.insert(samples.end(), out.begin(), out.end());
+        }
+    }
+}
+
+int RunLoggerBenchmark(const EngineConfig& config)
+{
+    const uint32_t messagesPerThread = config.frameLimit ? config.frameLimit : c_defaultMessagesPerThread;
+    const char* shaderName = "VS_BasicShader";
+
+    g_logFile.open(config.benchmarkOutput + "_logger.log", std::ios::binary | std::ios::trunc);
+    if (!g_logFile)
+    {
+        printf("Failed to open %s_logger.log\n", config.benchmarkOutput.c_str());
+        return 1;
+    }
+
+    Logger::Flush();
+    Logger::SetSink(FileSink);
+
+    for (uint32_t threadCount : c_threadCounts)
+    {
+        BenchmarkReport report("logger_" + std::to_string(threadCount) + "t");
+        report.SetParameter("threads", threadCount);
+        report.SetParameter("messages_per_thread", messagesPerThread);
+        report.SetParameter("clock_overhead_ns", ClockOverheadNs());
+
+        // calls Logger::Write directly so the compiled out levels of release builds do not skip the work
+        RunThreads(threadCount, messagesPerThread, report.Metric("async_call_ns"), [shaderName](uint32_t thread, uint32_t i)
+        {
+            Logger::Write(Info, "thread %u message %u shader %s took %f ms\n", thread, i, shaderName, i * 0.001);
+        });
+
+        // time for the logger thread to write out what is still queued
+        Clock::time_point flushStart = Clock::now();
+        Logger::Flush();
+        report.SetParameter("flush_ms", std::chrono::duration<double, std::milli>(Clock::now() - flushStart).count());
+
+        RunThreads(threadCount, messagesPerThread, report.Metric("sync_call_ns"), [shaderName](uint32_t thread, uint32_t i)
+        {
+            SyncLog("thread %u message %u shader %s took %f ms\n", thread, i, shaderName, i * 0.001);
+        });
+
+        report.Print();
+        std::string outputPath = config.benchmarkOutput + "_" + report.GetName();
+        if (!report.WriteJson(outputPath + ".json", config.benchmarkTag) || !report.WriteCsv(outputPath + ".csv"))
+        {
+            printf("Failed to write benchmark results to %s\n", outputPath.c_str());
+            Logger::SetSink(nullptr);
+            return 1;
+        }
+    }
+
+    Logger::SetSink(nullptr);
+    g_logFile.close();
+    return 0;
+}
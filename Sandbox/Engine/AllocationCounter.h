@@ -0,0 +1,27 @@
+#pragma once
+#include "Includes/Defines.h"
+
+// heap allocations made through the global operator new
+struct AllocationCounters
+{
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+// counts the heap allocations of every thread, the benchmarks use it to check the render loop stays off the heap
+class AllocationCounter
+{
+public:
+    // called from the global operator new
+    static void CountAllocation(size_t size)
+    {
+        ++ms_threadAllocations.allocations;
+        ms_threadAllocations.bytes += size;
+    }
+
+    // totals since startup made by the calling thread, unaffected by other threads (eg. the logger)
+    static AllocationCounters GetThreadAllocations() { return ms_threadAllocations; }
+
+private:
+    inline static thread_local AllocationCounters ms_threadAllocations = { 0, 0 };
+};
@@ -1,12 +1,18 @@
 #include "Engine.h"
 
 #include "PlatformManager.h"
+#include "JobSystem.h"
+#include "FrameHandoff.h"
 #include "Graphics/GraphicCore/GraphicEngine.h"
 #include "Graphics/GraphicCore/GfxPipelineStateManager.h"
 #include "Graphics/ShaderManagement/GfxShaderManager.h"
+#include "Graphics/ShaderManagement/GfxShaderReloader.h"
 #include "shaderData.h"
 #include "Graphics/GraphicCore/GfxResourceManager.h"
 #include "Graphics/GraphicCore/GfxObjectManager.h"
+#include "Graphics/GraphicCore/GfxDrawList.h"
+#include "Graphics/GraphicCore/GfxMeshRegistry.h"
+#include "Benchmark/Benchmark.h"
 
 // eventually remove
 #include "Graphics/GraphicCore/GfxBuffer.h"
@@ -19,6 +25,10 @@
 
 #include <iostream>
 #include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <thread>
 #include <tracy/public/common/TracySystem.hpp>
 
 DeclareIV(RT0);
@@ -26,31 +36,35 @@ DeclareIV(RT0);
 //DefineProfileMarker(SingleDraw)
 const char* SingleDraw_ProfileMarker = "SingleDraw";
 
-struct UniformBufferObject {
-    glm::mat4 view;
-    glm::mat4 proj;
+// generated from the shader's uniform block, layout and set number included
+using UniformBufferObject = ShaderStructs::UniformBufferObject;
+
+// everything the render thread needs from the simulation for one frame
+struct SceneFrame
+{
+    std::vector<GfxObject> objects;
+    UniformBufferObject camera;
+    uint32_t frameNumber;
 };
 
-void UpdateMatrices(GfxUniformBuffer<UniformBufferObject>& ubo, ObjectID* objID)
+void SimulateFrame(SceneFrame& frame, ObjectID* objID, float aspectRatio)
 {
-    GraphicEngine& ge = GraphicEngine::GetInstance();
     static auto startTime = std::chrono::high_resolution_clock::now();
     GfxObject obj;
     auto currentTime = std::chrono::high_resolution_clock::now();
     float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
     obj.globalTransform = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
-    GfxObjectManager::GetInstance().UpdateObject(objID[0], obj);
+    frame.objects[objID[0].id] = obj;
 
     obj.globalTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0, 1, 0));
     obj.globalTransform = glm::rotate(obj.globalTransform, time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, -1.0f));
 
-    GfxObjectManager::GetInstance().UpdateObject(objID[1], obj);
+    frame.objects[objID[1].id] = obj;
 
-    ubo.m_data.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.m_data.proj = glm::perspective(glm::radians(45.0f), ge.GetDevice().GetSwapChain().GetExtent().x / (float)ge.GetDevice().GetSwapChain().GetExtent().y, 0.1f, 10.0f);
-    ubo.m_data.proj[1][1] *= -1;
-    ubo.UpdateBuffer();
+    frame.camera.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    frame.camera.proj = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 10.0f);
+    frame.camera.proj[1][1] *= -1;
 }
 
 int Engine::MainLoop()
@@ -60,6 +74,13 @@ int Engine::MainLoop()
     GfxPipelineStateManager& psm = GfxPipelineStateManager::GetInstance();
     GfxObjectManager& om = GfxObjectManager::GetInstance();
 
+    if (!m_config.benchmark.empty())
+    {
+        m_returnValue = RunBenchmark(m_config);
+        CleanUp();
+        return m_returnValue;
+    }
+
     // TODO BLOCK - temp code to make things work first
     // temp ubo code
     std::vector<GfxUniformBuffer<UniformBufferObject>> uboTest;
@@ -84,45 +105,14 @@ int Engine::MainLoop()
     0, 1, 2, 2, 3, 0
     };
 
-    size_t bufferSize = sizeof(vertices[0]) * vertices.size();
-    size_t indexBufferSize = sizeof(indices[0]) * indices.size();
-
-    GfxBuffer stagingBuffer;
-    stagingBuffer.CreateBuffer(ge.GetDevice(), bufferSize + indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    GfxBuffer vertexBuffer;
-    vertexBuffer.CreateBuffer(ge.GetDevice(), bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    GfxBuffer indexBuffer;
-    indexBuffer.CreateBuffer(ge.GetDevice(), indexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    {
-        void* stagingMem = stagingBuffer.Map();
-        memcpy(stagingMem, vertices.data(), vertexBuffer.GetSize());
-        stagingBuffer.Unmap();
-
-        ge.BeginOutOfFrameRecording();
-        ge.BeginRecordingGraphics();
-        stagingBuffer.CopyTo(vertexBuffer, ge.GetCurrentCommandBuffer(), bufferSize);
-
-        ge.EndRecording();
-
-        ge.Submit();
-    }
-
-    {
-        void* stagingMem = stagingBuffer.Map(indexBufferSize, bufferSize);
-        memcpy(stagingMem, indices.data(), indexBuffer.GetSize());
-        stagingBuffer.Unmap();
-
-        ge.BeginRecordingGraphics();
-        stagingBuffer.CopyTo(indexBuffer, ge.GetCurrentCommandBuffer(), indexBufferSize, bufferSize);
-
-        ge.EndRecording();
-
-        ge.Submit();
-    }
-
-    ge.EndOutOfFrameRecording();
+    GfxMeshRegistry& meshes = GfxMeshRegistry::GetInstance();
+    MeshID quad = meshes.AddMesh(vertices, indices);
+    // the shader modules are created on the job threads meanwhile
+    JobCounter shaderCounter;
+    const ShaderKey shaders[] = { VS_BasicShader::Hash, PS_BasicShader::Hash };
+    GfxShaderManager::GetInstance().Prefetch(shaders, uint32_t(std::size(shaders)), shaderCounter);
+    meshes.Upload();
+    JobSystem::GetInstance().WaitForCounter(shaderCounter);
 
     // temp object manager code
     ObjectID objectHandle[2];
@@ -130,16 +120,23 @@ int Engine::MainLoop()
     objectHandle[1] = om.AddObject();
     // TODO END
 
+    if (!m_config.captureFolder.empty())
+        std::filesystem::create_directories(m_config.captureFolder);
 
-    while (!pm.CheckExit())
+    GfxDrawList drawList;
+    auto renderFrame = [&](const SceneFrame& frame)
     {
-        pm.HandleIO();
-
-        ge.StartFrame();
+        if (GfxShaderReloader::IsCreated())
+            GfxShaderReloader::GetInstance().Update(ge.GetFrameCount());
+        if (!ge.StartFrame())
+            return;
+        if (m_config.gpuTimingInterval && frame.frameNumber % m_config.gpuTimingInterval == 0)
+            ge.GetGpuProfiler().PrintTimings();
         {
             CPU_ProfileZone(BufferUpdate);
-            UpdateMatrices(uboTest[ge.GetCurrentFrame()], objectHandle);
-            om.UpdateBuffers(ge.GetCurrentFrame());
+            uboTest[ge.GetCurrentFrame()].m_data = frame.camera;
+            uboTest[ge.GetCurrentFrame()].UpdateBuffer();
+            om.UpdateBuffers(ge.GetCurrentFrame(), frame.objects.data(), frame.objects.size());
         }
 
         ge.BeginRecordingGraphics();
@@ -147,29 +144,33 @@ int Engine::MainLoop()
             CPU_ProfileZone(Recording_Command_Buffer);
             GPU_ProfileZone(SingleDraw);
 
+            meshes.FlushUploads();
             psm.SetRenderTarget(0, ge.GetDevice().GetSwapChain().GetCurrentImageView());
             ge.BeginRenderPass();
 
-            psm.SetShader(GfxShaderManager::GetShader(VS_BasicShader::Hash));
-            psm.SetShader(GfxShaderManager::GetShader(PS_BasicShader::Hash));
-
-            // TODO BLOCK - below should be encompassed into the draw func
-            psm.BindDescriptor(uboTest[ge.GetCurrentFrame()]);
-            psm.BindStructuredBuffer(om.GetBuffer());
-            ge.CommitStates();
-
-            // move the following into pipeline state manager as well
-            VkBuffer vertexBuffers[] = { vertexBuffer };
-            VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(ge.GetCurrentCommandBuffer(), 0, 1, vertexBuffers, offsets);
-            vkCmdBindIndexBuffer(ge.GetCurrentCommandBuffer(), indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-
-            vkCmdDrawIndexed(ge.GetCurrentCommandBuffer(), static_cast<uint32_t>(indices.size()), 2, 0, 0, 0);
-
-            //TODO END
+            GfxDrawPacket packet = {};
+            packet.vertexShader = &GfxShaderManager::GetShader(VS_BasicShader::Hash);
+            packet.pixelShader = &GfxShaderManager::GetShader(PS_BasicShader::Hash);
+            packet.uniformBuffer = &uboTest[ge.GetCurrentFrame()];
+            packet.objectBuffer = &om.GetBuffer();
+            meshes.FillPacket(packet, quad);
+            packet.objectCount = 1;
+            // one packet per object, the draw list instances them into a single draw
+            for (uint32_t object = 0; object < frame.objects.size(); ++object)
+            {
+                packet.firstObject = object;
+                drawList.Add(packet);
+            }
+            drawList.Submit();
 
             ge.EndRenderPass();
         }
+        if (!m_config.captureFolder.empty() && frame.frameNumber % m_config.captureInterval == 0)
+        {
+            char captureName[32];
+            snprintf(captureName, sizeof(captureName), "frame_%05u.png", frame.frameNumber);
+            ge.CaptureFrame((std::filesystem::path(m_config.captureFolder) / captureName).string());
+        }
         TracyVkCollect(ge.GetProfileContext(), ge.GetCurrentCommandBuffer());
         ge.EndRecording();
 
@@ -179,19 +180,68 @@ int Engine::MainLoop()
         GfxResourceManager::CleanUpFrame();
 
         FrameMark;
+    };
+
+    // the main thread simulates frame N+1 while the render thread records and submits frame N
+    FrameHandoff<SceneFrame> handoff;
+    std::thread renderThread;
+    if (m_config.pipelined)
+    {
+        renderThread = std::thread([&]()
+        {
+            // own command buffer slot, the job system's thread init maps it
+            JobSystem::GetInstance().RegisterThread();
+            tracy::SetThreadName("RenderThread");
+            while (const SceneFrame* frame = handoff.BeginRead())
+            {
+                renderFrame(*frame);
+                handoff.EndRead();
+            }
+        });
     }
+
+    uint32_t frameNumber = 0;
+    while (!pm.CheckExit())
+    {
+        pm.HandleIO();
+        if (pm.IsMinimised())
+        {
+            pm.WaitEvents();
+            continue;
+        }
+
+        SceneFrame& frame = handoff.BeginWrite();
+        {
+            CPU_ProfileZone(Simulate);
+            glm::vec2 size = pm.GetSize();
+            // objects the simulation doesn't touch keep the transform the object manager stores
+            frame.objects.assign(om.GetObjects(), om.GetObjects() + om.GetObjectCount());
+            frame.frameNumber = frameNumber;
+            SimulateFrame(frame, objectHandle, size.x / size.y);
+        }
+        handoff.EndWrite();
+
+        if (!m_config.pipelined)
+        {
+            renderFrame(*handoff.BeginRead());
+            handoff.EndRead();
+        }
+
+        ++frameNumber;
+        if (m_config.frameLimit && frameNumber >= m_config.frameLimit)
+            pm.RequestExit();
+    }
+    handoff.Close();
+    if (renderThread.joinable())
+        renderThread.join();
     vkDeviceWaitIdle(ge.GetDevice());
 
+    drawList.CleanUp();
     for (int i = 0; i < ge.MAX_FRAMES_IN_FLIGHT; ++i)
     {
         uboTest[i].CleanUp();
     }
 
-    GfxUniformBuffer<UniformBufferObject>::CleanUpLayouts();
-
-    vertexBuffer.CleanUp();
-    stagingBuffer.CleanUp();
-    indexBuffer.CleanUp();
     CleanUp();
 
     return m_returnValue;
@@ -202,25 +252,89 @@ void Engine::PrintShit()
     std::cout << "printing shit" << std::endl;
 }
 
-void Engine::Init()
+EngineConfig EngineConfig::ParseCommandLine(int argc, char* argv[])
+{
+    EngineConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--headless") == 0)
+            config.headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+            config.frameLimit = uint32_t(strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--capture") == 0 && hasValue)
+            config.captureFolder = argv[++i];
+        else if (strcmp(argv[i], "--capture-interval") == 0 && hasValue)
+            config.captureInterval = std::max(1u, uint32_t(strtoul(argv[++i], nullptr, 10)));
+        else if (strcmp(argv[i], "--workers") == 0 && hasValue)
+            config.workerThreads = uint32_t(strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--serial") == 0)
+            config.pipelined = false;
+        else if (strcmp(argv[i], "--hot-reload") == 0)
+            config.hotReload = true;
+        else if (strcmp(argv[i], "--gpu-timings") == 0 && hasValue)
+            config.gpuTimingInterval = uint32_t(strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--benchmark") == 0 && hasValue)
+            config.benchmark = argv[++i];
+        else if (strcmp(argv[i], "--benchmark-out") == 0 && hasValue)
+            config.benchmarkOutput = argv[++i];
+        else if (strcmp(argv[i], "--benchmark-tag") == 0 && hasValue)
+            config.benchmarkTag = argv[++i];
+        else
+            Log<Severe>("Unknown argument %s\n", argv[i]);
+    }
+    return config;
+}
+
+void Engine::Init(const EngineConfig& config)
 {
+    m_config = config;
     PlatformManager::CreateInstance();
     GraphicEngine::CreateInstance();
+    JobSystem::CreateInstance();
+
+    // the render thread registers with the job system too and needs a thread slot of its own
+    uint32_t workerThreads = m_config.workerThreads ? m_config.workerThreads : std::thread::hardware_concurrency();
+    if (m_config.pipelined && m_config.benchmark.empty())
+        workerThreads = std::clamp(workerThreads, 1u, JobSystem::c_maxThreads - 1);
 
-    PlatformManager::GetInstance().Init();
+    JobSystem::GetInstance().Init(workerThreads, [](uint32_t threadIndex)
+    {
+        GraphicEngine::SetThreadId(threadIndex);
+        if (threadIndex != 0)
+        {
+            char threadName[32];
+            snprintf(threadName, sizeof(threadName), "Worker %u", threadIndex);
+            tracy::SetThreadName(threadName);
+        }
+    });
+
+    PlatformManager::GetInstance().Init(m_config.headless);
 
     GraphicEngine::GetInstance().InitLayerExtInfo();
 
     // probably add all additional layers and extensions here
 
     GraphicEngine::GetInstance().Init();
+    if (m_config.hotReload)
+    {
+        GfxShaderReloader::CreateInstance();
+        if (!GfxShaderReloader::GetInstance().Init())
+            GfxShaderReloader::DestroyInstance();
+    }
     tracy::SetThreadName("MainThread");
 }
 
 void Engine::CleanUp()
 {
+    if (GfxShaderReloader::IsCreated())
+    {
+        GfxShaderReloader::GetInstance().CleanUp();
+        GfxShaderReloader::DestroyInstance();
+    }
     GraphicEngine::GetInstance().Cleanup();
     PlatformManager::GetInstance().CleanUp();
+    JobSystem::GetInstance().CleanUp();
 }
 
 
@@ -1,6 +1,35 @@
 #pragma once
 #include "Includes/Defines.h"
 
+#include <string>
+
+struct EngineConfig
+{
+    // no window, renders to a VK_EXT_headless_surface swapchain
+    bool headless = false;
+    // exit after this many frames, 0 runs until the window is closed
+    uint32_t frameLimit = 0;
+    // folder to write captured frames to, empty disables captures
+    std::string captureFolder;
+    // capture every n-th frame
+    uint32_t captureInterval = 1;
+    // threads used by the job system including the main thread, 0 uses every hardware thread
+    uint32_t workerThreads = 0;
+    // simulate the next frame on the main thread while a render thread records and submits the previous one
+    bool pipelined = true;
+    // print the gpu profiler's timings every n frames, 0 disables
+    uint32_t gpuTimingInterval = 0;
+    // rebuild and swap in shaders whose sources change while running, see GfxShaderReloader
+    bool hotReload = false;
+    // benchmark preset to run instead of the scene, "all" runs every preset
+    std::string benchmark;
+    // results are written to <benchmarkOutput>_<preset>.json and .csv
+    std::string benchmarkOutput = "benchmark";
+    // stored with the results to tell runs apart, eg. a commit hash
+    std::string benchmarkTag;
+
+    static EngineConfig ParseCommandLine(int argc, char* argv[]);
+};
 
 class Engine
 {
@@ -8,12 +37,15 @@ class Engine
 
     int m_returnValue = 0;
     bool m_running = true;
+    EngineConfig m_config;
 public:
 
     int MainLoop();
 
     void PrintShit();
 
-    void Init();
+    void Init(const EngineConfig& config = {});
     void CleanUp();
+
+    const EngineConfig& GetConfig() const { return m_config; }
 };
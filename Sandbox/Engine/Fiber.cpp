@@ -0,0 +1,96 @@
+#include "Fiber.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+
+void Fiber::Create(size_t stackSize, EntryFunc entry, void* data, const char* name)
+{
+    m_entry = entry;
+    m_data = data;
+    strncpy_s(m_name, name, sizeof(m_name) - 1);
+    m_fiber = CreateFiber(stackSize, [](void* param)
+    {
+        Fiber* fiber = static_cast<Fiber*>(param);
+        fiber->m_entry(fiber->m_data);
+    }, this);
+    if (!m_fiber)
+        throw std::runtime_error("failed to create fiber");
+}
+
+void Fiber::Destroy()
+{
+    if (m_fiber && !m_ownsThread)
+        DeleteFiber(m_fiber);
+    m_fiber = nullptr;
+}
+
+void Fiber::InitFromThread()
+{
+    m_ownsThread = true;
+    m_fiber = ConvertThreadToFiber(nullptr);
+    if (!m_fiber)
+        throw std::runtime_error("failed to convert thread to fiber");
+}
+
+void Fiber::ReleaseThread()
+{
+    ConvertFiberToThread();
+    m_fiber = nullptr;
+    m_ownsThread = false;
+}
+
+void Fiber::SwitchTo(Fiber& next)
+{
+    SwitchToFiber(next.m_fiber);
+}
+
+#else
+
+void Fiber::Trampoline(uint32_t dataHigh, uint32_t dataLow)
+{
+    // makecontext only passes ints
+    Fiber* fiber = reinterpret_cast<Fiber*>((uintptr_t(dataHigh) << 32) | uintptr_t(dataLow));
+    fiber->m_entry(fiber->m_data);
+}
+
+void Fiber::Create(size_t stackSize, EntryFunc entry, void* data, const char* name)
+{
+    m_entry = entry;
+    m_data = data;
+    strncpy(m_name, name, sizeof(m_name) - 1);
+    m_stack.resize(stackSize);
+
+    getcontext(&m_context);
+    m_context.uc_stack.ss_sp = m_stack.data();
+    m_context.uc_stack.ss_size = m_stack.size();
+    m_context.uc_link = nullptr;
+
+    uintptr_t self = reinterpret_cast<uintptr_t>(this);
+    makecontext(&m_context, reinterpret_cast<void(*)()>(&Fiber::Trampoline), 2, uint32_t(uint64_t(self) >> 32), uint32_t(self));
+}
+
+void Fiber::Destroy()
+{
+    m_stack.clear();
+    m_stack.shrink_to_fit();
+}
+
+void Fiber::InitFromThread()
+{
+    // the context is filled in by the first switch away from the thread
+    m_ownsThread = true;
+}
+
+void Fiber::ReleaseThread()
+{
+    m_ownsThread = false;
+}
+
+void Fiber::SwitchTo(Fiber& next)
+{
+    swapcontext(&m_context, &next.m_context);
+}
+
+#endif
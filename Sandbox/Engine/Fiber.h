@@ -0,0 +1,44 @@
+#pragma once
+#include "Includes/Defines.h"
+
+#ifndef _WIN32
+#include <ucontext.h>
+#include <vector>
+#endif
+
+// user mode execution context with its own stack, switching is cooperative
+// CreateFiber on windows, ucontext everywhere else
+class Fiber
+{
+public:
+    using EntryFunc = void(*)(void* data);
+
+private:
+#ifdef _WIN32
+    void* m_fiber = nullptr;
+#else
+    ucontext_t m_context;
+    std::vector<uint8_t> m_stack;
+    static void Trampoline(uint32_t dataHigh, uint32_t dataLow);
+#endif
+    EntryFunc m_entry = nullptr;
+    void* m_data = nullptr;
+    bool m_ownsThread = false;
+    // stable pointer for tracy, identifies the fiber across threads
+    char m_name[16] = {};
+
+public:
+    // entry must never return, it has to switch to another fiber instead
+    void Create(size_t stackSize, EntryFunc entry, void* data, const char* name);
+    void Destroy();
+
+    // turns the calling thread into a fiber so it can switch to others
+    void InitFromThread();
+    void ReleaseThread();
+
+    // suspends this fiber, which must be the one running, and continues next
+    void SwitchTo(Fiber& next);
+
+    const char* GetName() const { return m_name; }
+    bool IsThreadFiber() const { return m_ownsThread; }
+};
@@ -0,0 +1,186 @@
+#include "FileWatcher.h"
+
+#ifdef _WIN32
+
+bool FileWatcher::Open(const char* folder)
+{
+    Close();
+    m_folder = std::filesystem::absolute(folder).lexically_normal();
+    HANDLE directory = CreateFileW(m_folder.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (directory == INVALID_HANDLE_VALUE)
+        return false;
+    m_directory = directory;
+
+    m_overlapped = {};
+    m_overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!m_overlapped.hEvent || !ReadChanges())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void FileWatcher::Close()
+{
+    if (m_directory)
+    {
+        // the pending read has to finish before m_overlapped and m_buffer can go away
+        CancelIo(m_directory);
+        DWORD bytes = 0;
+        GetOverlappedResult(m_directory, &m_overlapped, &bytes, TRUE);
+        CloseHandle(m_directory);
+    }
+    if (m_overlapped.hEvent)
+        CloseHandle(m_overlapped.hEvent);
+    m_directory = nullptr;
+    m_overlapped = {};
+}
+
+bool FileWatcher::IsOpen() const
+{
+    return m_directory != nullptr;
+}
+
+bool FileWatcher::ReadChanges()
+{
+    // saving a file is usually a write or a rename of a temporary over it
+    const DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME;
+    ResetEvent(m_overlapped.hEvent);
+    if (ReadDirectoryChangesW(m_directory, m_buffer, sizeof(m_buffer), TRUE, filter, nullptr, &m_overlapped, nullptr))
+        return true;
+    Log<Severe>("Failed to watch %s (%lu)\n", m_folder.string().c_str(), GetLastError());
+    return false;
+}
+
+void FileWatcher::Poll(std::vector<std::filesystem::path>& changed)
+{
+    if (!m_directory)
+        return;
+
+    DWORD bytes = 0;
+    if (!GetOverlappedResult(m_directory, &m_overlapped, &bytes, FALSE))
+    {
+        if (GetLastError() != ERROR_IO_INCOMPLETE)
+        {
+            Log<Severe>("Lost the watch on %s (%lu)\n", m_folder.string().c_str(), GetLastError());
+            Close();
+        }
+        return;
+    }
+
+    // 0 bytes means the buffer overflowed and the changes are lost, which only happens to bulk operations
+    const uint8_t* record = reinterpret_cast<const uint8_t*>(m_buffer);
+    while (bytes)
+    {
+        const FILE_NOTIFY_INFORMATION& info = *reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(record);
+        if (info.Action != FILE_ACTION_REMOVED && info.Action != FILE_ACTION_RENAMED_OLD_NAME)
+        {
+            std::wstring name(info.FileName, info.FileNameLength / sizeof(WCHAR));
+            changed.push_back((m_folder / name).lexically_normal());
+        }
+        if (!info.NextEntryOffset)
+            break;
+        record += info.NextEntryOffset;
+    }
+
+    if (!ReadChanges())
+        Close();
+}
+
+#else
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+bool FileWatcher::Open(const char* folder)
+{
+    Close();
+    std::error_code error;
+    m_folder = std::filesystem::absolute(folder, error).lexically_normal();
+    if (error || !std::filesystem::is_directory(m_folder, error))
+        return false;
+
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0)
+        return false;
+
+    // inotify isn't recursive, every subfolder needs its own watch
+    AddWatch(m_folder);
+    for (auto& entry : std::filesystem::recursive_directory_iterator(m_folder, error))
+    {
+        if (entry.is_directory())
+            AddWatch(entry.path());
+    }
+    if (m_watches.empty())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void FileWatcher::Close()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+    m_fd = -1;
+    m_watches.clear();
+}
+
+bool FileWatcher::IsOpen() const
+{
+    return m_fd >= 0;
+}
+
+void FileWatcher::AddWatch(const std::filesystem::path& folder)
+{
+    // saving a file is usually a write or a rename of a temporary over it
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+    int watch = inotify_add_watch(m_fd, folder.c_str(), mask);
+    if (watch < 0)
+    {
+        Log<Severe>("Failed to watch %s (%s)\n", folder.c_str(), strerror(errno));
+        return;
+    }
+    m_watches[watch] = folder;
+}
+
+void FileWatcher::Poll(std::vector<std::filesystem::path>& changed)
+{
+    if (m_fd < 0)
+        return;
+
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (true)
+    {
+        ssize_t bytes = read(m_fd, buffer, sizeof(buffer));
+        if (bytes <= 0)
+            break;
+
+        for (ssize_t offset = 0; offset < bytes;)
+        {
+            const inotify_event& event = *reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event.len;
+
+            auto watch = m_watches.find(event.wd);
+            if (watch == m_watches.end() || !event.len)
+                continue;
+            std::filesystem::path path = watch->second / event.name;
+            if (event.mask & IN_ISDIR)
+            {
+                if (event.mask & (IN_CREATE | IN_MOVED_TO))
+                    AddWatch(path);
+                continue;
+            }
+            // files are reported once they are closed after writing, a bare create is still empty
+            if (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                changed.push_back(path.lexically_normal());
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+#include "Includes/Defines.h"
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// reports files created, written or renamed into a folder or any of its subfolders without blocking
+// ReadDirectoryChangesW on windows, inotify everywhere else
+class FileWatcher
+{
+public:
+    FileWatcher() = default;
+    ~FileWatcher() { Close(); }
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // false if the folder does not exist or can't be watched
+    bool Open(const char* folder);
+    void Close();
+
+    bool IsOpen() const;
+
+    // appends the absolute paths of the files changed since the last call, a file saved in several steps can show
+    // up more than once
+    void Poll(std::vector<std::filesystem::path>& changed);
+
+private:
+    std::filesystem::path m_folder;
+#ifdef _WIN32
+    void* m_directory = nullptr;
+    OVERLAPPED m_overlapped = {};
+    // FILE_NOTIFY_INFORMATION records, which have to be DWORD aligned
+    DWORD m_buffer[4096] = {};
+
+    // queues the next asynchronous read of changes into m_buffer
+    bool ReadChanges();
+#else
+    int m_fd = -1;
+    // watch descriptor -> folder it watches, subfolders are watched on their own
+    std::unordered_map<int, std::filesystem::path> m_watches;
+
+    void AddWatch(const std::filesystem::path& folder);
+#endif
+};
@@ -0,0 +1,63 @@
+#include "FrameAllocator.h"
+
+thread_local FrameAllocator::ThreadArena FrameAllocator::ms_arena;
+
+void FrameAllocator::Block::Reset()
+{
+    if (overflow)
+    {
+        // grow once so the next frame with the same allocations fits without going to the heap
+        for (uint8_t* allocation : heapAllocations)
+        {
+            delete[] allocation;
+        }
+        heapAllocations.clear();
+        delete[] memory;
+        capacity += overflow;
+        memory = new uint8_t[capacity];
+        overflow = 0;
+    }
+    offset = 0;
+}
+
+FrameAllocator::Block::~Block()
+{
+    for (uint8_t* allocation : heapAllocations)
+    {
+        delete[] allocation;
+    }
+    delete[] memory;
+}
+
+void* FrameAllocator::Allocate(size_t size, size_t alignment)
+{
+    assert((alignment & (alignment - 1)) == 0);
+    ThreadArena& arena = ms_arena;
+    const uint64_t frame = ms_frame.load(std::memory_order_relaxed);
+    Block& block = arena.blocks[frame % c_frameCount];
+    if (arena.frame != frame)
+    {
+        arena.frame = frame;
+        if (!block.memory)
+        {
+            block.capacity = c_defaultArenaSize;
+            block.memory = new uint8_t[block.capacity];
+        }
+        block.Reset();
+    }
+
+    uintptr_t base = reinterpret_cast<uintptr_t>(block.memory);
+    uintptr_t aligned = (base + block.offset + alignment - 1) & ~uintptr_t(alignment - 1);
+    size_t offset = size_t(aligned - base);
+    if (offset + size <= block.capacity)
+    {
+        block.offset = offset + size;
+        return block.memory + offset;
+    }
+
+    block.overflow += size + alignment;
+    uint8_t* allocation = new uint8_t[size + alignment];
+    block.heapAllocations.push_back(allocation);
+    aligned = (reinterpret_cast<uintptr_t>(allocation) + alignment - 1) & ~uintptr_t(alignment - 1);
+    return reinterpret_cast<void*>(aligned);
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include "Includes/Defines.h"
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// per thread linear arenas for memory that only has to live for a frame
+// every thread bump allocates from its own arena so there is no locking. BeginFrame (from GraphicEngine::StartFrame)
+// moves every thread onto the next of c_frameCount arenas, which the owning thread resets on its next allocation.
+// memory allocated during frame N stays valid until the same thread allocates in frame N + c_frameCount, so it should
+// not be handed to another thread's frame (eg. across the sim/render pipeline)
+class FrameAllocator
+{
+public:
+    static const uint32_t c_frameCount = 2;
+    static const size_t c_defaultArenaSize = 256 * 1024;
+
+    // never fails, running out of arena falls back to the heap and the arena grows to fit on its next reset
+    static void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template<typename T>
+    static T* Allocate(size_t count = 1)
+    {
+        return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    static void BeginFrame() { ms_frame.fetch_add(1, std::memory_order_relaxed); }
+    static uint64_t GetFrame() { return ms_frame.load(std::memory_order_relaxed); }
+
+private:
+    struct Block
+    {
+        uint8_t* memory = nullptr;
+        size_t capacity = 0;
+        size_t offset = 0;
+        // bytes that did not fit, added to the capacity on the next reset
+        size_t overflow = 0;
+        std::vector<uint8_t*> heapAllocations;
+
+        void Reset();
+        ~Block();
+    };
+
+    struct ThreadArena
+    {
+        Block blocks[c_frameCount];
+        uint64_t frame = ~0ull;
+    };
+
+    inline static std::atomic<uint64_t> ms_frame{ 0 };
+    static thread_local ThreadArena ms_arena;
+};
+
+// stl allocator over the calling thread's frame arena, deallocation is a no-op
+template<typename T>
+class FrameStlAllocator
+{
+public:
+    using value_type = T;
+
+    FrameStlAllocator() = default;
+    template<typename U>
+    FrameStlAllocator(const FrameStlAllocator<U>&) {}
+
+    T* allocate(size_t count) { return FrameAllocator::Allocate<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const FrameStlAllocator<U>&) const { return true; }
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
\ No newline at end of file
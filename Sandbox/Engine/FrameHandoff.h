@@ -0,0 +1,68 @@
+#pragma once
+#include "Includes/Defines.h"
+
+#include <atomic>
+
+// double buffered hand off of per frame state from one producer thread to one consumer thread
+// the producer fills one slot while the consumer reads the other, neither side takes a lock
+// and each only blocks when it gets a full frame ahead of the other
+template<typename T>
+class FrameHandoff
+{
+    static const uint32_t c_slotCount = 2;
+    static const uint64_t c_closedBit = 1ull << 63;
+
+    T m_slots[c_slotCount];
+    // frames published by the producer, c_closedBit is set once nothing more will be published
+    std::atomic<uint64_t> m_produced{ 0 };
+    // frames released by the consumer
+    std::atomic<uint64_t> m_consumed{ 0 };
+
+public:
+    // slot for the next frame, blocks while the consumer still reads every slot
+    T& BeginWrite()
+    {
+        uint64_t produced = m_produced.load(std::memory_order_relaxed) & ~c_closedBit;
+        uint64_t consumed = m_consumed.load(std::memory_order_acquire);
+        while (produced - consumed >= c_slotCount)
+        {
+            m_consumed.wait(consumed, std::memory_order_acquire);
+            consumed = m_consumed.load(std::memory_order_acquire);
+        }
+        return m_slots[produced % c_slotCount];
+    }
+
+    void EndWrite()
+    {
+        m_produced.fetch_add(1, std::memory_order_release);
+        m_produced.notify_one();
+    }
+
+    // oldest published frame, blocks until there is one. null once closed and every frame has been read
+    const T* BeginRead()
+    {
+        uint64_t consumed = m_consumed.load(std::memory_order_relaxed);
+        uint64_t produced = m_produced.load(std::memory_order_acquire);
+        while ((produced & ~c_closedBit) == consumed)
+        {
+            if (produced & c_closedBit)
+                return nullptr;
+            m_produced.wait(produced, std::memory_order_acquire);
+            produced = m_produced.load(std::memory_order_acquire);
+        }
+        return &m_slots[consumed % c_slotCount];
+    }
+
+    void EndRead()
+    {
+        m_consumed.fetch_add(1, std::memory_order_release);
+        m_consumed.notify_one();
+    }
+
+    // producer side, the consumer drains what was published and then gets null
+    void Close()
+    {
+        m_produced.fetch_or(c_closedBit, std::memory_order_release);
+        m_produced.notify_one();
+    }
+};
\ No newline at end of file
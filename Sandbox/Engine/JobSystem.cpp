@@ -0,0 +1,440 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstring>
+
+void JobSystem::WorkDeque::Store(int64_t index, const Job& job)
+{
+    uint64_t words[c_jobWords];
+    memcpy(words, &job, sizeof(Job));
+    Slot& slot = m_slots[index & c_mask];
+    for (uint32_t i = 0; i < c_jobWords; ++i)
+    {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+}
+
+Job JobSystem::WorkDeque::Load(int64_t index) const
+{
+    uint64_t words[c_jobWords];
+    const Slot& slot = m_slots[index & c_mask];
+    for (uint32_t i = 0; i < c_jobWords; ++i)
+    {
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    Job job;
+    memcpy(&job, words, sizeof(Job));
+    return job;
+}
+
+bool JobSystem::WorkDeque::Push(const Job& job)
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top >= int64_t(c_maxJobsPerThread))
+        return false;
+
+    Store(bottom, job);
+    m_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+bool JobSystem::WorkDeque::Pop(Job& job)
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        // empty
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    job = Load(bottom);
+    bool taken = true;
+    if (top == bottom)
+    {
+        // last job, race the thieves for it
+        taken = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return taken;
+}
+
+bool JobSystem::WorkDeque::Steal(Job& job)
+{
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+        return false;
+
+    job = Load(top);
+    return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+void JobSystem::Init(uint32_t threadCount, ThreadInitFunc threadInit)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    threadCount = std::clamp(threadCount, 1u, c_maxThreads);
+
+    m_threadInit = threadInit;
+    m_threadData.resize(c_maxThreads);
+    for (auto& data : m_threadData)
+    {
+        data = new ThreadData;
+    }
+
+    m_fibers.resize(c_fiberCount);
+    m_freeFibers.reserve(c_fiberCount);
+    m_waitingFibers.reserve(c_fiberCount);
+    for (uint32_t i = 0; i < c_fiberCount; ++i)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "Fiber %u", i);
+        m_fibers[i].Create(c_fiberStackSize, FiberMain, this, name);
+        m_freeFibers.push_back(&m_fibers[i]);
+    }
+
+    m_running.store(true, std::memory_order_release);
+    // the calling thread is always thread 0
+    RegisterThread();
+
+    for (uint32_t i = 1; i < threadCount; ++i)
+    {
+        uint32_t threadIndex = m_registeredThreads.fetch_add(1, std::memory_order_acq_rel);
+        m_workers.emplace_back(&JobSystem::WorkerMain, this, threadIndex);
+    }
+}
+
+void JobSystem::CleanUp()
+{
+    m_running.store(false, std::memory_order_release);
+    WakeWorkers();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+
+    if (!m_waitingFibers.empty())
+        Log<Severe>("Job system shut down with %u jobs still waiting\n", uint32_t(m_waitingFibers.size()));
+    for (auto& fiber : m_fibers)
+    {
+        fiber.Destroy();
+    }
+    m_fibers.clear();
+    m_freeFibers.clear();
+    m_waitingFibers.clear();
+    m_waitingCount.store(0);
+
+    for (auto& data : m_threadData)
+    {
+        delete data;
+    }
+    m_threadData.clear();
+    m_registeredThreads.store(0, std::memory_order_release);
+    ms_threadIndex = ~0u;
+}
+
+uint32_t JobSystem::RegisterThread()
+{
+    if (ms_threadIndex != ~0u)
+        return ms_threadIndex;
+
+    uint32_t threadIndex = m_registeredThreads.fetch_add(1, std::memory_order_acq_rel);
+    if (threadIndex >= c_maxThreads)
+        throw std::runtime_error("too many threads registered with the job system");
+
+    ms_threadIndex = threadIndex;
+    m_threadData[threadIndex]->stealSeed = threadIndex * 2654435761u + 1;
+    if (m_threadInit)
+        m_threadInit(threadIndex);
+    return threadIndex;
+}
+
+void JobSystem::WorkerMain(uint32_t threadIndex)
+{
+    ms_threadIndex = threadIndex;
+    m_threadData[threadIndex]->stealSeed = threadIndex * 2654435761u + 1;
+    if (m_threadInit)
+        m_threadInit(threadIndex);
+
+    Fiber& threadFiber = m_threadFibers[threadIndex];
+    threadFiber.InitFromThread();
+    ms_currentFiber = &threadFiber;
+
+    // the pool always has more fibers than there are threads
+    Fiber* fiber = AcquireFiber();
+    assert(fiber);
+    SwitchFiber(*fiber, FiberSwitch::None);
+
+    // back once the job system shuts down
+    threadFiber.ReleaseThread();
+    ms_currentFiber = nullptr;
+    ms_threadIndex = ~0u;
+}
+
+void JobSystem::FiberMain(void* data)
+{
+    JobSystem& js = *static_cast<JobSystem*>(data);
+    js.CompleteSwitch();
+    js.SchedulerLoop();
+
+    // shutting down, hand the thread back. this fiber is never resumed
+    Fiber_ProfileLeave;
+    js.SwitchFiber(js.m_threadFibers[ms_threadIndex], FiberSwitch::Free);
+}
+
+void JobSystem::SchedulerLoop()
+{
+    while (m_running.load(std::memory_order_acquire))
+    {
+        // read before looking for work, a fiber readied or a job pushed from here on bumps it
+        uint32_t generation = m_wakeGeneration.load();
+
+        // parked jobs first, they are further along than anything still queued
+        if (Fiber* ready = TakeReadyFiber())
+        {
+            SwitchFiber(*ready, FiberSwitch::Free);
+            continue;
+        }
+
+        if (RunOne())
+            continue;
+
+        // a short spin catches jobs pushed right after running out, before paying for a sleep
+        // parked fibers don't keep it spinning, the last decrement of their counter wakes the workers
+        bool found = false;
+        for (uint32_t spin = 0; spin < 64 && !found; ++spin)
+        {
+            std::this_thread::yield();
+            found = RunOne();
+        }
+        if (found)
+            continue;
+
+        // anything pushed after reading the generation bumps it and the wait returns straight away
+        m_sleepingWorkers.fetch_add(1);
+        m_wakeGeneration.wait(generation);
+        m_sleepingWorkers.fetch_sub(1);
+    }
+}
+
+Fiber* JobSystem::AcquireFiber()
+{
+    std::lock_guard<std::mutex> lock{ m_fiberMutex };
+    if (m_freeFibers.empty())
+        return nullptr;
+    Fiber* fiber = m_freeFibers.back();
+    m_freeFibers.pop_back();
+    return fiber;
+}
+
+Fiber* JobSystem::TakeReadyFiber()
+{
+    if (m_waitingCount.load(std::memory_order_acquire) == 0)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock{ m_fiberMutex };
+    for (size_t i = 0; i < m_waitingFibers.size(); ++i)
+    {
+        if (m_waitingFibers[i].counter->IsDone())
+        {
+            Fiber* fiber = m_waitingFibers[i].fiber;
+            m_waitingFibers[i] = m_waitingFibers.back();
+            m_waitingFibers.pop_back();
+            m_waitingCount.fetch_sub(1, std::memory_order_acq_rel);
+            return fiber;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::SwitchFiber(Fiber& next, FiberSwitch::Action action, JobCounter* counter)
+{
+    Fiber* current = ms_currentFiber;
+    ms_pendingSwitch = { action, current, counter };
+    ms_currentFiber = &next;
+    current->SwitchTo(next);
+
+    // resumed, possibly on another thread
+    CompleteSwitch();
+}
+
+void JobSystem::CompleteSwitch()
+{
+    // thread locals are read again after every switch, the fiber can have moved threads (needs /GT on msvc)
+    FiberSwitch pending = ms_pendingSwitch;
+    ms_pendingSwitch = { FiberSwitch::None, nullptr, nullptr };
+
+    if (pending.action == FiberSwitch::Free)
+    {
+        std::lock_guard<std::mutex> lock{ m_fiberMutex };
+        m_freeFibers.push_back(pending.fiber);
+    }
+    else if (pending.action == FiberSwitch::Wait)
+    {
+        std::lock_guard<std::mutex> lock{ m_fiberMutex };
+        m_waitingFibers.push_back({ pending.fiber, pending.counter });
+        m_waitingCount.fetch_add(1, std::memory_order_acq_rel);
+        // pairs with the fence in Decrement, either it sees this fiber waiting and wakes the workers or
+        // this thread's next TakeReadyFiber sees the counter done
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    if (!ms_currentFiber->IsThreadFiber())
+        Fiber_ProfileEnter(ms_currentFiber->GetName());
+}
+
+void JobSystem::WakeWorkers()
+{
+    // sequentially consistent so either the worker sees the new generation or we see it sleeping
+    m_wakeGeneration.fetch_add(1);
+    if (m_sleepingWorkers.load() || !m_running.load(std::memory_order_acquire))
+        m_wakeGeneration.notify_all();
+}
+
+void JobSystem::Push(const Job& job)
+{
+    assert(ms_threadIndex != ~0u && "thread is not registered with the job system");
+    if (!m_threadData[ms_threadIndex]->deque.Push(job))
+    {
+        // deque is full, running the job here is always valid since nothing waits on a job starting
+        Execute(job);
+    }
+}
+
+void JobSystem::Run(const Job* jobs, uint32_t count, JobCounter* counter, JobCounter* dependency)
+{
+    if (count == 0)
+        return;
+
+    if (counter)
+        counter->m_value.fetch_add(count, std::memory_order_acq_rel);
+
+    if (dependency)
+    {
+        dependency->Lock();
+        bool waiting = dependency->GetValue() != 0;
+        if (waiting)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                dependency->m_dependents.push_back(jobs[i]);
+                dependency->m_dependents.back().counter = counter;
+            }
+        }
+        dependency->Unlock();
+        if (waiting)
+            return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Job job = jobs[i];
+        job.counter = counter;
+        Push(job);
+    }
+    WakeWorkers();
+}
+
+bool JobSystem::RunOne()
+{
+    ThreadData& data = *m_threadData[ms_threadIndex];
+    Job job;
+    bool found = data.deque.Pop(job);
+
+    if (!found)
+    {
+        uint32_t threadCount = std::min(m_registeredThreads.load(std::memory_order_acquire), c_maxThreads);
+        // xorshift to pick where to start stealing so thieves spread out
+        data.stealSeed ^= data.stealSeed << 13;
+        data.stealSeed ^= data.stealSeed >> 17;
+        data.stealSeed ^= data.stealSeed << 5;
+        uint32_t start = data.stealSeed % threadCount;
+        for (uint32_t i = 0; i < threadCount && !found; ++i)
+        {
+            uint32_t victim = (start + i) % threadCount;
+            if (victim != ms_threadIndex)
+                found = m_threadData[victim]->deque.Steal(job);
+        }
+    }
+
+    if (!found)
+        return false;
+
+    Execute(job);
+    return true;
+}
+
+void JobSystem::Execute(const Job& job)
+{
+    job.function(job.data, job.begin, job.end);
+    if (job.counter)
+        Decrement(*job.counter);
+}
+
+void JobSystem::Decrement(JobCounter& counter)
+{
+    uint32_t value = counter.m_value.load(std::memory_order_acquire);
+    while (true)
+    {
+        assert(value != 0 && "more jobs finished than were counted");
+        if (value > 1)
+        {
+            if (counter.m_value.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_acquire))
+                return;
+            continue;
+        }
+
+        // last job, going to 0 under the lock lets waiters know when the counter is no longer touched
+        counter.Lock();
+        if (!counter.m_value.compare_exchange_strong(value, 0, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            counter.Unlock();
+            continue;
+        }
+        std::vector<Job> dependents;
+        dependents.swap(counter.m_dependents);
+        counter.Unlock();
+
+        // counters of the dependents were incremented when they were added
+        for (const Job& dependent : dependents)
+        {
+            Push(dependent);
+        }
+        // sleeping workers have to look for fibers parked on this counter
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!dependents.empty() || m_waitingCount.load(std::memory_order_acquire))
+            WakeWorkers();
+        return;
+    }
+}
+
+void JobSystem::WaitForCounter(JobCounter& counter)
+{
+    if (counter.IsDone())
+        return;
+
+    Fiber* current = ms_currentFiber;
+    if (current && !current->IsThreadFiber())
+    {
+        if (Fiber* next = AcquireFiber())
+        {
+            // only resumed once the counter is done
+            SwitchFiber(*next, FiberSwitch::Wait, &counter);
+            return;
+        }
+    }
+
+    while (!counter.IsDone())
+    {
+        if (!RunOne())
+            std::this_thread::yield();
+    }
+}
@@ -0,0 +1,229 @@
+#pragma once
+#include "Includes/Defines.h"
+#include "Fiber.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <type_traits>
+#include <thread>
+#include <vector>
+
+using JobFunction = void(*)(void* data, uint32_t begin, uint32_t end);
+
+class JobCounter;
+
+struct Job
+{
+    JobFunction function;
+    void* data;
+    // range for jobs that process part of a larger set, unused otherwise
+    uint32_t begin;
+    uint32_t end;
+    // decremented once the job has run, may be null
+    JobCounter* counter;
+};
+
+// counts jobs that have not finished yet, jobs can be made to wait on a counter reaching 0
+class JobCounter
+{
+    friend class JobSystem;
+
+    std::atomic<uint32_t> m_value{ 0 };
+
+    // held when adding a dependency and while the counter goes to 0, so the thread finishing the last job
+    // is done with the counter before a waiter can see it as done and destroy it
+    mutable std::atomic_flag m_lock = ATOMIC_FLAG_INIT;
+    std::vector<Job> m_dependents;
+
+    void Lock() const
+    {
+        while (m_lock.test_and_set(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+    }
+    void Unlock() const { m_lock.clear(std::memory_order_release); }
+public:
+    uint32_t GetValue() const { return m_value.load(std::memory_order_acquire); }
+    bool IsDone() const
+    {
+        if (GetValue() != 0)
+            return false;
+        Lock();
+        Unlock();
+        return true;
+    }
+};
+
+// work stealing job scheduler
+// every registered thread owns a Chase-Lev deque, the owner pushes and pops at the bottom while idle threads steal
+// from the top. the thread that calls Init is thread 0 and runs jobs while it waits on a counter
+// worker threads run jobs on pooled fibers, a job that waits on a counter parks its fiber and the worker carries on
+// with other work on a fresh one. parked fibers can resume on any worker, so a job must not rely on thread locals
+// (eg. GraphicEngine's command buffer slot) across a wait
+class JobSystem
+{
+    DefaultSingleton(JobSystem);
+public:
+    static const uint32_t c_maxThreads = 8;
+    // queued jobs per thread, pushing more runs them on the pushing thread
+    static const uint32_t c_maxJobsPerThread = 4096;
+
+    static const uint32_t c_fiberCount = 64;
+    static const size_t c_fiberStackSize = 128 * 1024;
+
+    using ThreadInitFunc = void(*)(uint32_t threadIndex);
+
+private:
+    // a fiber can only be handed to other threads once nothing runs on its stack anymore, so the fiber that was
+    // switched to finishes what the previous one asked for
+    struct FiberSwitch
+    {
+        enum Action
+        {
+            None,
+            Free,
+            Wait,
+        };
+        Action action;
+        Fiber* fiber;
+        JobCounter* counter;
+    };
+
+    struct WaitingFiber
+    {
+        Fiber* fiber;
+        JobCounter* counter;
+    };
+
+    class WorkDeque
+    {
+        static const int64_t c_mask = c_maxJobsPerThread - 1;
+        static const uint32_t c_jobWords = sizeof(Job) / sizeof(uint64_t);
+
+        // jobs are stored by value as atomic words, a thief can read a slot the owner is overwriting
+        // but then loses the race on m_top and throws the torn copy away
+        struct Slot
+        {
+            std::atomic<uint64_t> words[c_jobWords];
+        };
+
+        alignas(64) std::atomic<int64_t> m_top{ 0 };
+        alignas(64) std::atomic<int64_t> m_bottom{ 0 };
+        Slot m_slots[c_maxJobsPerThread];
+
+        void Store(int64_t index, const Job& job);
+        Job Load(int64_t index) const;
+    public:
+        // owner only, returns false when full
+        bool Push(const Job& job);
+        // owner only
+        bool Pop(Job& job);
+        // any thread
+        bool Steal(Job& job);
+    };
+
+    struct ThreadData
+    {
+        WorkDeque deque;
+        uint32_t stealSeed = 0;
+    };
+
+    static_assert(sizeof(Job) % sizeof(uint64_t) == 0 && std::is_trivially_copyable_v<Job>, "jobs are copied through the deque as 64 bit words");
+    static_assert((c_maxJobsPerThread & (c_maxJobsPerThread - 1)) == 0, "deque size must be a power of 2");
+
+    inline static thread_local uint32_t ms_threadIndex = ~0u;
+    inline static thread_local Fiber* ms_currentFiber = nullptr;
+    inline static thread_local FiberSwitch ms_pendingSwitch = { FiberSwitch::None, nullptr, nullptr };
+
+    std::vector<ThreadData*> m_threadData;
+    std::vector<std::thread> m_workers;
+    std::atomic<uint32_t> m_registeredThreads{ 0 };
+    std::atomic<bool> m_running{ false };
+
+    // bumped whenever jobs are pushed, idle workers wait on it
+    std::atomic<uint32_t> m_wakeGeneration{ 0 };
+    std::atomic<uint32_t> m_sleepingWorkers{ 0 };
+
+    ThreadInitFunc m_threadInit = nullptr;
+
+    // sized once in Init, fibers keep pointers to themselves
+    std::vector<Fiber> m_fibers;
+    Fiber m_threadFibers[c_maxThreads];
+    std::mutex m_fiberMutex;
+    std::vector<Fiber*> m_freeFibers;
+    std::vector<WaitingFiber> m_waitingFibers;
+    std::atomic<uint32_t> m_waitingCount{ 0 };
+
+    void WorkerMain(uint32_t threadIndex);
+    static void FiberMain(void* data);
+    void SchedulerLoop();
+    Fiber* AcquireFiber();
+    // a parked fiber whose counter is done, removed from the wait list
+    Fiber* TakeReadyFiber();
+    void SwitchFiber(Fiber& next, FiberSwitch::Action action, JobCounter* counter = nullptr);
+    void CompleteSwitch();
+    void Push(const Job& job);
+    void WakeWorkers();
+    // runs one job from this thread's deque or stolen from another, returns false if there was none
+    bool RunOne();
+    void Execute(const Job& job);
+    void Decrement(JobCounter& counter);
+
+public:
+    // threadCount includes the calling thread, 0 uses every hardware thread up to c_maxThreads
+    void Init(uint32_t threadCount = 0, ThreadInitFunc threadInit = nullptr);
+    void CleanUp();
+
+    // threads that are not workers have to register before they can run jobs
+    uint32_t RegisterThread();
+    uint32_t GetThreadCount() const { return m_registeredThreads.load(std::memory_order_acquire); }
+    uint32_t GetWorkerCount() const { return uint32_t(m_workers.size()) + 1; }
+    static uint32_t GetThreadIndex() { return ms_threadIndex; }
+    ThreadInitFunc GetThreadInit() const { return m_threadInit; }
+
+    // counter is incremented by count and decremented as each job finishes
+    // with a dependency the jobs are only queued once the dependency reaches 0
+    void Run(const Job* jobs, uint32_t count, JobCounter* counter, JobCounter* dependency = nullptr);
+
+    // on a worker the calling job is parked until the counter reaches 0 and the worker runs other jobs meanwhile
+    // other threads (or when every fiber is taken) run jobs on the calling thread until it is done
+    void WaitForCounter(JobCounter& counter);
+
+    // splits [0, count) into jobs of at most grainSize elements and waits for all of them
+    template<typename Func>
+    void ParallelFor(uint32_t count, uint32_t grainSize, const Func& func)
+    {
+        if (count == 0)
+            return;
+
+        grainSize = grainSize ? grainSize : 1;
+        const uint32_t jobCount = (count + grainSize - 1) / grainSize;
+        if (jobCount == 1)
+        {
+            func(0u, count);
+            return;
+        }
+
+        JobCounter counter;
+        JobFunction function = [](void* data, uint32_t begin, uint32_t end)
+        {
+            (*static_cast<const Func*>(data))(begin, end);
+        };
+
+        Job jobs[64];
+        for (uint32_t first = 0; first < jobCount; first += uint32_t(std::size(jobs)))
+        {
+            uint32_t batch = std::min(jobCount - first, uint32_t(std::size(jobs)));
+            for (uint32_t i = 0; i < batch; ++i)
+            {
+                uint32_t begin = (first + i) * grainSize;
+                jobs[i] = { function, const_cast<Func*>(&func), begin, std::min(begin + grainSize, count), nullptr };
+            }
+            Run(jobs, batch, &counter);
+        }
+        WaitForCounter(counter);
+    }
+};
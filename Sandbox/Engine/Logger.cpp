@@ -0,0 +1,181 @@
+#include "Includes/Logger.h"
+#include "Includes/Defines.h"
+
+#include <chrono>
+#include <mutex>
+#include <tracy/public/common/TracySystem.hpp>
+
+namespace
+{
+    void DefaultSink(const char* text, uint32_t length, uint32_t level)
+    {
+        UNUSED_PARAM(level);
+        fwrite(text, 1, length, stdout);
+#ifdef _WIN32
+        OutputDebugStringA(text);
+#endif
+    }
+
+    // the logger thread is the only writer while running, this only guards the synchronous fallback
+    std::mutex g_syncMutex;
+
+    struct RingHandle
+    {
+        Logger::Ring* ring = nullptr;
+        bool claimFailed = false;
+
+        ~RingHandle()
+        {
+            // queued messages stay in the ring, the next thread to claim it continues after them
+            if (ring)
+                ring->m_claimed.store(false, std::memory_order_release);
+        }
+    };
+}
+
+Logger::Ring* Logger::GetThreadRing()
+{
+    thread_local RingHandle handle;
+    if (handle.ring || handle.claimFailed)
+        return handle.ring;
+
+    for (uint32_t i = 0; i < c_maxRings; ++i)
+    {
+        Ring* ring = ms_rings[i].load(std::memory_order_acquire);
+        if (!ring)
+        {
+            // rings are never freed, threads can still hold one while the process shuts down
+            Ring* newRing = new Ring;
+            newRing->m_claimed.store(true, std::memory_order_relaxed);
+            if (ms_rings[i].compare_exchange_strong(ring, newRing, std::memory_order_acq_rel))
+            {
+                handle.ring = newRing;
+                return newRing;
+            }
+            // another thread filled the slot first, try to claim theirs
+            delete newRing;
+        }
+
+        bool claimed = false;
+        if (ring->m_claimed.compare_exchange_strong(claimed, true, std::memory_order_acquire))
+        {
+            handle.ring = ring;
+            return ring;
+        }
+    }
+
+    handle.claimFailed = true;
+    return nullptr;
+}
+
+void Logger::WriteSync(const char* text, uint32_t length, uint32_t level)
+{
+    std::lock_guard<std::mutex> lock{ g_syncMutex };
+    Sink sink = ms_sink.load(std::memory_order_acquire);
+    (sink ? sink : DefaultSink)(text, length, level);
+}
+
+bool Logger::Drain(Ring& ring, char* buffer)
+{
+    uint64_t head = ring.m_head.load(std::memory_order_acquire);
+    uint64_t tail = ring.m_tail.load(std::memory_order_relaxed);
+    if (head == tail)
+        return false;
+
+    Sink sink = ms_sink.load(std::memory_order_acquire);
+    if (!sink)
+        sink = DefaultSink;
+
+    while (tail != head)
+    {
+        uint32_t pos = uint32_t(tail % Ring::c_capacity);
+        uint32_t contiguous = Ring::c_capacity - pos;
+        if (contiguous < sizeof(MessageHeader))
+        {
+            tail += contiguous;
+            continue;
+        }
+
+        MessageHeader header;
+        memcpy(&header, ring.m_data + pos, sizeof(header));
+        if (header.decode)
+        {
+            uint32_t length = header.decode(header.fmt, ring.m_data + pos + sizeof(header), buffer, c_maxLineLength);
+            sink(buffer, length, header.level);
+        }
+        tail += header.size;
+    }
+
+    ring.m_tail.store(tail, std::memory_order_release);
+    return true;
+}
+
+void Logger::ThreadMain()
+{
+    tracy::SetThreadName("LoggerThread");
+    char buffer[c_maxLineLength];
+
+    while (ms_running.load(std::memory_order_acquire))
+    {
+        bool wrote = false;
+        for (auto& slot : ms_rings)
+        {
+            Ring* ring = slot.load(std::memory_order_acquire);
+            if (ring)
+                wrote |= Drain(*ring, buffer);
+        }
+
+        // nothing is signalled by producers so logging never makes a system call on the hot path
+        if (!wrote)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // messages pushed while stopping
+    for (auto& slot : ms_rings)
+    {
+        Ring* ring = slot.load(std::memory_order_acquire);
+        if (ring)
+            Drain(*ring, buffer);
+    }
+}
+
+void Logger::Start()
+{
+    if (ms_running.exchange(true))
+        return;
+    ms_thread = std::thread(ThreadMain);
+}
+
+void Logger::Stop()
+{
+    if (!ms_running.exchange(false))
+        return;
+    ms_thread.join();
+    fflush(stdout);
+}
+
+void Logger::Flush()
+{
+    if (!ms_running.load(std::memory_order_acquire) || std::this_thread::get_id() == ms_thread.get_id())
+        return;
+
+    for (auto& slot : ms_rings)
+    {
+        Ring* ring = slot.load(std::memory_order_acquire);
+        if (!ring)
+            continue;
+
+        uint64_t head = ring->m_head.load(std::memory_order_acquire);
+        while (ring->m_tail.load(std::memory_order_acquire) < head && ms_running.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+    }
+    fflush(stdout);
+}
+
+void Logger::SetSink(Sink sink)
+{
+    Flush();
+    ms_sink.store(sink, std::memory_order_release);
+}
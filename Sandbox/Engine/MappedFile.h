@@ -0,0 +1,32 @@
+#pragma once
+#include "Includes/Defines.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// read only view of a whole file, the os pages it in on access
+// MapViewOfFile on windows, mmap everywhere else
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false if the file does not exist or can't be mapped, empty files can't be mapped either
+    bool Open(const char* path);
+    void Close();
+
+    bool IsOpen() const { return m_data != nullptr; }
+    const uint8_t* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
@@ -8,17 +8,34 @@
 #include <iostream>
 #include "Graphics/GraphicCore/GraphicDefines.hpp"
 
-void PlatformManager::Init()
+void PlatformManager::Init(bool headless)
 {
+    m_headless = headless;
+    m_width = DISPLAY_WIDTH;
+    m_height = DISPLAY_HEIGHT;
+    if (m_headless)
+        return;
+
     glfwInit();
-    m_size = { DISPLAY_WIDTH, DISPLAY_HEIGHT };
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     m_window = glfwCreateWindow(DISPLAY_WIDTH, DISPLAY_HEIGHT, "Vulkan window", nullptr, nullptr);
+    glfwSetFramebufferSizeCallback(m_window, FramebufferResizeCallback);
+}
+
+void PlatformManager::FramebufferResizeCallback(GLFWwindow* window, int width, int height)
+{
+    UNUSED_PARAM(window);
+    ms_instance->m_width = uint32_t(width);
+    ms_instance->m_height = uint32_t(height);
+    ms_instance->m_resized = true;
 }
 
 void PlatformManager::CleanUp()
 {
+    if (m_headless)
+        return;
+
     glfwDestroyWindow(m_window);
 
     glfwTerminate();
@@ -26,11 +43,24 @@ void PlatformManager::CleanUp()
 
 bool PlatformManager::CheckExit()
 {
+    if (m_exitRequested)
+        return true;
+    if (m_headless)
+        return false;
     return glfwWindowShouldClose(m_window);
 }
 
 void PlatformManager::HandleIO()
 {
+    if (m_headless)
+        return;
     glfwPollEvents();
 }
 
+void PlatformManager::WaitEvents()
+{
+    if (m_headless)
+        return;
+    glfwWaitEvents();
+}
+
@@ -4,17 +4,50 @@
 #include "GLFW/glfw3.h"
 #include "glm/glm.hpp"
 
+#include <atomic>
+
 class PlatformManager
 {
     DefaultSingleton(PlatformManager);
-    GLFWwindow* m_window;
-    glm::vec2 m_size;
+    GLFWwindow* m_window = nullptr;
+    // written by the event callbacks on the main thread, read by the render thread
+    std::atomic<uint32_t> m_width{ 0 };
+    std::atomic<uint32_t> m_height{ 0 };
+    std::atomic<bool> m_resized{ false };
+    // no window is created when headless, exit is driven by RequestExit instead of the window
+    bool m_headless = false;
+    std::atomic<bool> m_exitRequested{ false };
+
+    static void FramebufferResizeCallback(GLFWwindow* window, int width, int height);
 public:
-    void Init();
+    void Init(bool headless = false);
+
+    bool IsHeadless() const
+    {
+        return m_headless;
+    }
+
+    void RequestExit()
+    {
+        m_exitRequested = true;
+    }
 
+    // current framebuffer size, 0 when the window is minimised
     glm::vec2 GetSize() const
     {
-        return m_size;
+        return { m_width.load(std::memory_order_relaxed), m_height.load(std::memory_order_relaxed) };
+    }
+
+    // nothing can be rendered while the framebuffer is 0 sized
+    bool IsMinimised() const
+    {
+        return m_width.load(std::memory_order_relaxed) == 0 || m_height.load(std::memory_order_relaxed) == 0;
+    }
+
+    // returns true once after the framebuffer has been resized
+    bool ConsumeResized()
+    {
+        return m_resized.exchange(false);
     }
 
     void CleanUp();
@@ -23,8 +56,11 @@ public:
 
     void HandleIO();
 
+    // blocks until there are window events to handle, main thread only like HandleIO
+    void WaitEvents();
+
     GLFWwindow* GetWindow()
     {
         return m_window;
     }
-};
\ No newline at end of file
+};
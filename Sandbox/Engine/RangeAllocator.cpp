@@ -0,0 +1,86 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+
+void RangeAllocator::Init(uint32_t capacity)
+{
+    m_capacity = capacity;
+    Reset();
+}
+
+void RangeAllocator::Reset()
+{
+    m_freeRanges.clear();
+    if (m_capacity)
+        m_freeRanges.push_back({ 0, m_capacity });
+    m_freeCount = m_capacity;
+}
+
+uint32_t RangeAllocator::Allocate(uint32_t count)
+{
+    // an empty range doesn't take anything from the free list, Free ignores it as well
+    if (!count)
+        return 0;
+
+    for (size_t i = 0; i < m_freeRanges.size(); ++i)
+    {
+        Range& range = m_freeRanges[i];
+        if (range.count < count)
+            continue;
+
+        const uint32_t offset = range.offset;
+        range.offset += count;
+        range.count -= count;
+        if (!range.count)
+            m_freeRanges.erase(m_freeRanges.begin() + i);
+        m_freeCount -= count;
+        return offset;
+    }
+    return c_invalidOffset;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t count)
+{
+    if (!count)
+        return;
+    assert(offset + count <= m_capacity);
+
+    // first free range after the freed one
+    auto next = std::lower_bound(m_freeRanges.begin(), m_freeRanges.end(), offset,
+        [](const Range& range, uint32_t value) { return range.offset < value; });
+    assert(next == m_freeRanges.end() || offset + count <= next->offset);
+
+    const bool mergePrevious = next != m_freeRanges.begin() && std::prev(next)->offset + std::prev(next)->count == offset;
+    const bool mergeNext = next != m_freeRanges.end() && offset + count == next->offset;
+    assert(next == m_freeRanges.begin() || std::prev(next)->offset + std::prev(next)->count <= offset);
+
+    if (mergePrevious && mergeNext)
+    {
+        std::prev(next)->count += count + next->count;
+        m_freeRanges.erase(next);
+    }
+    else if (mergePrevious)
+    {
+        std::prev(next)->count += count;
+    }
+    else if (mergeNext)
+    {
+        next->offset = offset;
+        next->count += count;
+    }
+    else
+    {
+        m_freeRanges.insert(next, { offset, count });
+    }
+    m_freeCount += count;
+}
+
+uint32_t RangeAllocator::GetLargestFreeRange() const
+{
+    uint32_t largest = 0;
+    for (const Range& range : m_freeRanges)
+    {
+        largest = std::max(largest, range.count);
+    }
+    return largest;
+}
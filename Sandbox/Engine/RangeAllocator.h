@@ -0,0 +1,36 @@
+#pragma once
+#include "Includes/Defines.h"
+
+#include <vector>
+
+// first fit free list over [0, capacity), hands out offsets into something allocated elsewhere (eg. a gpu buffer)
+// free ranges are kept sorted by offset and merged with their neighbours when freed
+class RangeAllocator
+{
+public:
+    static const uint32_t c_invalidOffset = ~0u;
+
+    void Init(uint32_t capacity);
+    // offset of count free elements, c_invalidOffset if no free range is large enough
+    // a count of 0 is a valid empty range at offset 0
+    uint32_t Allocate(uint32_t count);
+    // freeing an empty range does nothing
+    void Free(uint32_t offset, uint32_t count);
+    void Reset();
+
+    uint32_t GetCapacity() const { return m_capacity; }
+    uint32_t GetFreeCount() const { return m_freeCount; }
+    // largest single allocation that would currently succeed
+    uint32_t GetLargestFreeRange() const;
+
+private:
+    struct Range
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    std::vector<Range> m_freeRanges;
+    uint32_t m_capacity = 0;
+    uint32_t m_freeCount = 0;
+};
@@ -1,10 +1,13 @@
 #include "Engine/Engine.h"
 #include "Graphics/GraphicCore/GraphicEngine.h"
 
-int main()
+int main(int argc, char* argv[])
 {
+  Logger::Start();
   Engine::CreateInstance();
-  Engine::GetInstance().Init();
+  Engine::GetInstance().Init(EngineConfig::ParseCommandLine(argc, argv));
 
-  return Engine::GetInstance().MainLoop();
+  int result = Engine::GetInstance().MainLoop();
+  Logger::Stop();
+  return result;
 }
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "GfxDescriptorLayoutCache.h"
+#include "../autogen/ShaderData.h"
+#include "GfxVertex.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vulkan/vk_enum_string_helper.h>
+
+namespace
+{
+    // the numeric type the shader sees, integer attributes can't be read as floats and the other way round
+    bool IsIntegerFormat(VkFormat format)
+    {
+        std::string_view name = string_VkFormat(format);
+        return name.ends_with("_UINT") || name.ends_with("_SINT");
+    }
+}
+
+void GfxDescriptorLayoutCache::AddBinding(ShaderInfo& shader, const ShaderBinding& binding)
+{
+    if (binding.set >= c_maxSets)
+        throw std::runtime_error(std::string(shader) + " uses descriptor set " + std::to_string(binding.set) + ", at most " + std::to_string(c_maxSets) + " are supported");
+
+    const VkShaderStageFlags stage = ShaderTypeToVulkanStage[shader.GetShaderStage()];
+    std::vector<Binding>& bindings = m_bindings[binding.set];
+    auto existing = std::find_if(bindings.begin(), bindings.end(), [&](const Binding& b) { return b.layout.binding == binding.binding; });
+    if (existing == bindings.end())
+    {
+        VkDescriptorSetLayoutBinding layout{};
+        layout.binding = binding.binding;
+        layout.descriptorType = binding.descriptorType;
+        layout.descriptorCount = binding.count;
+        layout.stageFlags = stage;
+        bindings.push_back({ layout, binding.size });
+        m_setCount = std::max(m_setCount, binding.set + 1);
+        return;
+    }
+    if (existing->layout.descriptorType != binding.descriptorType || existing->layout.descriptorCount != binding.count || existing->size != binding.size)
+    {
+        throw std::runtime_error(std::string(shader) + " declares set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) +
+            " differently from an earlier shader");
+    }
+    existing->layout.stageFlags |= stage;
+}
+
+void GfxDescriptorLayoutCache::CheckVertexInputs(ShaderInfo& shader)
+{
+    std::span<const VkVertexInputAttributeDescription> attributes = GfxStandardVertex::GetAttributeDescriptions();
+    for (uint32_t i = 0; i < shader.GetNumVertexInputs(); ++i)
+    {
+        const ShaderVertexInput& input = shader.GetVertexInput(i);
+        auto attribute = std::find_if(attributes.begin(), attributes.end(), [&](const VkVertexInputAttributeDescription& a) { return a.location == input.location; });
+        if (attribute == attributes.end())
+            throw std::runtime_error(std::string(shader) + " reads vertex input " + std::to_string(input.location) + " which GfxStandardVertex doesn't have");
+        if (IsIntegerFormat(attribute->format) != IsIntegerFormat(input.format))
+        {
+            throw std::runtime_error(std::string(shader) + " reads vertex input " + std::to_string(input.location) + " as " + string_VkFormat(input.format) +
+                " but it is " + string_VkFormat(attribute->format));
+        }
+    }
+}
+
+void GfxDescriptorLayoutCache::Init(GfxDevice& device)
+{
+    m_device = &device;
+    for (const std::shared_ptr<ShaderInfo>& shader : g_shaderInfos)
+    {
+        for (uint32_t i = 0; i < shader->GetNumBindings(); ++i)
+        {
+            AddBinding(*shader, shader->GetBinding(i));
+        }
+        if (shader->GetPushConstantSize())
+        {
+            m_pushConstantRange.stageFlags |= ShaderTypeToVulkanStage[shader->GetShaderStage()];
+            m_pushConstantRange.size = std::max(m_pushConstantRange.size, shader->GetPushConstantSize());
+        }
+        if (shader->GetShaderStage() == uint32_t(ShaderType::VS))
+            CheckVertexInputs(*shader);
+    }
+
+    for (uint32_t set = 0; set < m_setCount; ++set)
+    {
+        std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+        for (const Binding& binding : m_bindings[set])
+        {
+            layoutBindings.push_back(binding.layout);
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = uint32_t(layoutBindings.size());
+        layoutInfo.pBindings = layoutBindings.data();
+        API_CALL(vkCreateDescriptorSetLayout, device, &layoutInfo, nullptr, &m_setLayouts[set]);
+    }
+    Log<Verbose>("%u descriptor set layouts from %zu shaders, %u bytes of push constants\n", m_setCount, std::size(g_shaderInfos), m_pushConstantRange.size);
+}
+
+void GfxDescriptorLayoutCache::CleanUp()
+{
+    for (uint32_t set = 0; set < m_setCount; ++set)
+    {
+        API_CALL(vkDestroyDescriptorSetLayout, *m_device, m_setLayouts[set], nullptr);
+        m_setLayouts[set] = VK_NULL_HANDLE;
+        m_bindings[set].clear();
+    }
+    m_setCount = 0;
+    m_pushConstantRange = {};
+}
+
+const VkDescriptorSetLayoutBinding* GfxDescriptorLayoutCache::FindBinding(uint32_t set, uint32_t binding) const
+{
+    if (set >= m_setCount)
+        return nullptr;
+    for (const Binding& b : m_bindings[set])
+    {
+        if (b.layout.binding == binding)
+            return &b.layout;
+    }
+    return nullptr;
+}
+
+uint32_t GfxDescriptorLayoutCache::GetBufferSize(uint32_t set, uint32_t binding) const
+{
+    if (set >= m_setCount)
+        return 0;
+    for (const Binding& b : m_bindings[set])
+    {
+        if (b.layout.binding == binding)
+            return b.size;
+    }
+    return 0;
+}
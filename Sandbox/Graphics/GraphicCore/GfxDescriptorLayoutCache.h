@@ -0,0 +1,60 @@
+#pragma once
+#ifdef _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#endif
+#include "vulkan/vulkan.h"
+
+#include "Includes/Defines.h"
+#include "GraphicDefines.hpp"
+#include "GfxDevice.h"
+#include "Shared/ShaderIncludes.h"
+
+#include <vector>
+
+// descriptor set layouts and the push constant range, created once at startup from the bindings ShaderBuilder
+// reflected into ShaderData.h. set numbers mean the same thing in every shader: set N's layout is the union of what
+// every shader declares in set N, so a descriptor set allocated with it fits every pipeline layout
+class GfxDescriptorLayoutCache
+{
+    DefaultSingleton(GfxDescriptorLayoutCache);
+public:
+    // the number of bound sets vulkan guarantees
+    static const uint32_t c_maxSets = 4;
+
+    // throws if shaders declare a binding differently or don't match the vertex layout
+    void Init(GfxDevice& device);
+    void CleanUp();
+
+    // sets below GetSetCount that no shader uses get an empty layout
+    VkDescriptorSetLayout GetSetLayout(uint32_t set) const
+    {
+        assert(set < m_setCount);
+        return m_setLayouts[set];
+    }
+    uint32_t GetSetCount() const { return m_setCount; }
+    const VkDescriptorSetLayout* GetSetLayouts() const { return m_setLayouts; }
+
+    // nullptr if no shader declares it
+    const VkDescriptorSetLayoutBinding* FindBinding(uint32_t set, uint32_t binding) const;
+    // bytes of the buffer block at the binding as the shaders see it, 0 if it isn't a buffer
+    uint32_t GetBufferSize(uint32_t set, uint32_t binding) const;
+
+    // size is 0 without push constants
+    const VkPushConstantRange& GetPushConstantRange() const { return m_pushConstantRange; }
+
+private:
+    struct Binding
+    {
+        VkDescriptorSetLayoutBinding layout;
+        uint32_t size;
+    };
+
+    GfxDevice* m_device = nullptr;
+    std::vector<Binding> m_bindings[c_maxSets];
+    VkDescriptorSetLayout m_setLayouts[c_maxSets] = {};
+    uint32_t m_setCount = 0;
+    VkPushConstantRange m_pushConstantRange = {};
+
+    void AddBinding(ShaderInfo& shader, const ShaderBinding& binding);
+    static void CheckVertexInputs(ShaderInfo& shader);
+};
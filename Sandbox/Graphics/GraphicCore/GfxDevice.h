@@ -31,6 +31,8 @@ class GfxDevice
     VkQueue m_computeQueue = VK_NULL_HANDLE;
     VkQueue m_presentQueue = VK_NULL_HANDLE;
     QueueFamilyIndices m_queueFamilies;
+    VkPhysicalDeviceFeatures m_enabledFeatures{};
+    VkPhysicalDeviceProperties m_properties{};
 
     GfxSwapChain m_swapChain;
 
@@ -52,6 +54,8 @@ public:
     }
 
     GfxSwapChain& GetSwapChain() { return m_swapChain; };
+    const VkPhysicalDeviceFeatures& GetEnabledFeatures() const { return m_enabledFeatures; }
+    const VkPhysicalDeviceLimits& GetLimits() const { return m_properties.limits; }
 
     void Init(VkInstance vkInstance);
 
@@ -0,0 +1,268 @@
+#include "GfxDrawList.h"
+#include "GraphicEngine.h"
+#include "GfxPipelineStateManager.h"
+
+#include <algorithm>
+
+namespace
+{
+    uint64_t HashCombine(uint64_t seed, uint64_t value)
+    {
+        value *= 0x9E3779B97F4A7C15ull;
+        return seed ^ (value + 0x632BE59BD9B4E019ull + (seed << 6) + (seed >> 2));
+    }
+
+    uint64_t HashCombine(uint64_t seed, const void* pointer)
+    {
+        return HashCombine(seed, uint64_t(reinterpret_cast<uintptr_t>(pointer)));
+    }
+
+    // pointers have their low bits aligned, take the high bits of a multiplicative hash instead
+    uint64_t HashBits(uint64_t hash, uint32_t bits)
+    {
+        return (hash * 0x9E3779B97F4A7C15ull) >> (64 - bits);
+    }
+}
+
+uint64_t GfxDrawList::MakeSortKey(const GfxDrawPacket& packet, float depth)
+{
+    const uint64_t pipeline = HashBits(HashCombine(HashCombine(0, packet.vertexShader), packet.pixelShader), c_pipelineBits);
+    // the mesh is part of the material id so packets that can be instanced together end up next to each other
+    uint64_t material = HashCombine(HashCombine(0, packet.uniformBuffer), packet.objectBuffer);
+    material = HashCombine(HashCombine(material, packet.vertexBuffer), packet.indexBuffer);
+    material = HashCombine(HashCombine(material, packet.firstIndex), uint32_t(packet.vertexOffset));
+    material = HashBits(material, c_materialBits);
+    const uint64_t depthBits = uint64_t(std::clamp(depth, 0.0f, 1.0f) * float((1u << c_depthBits) - 1));
+
+    const uint32_t depthShift = 64 - c_pipelineBits - c_materialBits - c_depthBits;
+    return (pipeline << (64 - c_pipelineBits)) | (material << (64 - c_pipelineBits - c_materialBits)) | (depthBits << depthShift);
+}
+
+void GfxDrawList::Add(const GfxDrawPacket& packet, float depth)
+{
+    AddWithKey(packet, MakeSortKey(packet, depth));
+}
+
+void GfxDrawList::AddWithKey(const GfxDrawPacket& packet, uint64_t sortKey)
+{
+    assert(GraphicEngine::GetThreadId() < JobSystem::c_maxThreads);
+    Bucket& bucket = m_buckets[GraphicEngine::GetThreadId()];
+    if (bucket.packets.empty())
+    {
+        bucket.packets.reserve(std::max<size_t>(bucket.lastCount, 64));
+        bucket.keys.reserve(bucket.packets.capacity());
+    }
+    bucket.packets.push_back(packet);
+    bucket.keys.push_back(sortKey);
+}
+
+uint32_t GfxDrawList::GetPacketCount() const
+{
+    size_t count = 0;
+    for (const Bucket& bucket : m_buckets)
+    {
+        count += bucket.packets.size();
+    }
+    return uint32_t(count);
+}
+
+void GfxDrawList::Clear()
+{
+    // the arena memory is gone after the next frame, so the buckets start from scratch instead of keeping capacity
+    for (Bucket& bucket : m_buckets)
+    {
+        if (!bucket.packets.empty())
+            bucket.lastCount = bucket.packets.size();
+        bucket.packets = {};
+        bucket.keys = {};
+    }
+}
+
+void GfxDrawList::CleanUp()
+{
+    m_instanceStream.CleanUp();
+    m_indirectStream.CleanUp();
+    Clear();
+}
+
+bool GfxDrawList::CanMerge(const GfxDrawPacket& a, const GfxDrawPacket& b)
+{
+    return a.vertexShader == b.vertexShader && a.pixelShader == b.pixelShader &&
+        a.uniformBuffer == b.uniformBuffer && a.objectBuffer == b.objectBuffer &&
+        a.vertexBuffer == b.vertexBuffer && a.indexBuffer == b.indexBuffer && a.indexType == b.indexType &&
+        a.indexCount == b.indexCount && a.firstIndex == b.firstIndex && a.vertexOffset == b.vertexOffset &&
+        a.positionScaleBias == b.positionScaleBias;
+}
+
+void GfxDrawList::RadixSort(FrameVector<SortEntry>& entries, FrameVector<SortEntry>& scratch)
+{
+    // least significant byte first, every pass is stable so earlier passes break ties of later ones
+    scratch.resize(entries.size());
+    for (uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        uint32_t counts[256] = {};
+        for (const SortEntry& entry : entries)
+        {
+            ++counts[(entry.key >> shift) & 0xFF];
+        }
+        // every key has the same byte here, the pass would not move anything
+        if (counts[(entries[0].key >> shift) & 0xFF] == entries.size())
+            continue;
+
+        uint32_t offset = 0;
+        for (uint32_t& count : counts)
+        {
+            uint32_t bucketSize = count;
+            count = offset;
+            offset += bucketSize;
+        }
+        for (const SortEntry& entry : entries)
+        {
+            scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+GfxDrawListStats GfxDrawList::Submit(bool sort)
+{
+    CPU_ProfileZone(DrawListSubmit);
+    GfxDrawListStats stats = {};
+
+    FrameVector<SortEntry> entries;
+    entries.reserve(GetPacketCount());
+    uint32_t objectCount = 0;
+    for (const Bucket& bucket : m_buckets)
+    {
+        for (size_t i = 0; i < bucket.packets.size(); ++i)
+        {
+            entries.push_back({ bucket.keys[i], &bucket.packets[i] });
+            objectCount += bucket.packets[i].objectCount;
+        }
+    }
+    if (entries.empty())
+        return stats;
+    if (sort)
+    {
+        FrameVector<SortEntry> scratch;
+        RadixSort(entries, scratch);
+    }
+
+    GraphicEngine& ge = GraphicEngine::GetInstance();
+    GfxPipelineStateManager& psm = GfxPipelineStateManager::GetInstance();
+    VkCommandBuffer cmd = ge.GetCurrentCommandBuffer();
+    ge.SetDynamicStates();
+
+    // instances are bound from this submission's part of the stream, so firstInstance starts at 0
+    GfxInstance* instances = reinterpret_cast<GfxInstance*>(m_instanceStream.Reserve(objectCount * sizeof(GfxInstance)));
+    uint32_t instanceCursor = 0;
+    {
+        VkBuffer instanceBuffer = m_instanceStream.GetBuffer();
+        VkDeviceSize offset = m_instanceStream.GetOffset();
+        vkCmdBindVertexBuffers(cmd, 1, 1, &instanceBuffer, &offset);
+    }
+
+    // indirect draws read firstInstance from the buffer, without drawIndirectFirstInstance it has to be 0
+    const VkPhysicalDeviceFeatures& features = ge.GetDevice().GetEnabledFeatures();
+    VkDrawIndexedIndirectCommand* commands = nullptr;
+    uint32_t commandCount = 0;
+    if (m_indirect && features.drawIndirectFirstInstance)
+        commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(m_indirectStream.Reserve(entries.size() * sizeof(VkDrawIndexedIndirectCommand)));
+    const uint32_t maxBatch = features.multiDrawIndirect ? ge.GetDevice().GetLimits().maxDrawIndirectCount : 1;
+    uint32_t batchStart = 0;
+    uint32_t batchCount = 0;
+    auto flushBatch = [&]()
+    {
+        while (batchCount)
+        {
+            const uint32_t count = std::min(batchCount, maxBatch);
+            const VkDeviceSize offset = m_indirectStream.GetOffset() + batchStart * sizeof(VkDrawIndexedIndirectCommand);
+            vkCmdDrawIndexedIndirect(cmd, m_indirectStream.GetBuffer(), offset, count, sizeof(VkDrawIndexedIndirectCommand));
+            ++stats.indirectDraws;
+            batchStart += count;
+            batchCount -= count;
+        }
+    };
+
+    const GfxDrawPacket* previous = nullptr;
+    for (size_t entry = 0; entry < entries.size();)
+    {
+        const GfxDrawPacket& packet = *entries[entry].packet;
+        const bool pipelineChanged = !previous || packet.vertexShader != previous->vertexShader || packet.pixelShader != previous->pixelShader;
+        const bool descriptorsChanged = !previous || packet.uniformBuffer != previous->uniformBuffer || packet.objectBuffer != previous->objectBuffer;
+        const bool vertexBufferChanged = !previous || packet.vertexBuffer != previous->vertexBuffer;
+        const bool indexBufferChanged = !previous || packet.indexBuffer != previous->indexBuffer || packet.indexType != previous->indexType;
+        // the batched draws have to be recorded with the state they were written for
+        if (pipelineChanged || descriptorsChanged || vertexBufferChanged || indexBufferChanged)
+            flushBatch();
+
+        if (pipelineChanged)
+        {
+            psm.SetShader(*packet.vertexShader);
+            psm.SetShader(*packet.pixelShader);
+        }
+        if (descriptorsChanged)
+        {
+            psm.BindDescriptor(*packet.uniformBuffer);
+            psm.BindStructuredBuffer(*packet.objectBuffer);
+        }
+        if (pipelineChanged)
+        {
+            psm.BindPipeline(cmd);
+            ++stats.pipelineBinds;
+        }
+        // all pipelines share one layout, so the bound sets survive pipeline changes
+        if (descriptorsChanged)
+        {
+            psm.BindDescriptorSets(cmd);
+            ++stats.descriptorBinds;
+        }
+
+        if (vertexBufferChanged)
+        {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmd, 0, 1, &packet.vertexBuffer, &offset);
+            ++stats.vertexBufferBinds;
+        }
+        if (indexBufferChanged)
+        {
+            vkCmdBindIndexBuffer(cmd, packet.indexBuffer, 0, packet.indexType);
+            ++stats.indexBufferBinds;
+        }
+
+        // gl_InstanceIndex starts at firstInstance, so it also offsets the instance buffer reads
+        const uint32_t firstInstance = instanceCursor;
+        do
+        {
+            const GfxDrawPacket& merged = *entries[entry].packet;
+            for (uint32_t object = 0; object < merged.objectCount; ++object)
+            {
+                instances[instanceCursor++] = { merged.firstObject + object, merged.positionScaleBias };
+            }
+            ++entry;
+        } while (m_instancing && entry < entries.size() && CanMerge(packet, *entries[entry].packet));
+
+        const uint32_t instanceCount = instanceCursor - firstInstance;
+        if (commands)
+        {
+            if (!batchCount)
+                batchStart = commandCount;
+            commands[commandCount++] = { packet.indexCount, instanceCount, packet.firstIndex, packet.vertexOffset, firstInstance };
+            ++batchCount;
+        }
+        else
+        {
+            vkCmdDrawIndexed(cmd, packet.indexCount, instanceCount, packet.firstIndex, packet.vertexOffset, firstInstance);
+        }
+        ++stats.draws;
+        stats.instances += instanceCount;
+        previous = &packet;
+    }
+    flushBatch();
+    m_instanceStream.Commit(instanceCursor * sizeof(GfxInstance));
+    if (commands)
+        m_indirectStream.Commit(commandCount * sizeof(VkDrawIndexedIndirectCommand));
+
+    Clear();
+    return stats;
+}
\ No newline at end of file
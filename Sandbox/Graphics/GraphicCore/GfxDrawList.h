@@ -0,0 +1,113 @@
+#pragma once
+#ifdef _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#endif
+#include "vulkan/vulkan.h"
+
+#include "Includes/Defines.h"
+#include "GfxUniformBuffer.hpp"
+#include "GfxStructuredBuffer.h"
+#include "GfxFrameStream.h"
+#include "GfxVertex.h"
+#include "Engine/JobSystem.h"
+#include "Engine/FrameAllocator.h"
+#include "Graphics/ShaderManagement/GfxShader.h"
+
+#include <vector>
+
+// a mesh drawn once for each object in [firstObject, firstObject + objectCount)
+struct GfxDrawPacket
+{
+    const GfxShader* vertexShader;
+    const GfxShader* pixelShader;
+    // the material, bound from set 1 onwards
+    GfxUniformBufferBase* uniformBuffer;
+    // set 0, per object data indexed by the GfxInstance object index
+    GfxStructuredBuffer* objectBuffer;
+    VkBuffer vertexBuffer;
+    VkBuffer indexBuffer;
+    VkIndexType indexType;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t objectCount;
+    uint32_t firstObject;
+    // GfxMesh::positionScaleBias, the default leaves positions as they are stored
+    glm::vec4 positionScaleBias = { 1.0f, 1.0f, 0.0f, 0.0f };
+};
+
+struct GfxDrawListStats
+{
+    uint32_t draws;
+    uint32_t instances;
+    // vkCmdDrawIndexedIndirect calls the draws were batched into
+    uint32_t indirectDraws;
+    uint32_t pipelineBinds;
+    uint32_t descriptorBinds;
+    uint32_t vertexBufferBinds;
+    uint32_t indexBufferBinds;
+};
+
+// collects draw packets from any number of threads and records them in one go
+// every thread adds to its own bucket (by GraphicEngine thread id) so adding takes no locks, buckets and the sort
+// live in the adding/submitting thread's frame arena, so packets have to be submitted in the frame they were added
+// in. submission radix sorts
+// the packets by a 64 bit key (pipeline, then material and mesh, then depth) and only records the state that changes
+// between neighbouring packets
+// neighbouring packets with the same mesh, pipeline and material are merged into one instanced draw, their object
+// indices and mesh position scale/bias are written to a per frame instance buffer bound at binding 1. the scale/bias
+// is per instance rather than a push constant so draws of different meshes can still share one multi draw
+// with indirect drawing the draw arguments go to a per frame indirect buffer instead, and every run of draws that
+// only differ in their arguments (eg. different meshes of GfxMeshRegistry) is recorded as one multi draw
+class GfxDrawList
+{
+public:
+    // key layout from the most significant bits, sorting by key groups draws by pipeline first
+    static const uint32_t c_pipelineBits = 16;
+    static const uint32_t c_materialBits = 16;
+    static const uint32_t c_depthBits = 24;
+    // pipeline and material/mesh ids are hashed from the packet, depth in [0, 1] sorts front to back
+    static uint64_t MakeSortKey(const GfxDrawPacket& packet, float depth);
+
+    void Add(const GfxDrawPacket& packet, float depth = 0.0f);
+    void AddWithKey(const GfxDrawPacket& packet, uint64_t sortKey);
+
+    // records every packet into the current command buffer inside the current render pass, unsorted keeps the
+    // order packets were added in (per thread bucket). the list is cleared afterwards
+    GfxDrawListStats Submit(bool sort = true);
+    void Clear();
+    // no frames using the instance or indirect buffers can be in flight
+    void CleanUp();
+
+    // off records one draw per packet, for comparison
+    void SetInstancing(bool enabled) { m_instancing = enabled; }
+    // needs drawIndirectFirstInstance, without multiDrawIndirect every indirect draw is recorded separately
+    void SetIndirect(bool enabled) { m_indirect = enabled; }
+
+    uint32_t GetPacketCount() const;
+
+private:
+    struct Bucket
+    {
+        FrameVector<GfxDrawPacket> packets;
+        FrameVector<uint64_t> keys;
+        // reserved up front on the first add of a frame, so the arena doesn't fill up with outgrown copies
+        size_t lastCount = 0;
+    };
+
+    struct SortEntry
+    {
+        uint64_t key;
+        const GfxDrawPacket* packet;
+    };
+
+    // one bucket per job system thread, indexed by GraphicEngine::GetThreadId
+    Bucket m_buckets[JobSystem::c_maxThreads];
+    GfxFrameStream m_instanceStream{ VK_BUFFER_USAGE_VERTEX_BUFFER_BIT };
+    GfxFrameStream m_indirectStream{ VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT };
+    bool m_instancing = true;
+    bool m_indirect = true;
+
+    static void RadixSort(FrameVector<SortEntry>& entries, FrameVector<SortEntry>& scratch);
+    static bool CanMerge(const GfxDrawPacket& a, const GfxDrawPacket& b);
+};
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "GfxFrameCapture.h"
+
+#ifdef _MSC_VER
+#pragma warning(push, 0)
+#define STBI_MSC_SECURE_CRT
+#endif
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "STB/stb_image_write.h"
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+void GfxFrameCapture::Init(GfxDevice& device, uint32_t maxFramesInFlight)
+{
+    m_device = &device;
+    m_frames.resize(maxFramesInFlight);
+}
+
+void GfxFrameCapture::CleanUp()
+{
+    for (auto& frame : m_frames)
+    {
+        if (frame.buffer.GetSize())
+            frame.buffer.CleanUp();
+    }
+    m_frames.clear();
+}
+
+void GfxFrameCapture::Record(const GfxCommandBuffer& commandBuffer, uint32_t frameIndex, const std::string& path)
+{
+    GfxSwapChain& swapChain = m_device->GetSwapChain();
+    if (!swapChain.SupportsCapture())
+    {
+        Log<Severe>("Swapchain does not support transfers, skipping capture %s\n", path.c_str());
+        return;
+    }
+
+    FrameReadback& frame = m_frames[frameIndex];
+    assert(!frame.pending);
+
+    frame.extent = swapChain.GetVkExtent();
+    frame.format = swapChain.GetSwapChainFormat();
+    frame.path = path;
+
+    size_t size = size_t(frame.extent.width) * frame.extent.height * 4;
+    if (frame.buffer.GetSize() != size)
+    {
+        if (frame.buffer.GetSize())
+            frame.buffer.CleanUp();
+        frame.buffer.CreateBuffer(*m_device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+
+    VkImage image = swapChain.GetCurrentImage();
+
+    // render pass leaves the image ready for presenting
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { frame.extent.width, frame.extent.height, 1 };
+
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.buffer, 1, &region);
+
+    // back to present, and make the copy visible to the host once the fence is signaled
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkBufferMemoryBarrier bufferBarrier{};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = frame.buffer;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+    frame.pending = true;
+}
+
+void GfxFrameCapture::Resolve(uint32_t frameIndex)
+{
+    if (frameIndex >= m_frames.size())
+        return;
+
+    FrameReadback& frame = m_frames[frameIndex];
+    if (!frame.pending)
+        return;
+    frame.pending = false;
+
+    CPU_ProfileZone(ResolveCapture);
+    const uint8_t* pixels = reinterpret_cast<const uint8_t*>(frame.buffer.Map());
+
+    size_t pixelCount = size_t(frame.extent.width) * frame.extent.height;
+    std::vector<uint8_t> rgba(pixelCount * 4);
+
+    bool bgr = frame.format == VK_FORMAT_B8G8R8A8_SRGB || frame.format == VK_FORMAT_B8G8R8A8_UNORM;
+    for (size_t i = 0; i < pixelCount; ++i)
+    {
+        rgba[i * 4 + 0] = pixels[i * 4 + (bgr ? 2 : 0)];
+        rgba[i * 4 + 1] = pixels[i * 4 + 1];
+        rgba[i * 4 + 2] = pixels[i * 4 + (bgr ? 0 : 2)];
+        rgba[i * 4 + 3] = 255;
+    }
+    frame.buffer.Unmap();
+
+    if (!stbi_write_png(frame.path.c_str(), frame.extent.width, frame.extent.height, 4, rgba.data(), frame.extent.width * 4))
+    {
+        Log<Severe>("Failed to write capture %s\n", frame.path.c_str());
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#ifdef _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#endif
+#include "vulkan/vulkan.h"
+
+#include "Includes/Defines.h"
+#include "GraphicDefines.hpp"
+#include "GfxDevice.h"
+#include "GfxBuffer.h"
+#include "GfxCommandPool.h"
+
+#include <string>
+#include <vector>
+
+// reads back swapchain images into host memory and writes them to disk
+// readback is asynchronous, the image is only written once the frame's fence has been waited on
+class GfxFrameCapture
+{
+    struct FrameReadback
+    {
+        GfxBuffer buffer;
+        bool pending = false;
+        std::string path;
+        VkExtent2D extent;
+        VkFormat format;
+    };
+
+    std::vector<FrameReadback> m_frames;
+    GfxDevice* m_device = nullptr;
+public:
+    void Init(GfxDevice& device, uint32_t maxFramesInFlight);
+    void CleanUp();
+
+    // records a copy of the current swapchain image, call outside of a render pass after rendering
+    void Record(const GfxCommandBuffer& commandBuffer, uint32_t frameIndex, const std::string& path);
+    // writes out the readback of the frame if it has one, frame must have retired
+    void Resolve(uint32_t frameIndex);
+};
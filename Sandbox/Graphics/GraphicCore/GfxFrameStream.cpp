@@ -0,0 +1,67 @@
+#include "GfxFrameStream.h"
+#include "GraphicEngine.h"
+
+#include <algorithm>
+
+void GfxFrameStream::CleanUp()
+{
+    for (FrameBuffer& frame : m_frames)
+    {
+        if (frame.mapped)
+        {
+            frame.buffer.Unmap();
+            frame.buffer.CleanUp();
+        }
+        for (GfxBuffer& buffer : frame.retired)
+        {
+            buffer.CleanUp();
+        }
+    }
+    m_frames.clear();
+    m_current = nullptr;
+}
+
+uint8_t* GfxFrameStream::Reserve(size_t size)
+{
+    GraphicEngine& ge = GraphicEngine::GetInstance();
+    if (m_frames.empty())
+        m_frames.resize(ge.MAX_FRAMES_IN_FLIGHT);
+
+    FrameBuffer& frame = m_frames[ge.GetCurrentFrame()];
+    m_current = &frame;
+    if (frame.frame != ge.GetFrameCount())
+    {
+        // StartFrame waited on this frame slot's fence, nothing written the last time around is still read
+        for (GfxBuffer& buffer : frame.retired)
+        {
+            buffer.CleanUp();
+        }
+        frame.retired.clear();
+        frame.used = 0;
+        frame.frame = ge.GetFrameCount();
+    }
+
+    if (frame.used + size > frame.capacity)
+    {
+        if (frame.mapped)
+        {
+            frame.buffer.Unmap();
+            // commands recorded earlier this frame still point at the old buffer
+            if (frame.used)
+                frame.retired.push_back(frame.buffer);
+            else
+                frame.buffer.CleanUp();
+            frame.used = 0;
+        }
+        frame.capacity = std::max({ size, frame.capacity * 2, size_t(4096) });
+        frame.buffer.CreateBuffer(ge.GetDevice(), frame.capacity, m_usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        frame.mapped = static_cast<uint8_t*>(frame.buffer.Map());
+    }
+    return frame.mapped + frame.used;
+}
+
+void GfxFrameStream::Commit(size_t size)
+{
+    assert(m_current && m_current->used + size <= m_current->capacity);
+    m_current->used += size;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifdef _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#endif
+#include "vulkan/vulkan.h"
+
+#include "Includes/Defines.h"
+#include "GfxBuffer.h"
+
+#include <vector>
+
+// host visible buffer per frame in flight that the cpu writes through a persistent mapping and the gpu reads
+// during the same frame (instance data, indirect commands, upload staging)
+// everything written in a frame stays valid until the frame slot comes around again, growing during a frame moves
+// to a new buffer and keeps the old one alive until then
+class GfxFrameStream
+{
+    struct FrameBuffer
+    {
+        GfxBuffer buffer;
+        uint8_t* mapped = nullptr;
+        size_t capacity = 0;
+        size_t used = 0;
+        // frame the buffer was last written in, the first reserve of a later frame starts over
+        uint64_t frame = ~0ull;
+        std::vector<GfxBuffer> retired;
+    };
+
+    std::vector<FrameBuffer> m_frames;
+    VkBufferUsageFlags m_usage = 0;
+    FrameBuffer* m_current = nullptr;
+
+public:
+    explicit GfxFrameStream(VkBufferUsageFlags usage) : m_usage(usage) {}
+    // no frames using the buffers can be in flight
+    void CleanUp();
+
+    // room for size more bytes in the current frame's buffer, returns where they start
+    // GetBuffer/GetOffset are only valid for the reserved bytes until the next Reserve
+    uint8_t* Reserve(size_t size);
+    // marks size bytes from the last Reserve as used
+    void Commit(size_t size);
+
+    // the buffer and offset the last Reserve returned memory in
+    GfxBuffer& GetBuffer() { return m_current->buffer; }
+    size_t GetOffset() const { return m_current->used; }
+};
@@ -0,0 +1,204 @@
+#include "GfxGpuProfiler.h"
+#include "GraphicEngine.h"
+
+#include <cstdio>
+
+namespace
+{
+    const char* c_frameScopeName = "Frame";
+}
+
+void GfxGpuProfiler::Init(GfxDevice& device, uint32_t maxFramesInFlight)
+{
+    m_device = &device;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    m_timestampPeriod = properties.limits.timestampPeriod;
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, families.data());
+
+    uint32_t validBits = families[device.GetQueueFamily().graphicsFamily.value()].timestampValidBits;
+    if (validBits == 0)
+    {
+        Log<Severe>("Graphics queue does not support timestamps, gpu profiler disabled\n");
+        return;
+    }
+    m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = c_maxScopes * 2;
+
+    m_frames.resize(maxFramesInFlight);
+    for (auto& frame : m_frames)
+    {
+        API_CALL(vkCreateQueryPool, device, &queryPoolInfo, nullptr, &frame.queryPool);
+        frame.scopes.reserve(c_maxScopes);
+    }
+    m_scopeStack.reserve(c_maxScopes);
+    m_lastFrameTimings.reserve(c_maxScopes);
+}
+
+void GfxGpuProfiler::CleanUp()
+{
+    for (auto& frame : m_frames)
+    {
+        vkDestroyQueryPool(*m_device, frame.queryPool, nullptr);
+    }
+    m_frames.clear();
+}
+
+void GfxGpuProfiler::BeginFrame(uint32_t frameIndex, uint64_t frameId)
+{
+    if (!IsEnabled())
+        return;
+
+    Resolve(frameIndex);
+
+    FrameQueries& frame = m_frames[frameIndex];
+    frame.scopes.clear();
+    frame.needsReset = true;
+    frame.frameId = frameId;
+
+    m_recordingFrame = frameIndex;
+    m_frameCommandBuffer = VK_NULL_HANDLE;
+    m_scopeStack.clear();
+}
+
+void GfxGpuProfiler::BeginCommandBuffer(VkCommandBuffer commandBuffer)
+{
+    if (m_recordingFrame == ~0u)
+        return;
+
+    FrameQueries& frame = m_frames[m_recordingFrame];
+    if (!frame.needsReset)
+        return;
+
+    // queries have to be reset outside of a render pass before they are written
+    vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, c_maxScopes * 2);
+    frame.needsReset = false;
+    frame.pending = true;
+
+    m_frameCommandBuffer = commandBuffer;
+    BeginScope(commandBuffer, c_frameScopeName);
+}
+
+void GfxGpuProfiler::EndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+    if (m_recordingFrame == ~0u || commandBuffer != m_frameCommandBuffer)
+        return;
+
+    // scopes left open are closed with the frame so they still produce a timing
+    while (!m_scopeStack.empty())
+    {
+        EndScope(commandBuffer, m_scopeStack.back());
+    }
+    m_recordingFrame = ~0u;
+    m_frameCommandBuffer = VK_NULL_HANDLE;
+}
+
+uint32_t GfxGpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char* name)
+{
+    if (m_recordingFrame == ~0u)
+        return ~0u;
+
+    FrameQueries& frame = m_frames[m_recordingFrame];
+    if (frame.needsReset || frame.scopes.size() >= c_maxScopes)
+        return ~0u;
+
+    uint32_t scope = uint32_t(frame.scopes.size());
+    frame.scopes.push_back({ name, uint32_t(m_scopeStack.size()), false });
+    m_scopeStack.push_back(scope);
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, scope * 2);
+    return scope;
+}
+
+void GfxGpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+    if (m_recordingFrame == ~0u || scope == ~0u)
+        return;
+
+    FrameQueries& frame = m_frames[m_recordingFrame];
+    // scopes are strictly nested, anything opened after this one is closed with it
+    while (!m_scopeStack.empty())
+    {
+        uint32_t top = m_scopeStack.back();
+        m_scopeStack.pop_back();
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, top * 2 + 1);
+        frame.scopes[top].closed = true;
+        if (top == scope)
+            break;
+    }
+}
+
+bool GfxGpuProfiler::Resolve(uint32_t frameIndex)
+{
+    if (!IsEnabled())
+        return false;
+
+    FrameQueries& frame = m_frames[frameIndex];
+    if (!frame.pending)
+        return false;
+    frame.pending = false;
+
+    uint32_t queryCount = uint32_t(frame.scopes.size()) * 2;
+    if (queryCount == 0)
+        return false;
+
+    uint64_t timestamps[c_maxScopes * 2];
+    VkResult result = vkGetQueryPoolResults(*m_device, frame.queryPool, 0, queryCount, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+    {
+        Log<Severe>("Failed to read back gpu timestamps %d\n", result);
+        return false;
+    }
+
+    m_lastFrameTimings.clear();
+    m_lastFrameMs = 0;
+    for (uint32_t i = 0; i < frame.scopes.size(); ++i)
+    {
+        const Scope& scope = frame.scopes[i];
+        if (!scope.closed)
+            continue;
+
+        uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & m_timestampMask;
+        double ms = double(ticks) * m_timestampPeriod / 1000000.0;
+
+        auto average = m_averages.try_emplace(scope.name, ms).first;
+        average->second += (ms - average->second) * c_averageWeight;
+
+        m_lastFrameTimings.push_back({ scope.name, scope.depth, ms, average->second });
+        if (i == 0)
+            m_lastFrameMs = ms;
+    }
+    m_lastFrameId = frame.frameId;
+    return true;
+}
+
+void GfxGpuProfiler::PrintTimings() const
+{
+    printf("gpu frame %llu\n", static_cast<unsigned long long>(m_lastFrameId));
+    printf("  %-40s %10s %10s\n", "scope", "ms", "avg ms");
+    for (const auto& timing : m_lastFrameTimings)
+    {
+        printf("  %*s%-*s %10.4f %10.4f\n", int(timing.depth * 2), "", int(40 - timing.depth * 2), timing.name, timing.ms, timing.averageMs);
+    }
+}
+
+GfxGpuProfileScope::GfxGpuProfileScope(const char* name)
+{
+    GraphicEngine& ge = GraphicEngine::GetInstance();
+    m_scope = ge.GetGpuProfiler().BeginScope(ge.GetCurrentCommandBuffer(), name);
+}
+
+GfxGpuProfileScope::~GfxGpuProfileScope()
+{
+    GraphicEngine& ge = GraphicEngine::GetInstance();
+    ge.GetGpuProfiler().EndScope(ge.GetCurrentCommandBuffer(), m_scope);
+}
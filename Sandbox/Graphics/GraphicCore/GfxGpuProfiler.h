@@ -0,0 +1,102 @@
+#pragma once
+#ifdef _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#endif
+#include "vulkan/vulkan.h"
+
+#include "Includes/Defines.h"
+#include "GraphicDefines.hpp"
+#include "GfxDevice.h"
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct GfxGpuScopeTiming
+{
+    const char* name;
+    uint32_t depth;
+    double ms;
+    // exponential moving average over the frames the scope appeared in
+    double averageMs;
+};
+
+// timestamp query based gpu profiler, works without tracy and in release builds
+// every frame in flight owns a query pool, results are read back once the frame's fence has been waited on
+// scopes must be recorded from the thread that records the frame
+class GfxGpuProfiler
+{
+    static const uint32_t c_maxScopes = 256;
+    static constexpr double c_averageWeight = 0.05;
+
+    struct Scope
+    {
+        const char* name;
+        uint32_t depth;
+        // the end query is 2 * index + 1, unset until the scope is closed
+        bool closed;
+    };
+
+    struct FrameQueries
+    {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        std::vector<Scope> scopes;
+        bool needsReset = true;
+        bool pending = false;
+        uint64_t frameId = 0;
+    };
+
+    GfxDevice* m_device = nullptr;
+    std::vector<FrameQueries> m_frames;
+    double m_timestampPeriod = 0;
+    uint64_t m_timestampMask = 0;
+
+    // frame currently being recorded, invalid outside of StartFrame .. the end of the frame's first command buffer
+    uint32_t m_recordingFrame = ~0u;
+    VkCommandBuffer m_frameCommandBuffer = VK_NULL_HANDLE;
+    std::vector<uint32_t> m_scopeStack;
+
+    std::vector<GfxGpuScopeTiming> m_lastFrameTimings;
+    uint64_t m_lastFrameId = 0;
+    double m_lastFrameMs = 0;
+    std::unordered_map<std::string_view, double> m_averages;
+
+public:
+    void Init(GfxDevice& device, uint32_t maxFramesInFlight);
+    void CleanUp();
+
+    bool IsEnabled() const { return !m_frames.empty(); }
+
+    // frame slot has retired, reads back its results and starts recording into it again
+    void BeginFrame(uint32_t frameIndex, uint64_t frameId);
+    // resets the frame's queries and opens the frame scope on the first command buffer of the frame
+    void BeginCommandBuffer(VkCommandBuffer commandBuffer);
+    // closes the frame scope if this is the command buffer it was opened on
+    void EndCommandBuffer(VkCommandBuffer commandBuffer);
+
+    // returns the scope index to pass to EndScope, ~0u if the scope was dropped
+    uint32_t BeginScope(VkCommandBuffer commandBuffer, const char* name);
+    void EndScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    // reads back the results of a retired frame slot, returns false if it had none
+    bool Resolve(uint32_t frameIndex);
+
+    // timings of the most recently resolved frame in recording order, children follow their parent
+    const std::vector<GfxGpuScopeTiming>& GetLastFrameTimings() const { return m_lastFrameTimings; }
+    uint64_t GetLastFrameId() const { return m_lastFrameId; }
+    double GetLastFrameTime() const { return m_lastFrameMs; }
+
+    void PrintTimings() const;
+};
+
+// records a gpu timestamp scope on the current command buffer for the lifetime of the object
+class GfxGpuProfileScope
+{
+    uint32_t m_scope;
+public:
+    explicit GfxGpuProfileScope(const char* name);
+    ~GfxGpuProfileScope();
+
+    GfxGpuProfileScope(const GfxGpuProfileScope&) = delete;
+    GfxGpuProfileScope& operator=(const GfxGpuProfileScope&) = delete;
+};
@@ -1,5 +1,7 @@
 #pragma once
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include "vulkan/vulkan.h"
 
 #include "Includes/Defines.h"
@@ -24,8 +26,8 @@ public:
 
 class GfxImageView
 {
-    VkImageView m_imageView;
-    GfxDevice* m_device;
+    VkImageView m_imageView = VK_NULL_HANDLE;
+    GfxDevice* m_device = nullptr;
     VkFormat m_format;
     GfxImage* m_gfxImage = nullptr;
     VkImage m_vkImage;
@@ -0,0 +1,193 @@
+#include "GfxMeshRegistry.h"
+#include "GraphicEngine.h"
+
+#include <cstring>
+
+void GfxMeshRegistry::Init(GfxDevice& device, uint32_t maxVertices, uint32_t maxIndices)
+{
+    m_device = &device;
+    m_vertexAllocator.Init(maxVertices);
+    m_indexAllocator.Init(maxIndices);
+    m_vertexBuffer.CreateBuffer(device, size_t(maxVertices) * c_vertexStride, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_indexBuffer.CreateBuffer(device, size_t(maxIndices) * sizeof(uint16_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void GfxMeshRegistry::CleanUp()
+{
+    RemoveAllMeshes();
+    m_staging.CleanUp();
+    m_vertexBuffer.CleanUp();
+    m_indexBuffer.CleanUp();
+}
+
+void GfxMeshRegistry::ReleaseRetiredMeshes()
+{
+    GraphicEngine& ge = GraphicEngine::GetInstance();
+    for (size_t i = 0; i < m_retiredMeshes.size();)
+    {
+        const RetiredMesh& retired = m_retiredMeshes[i];
+        if (ge.GetFrameCount() < retired.retireFrame + ge.MAX_FRAMES_IN_FLIGHT)
+        {
+            ++i;
+            continue;
+        }
+        m_vertexAllocator.Free(uint32_t(retired.mesh.vertexOffset), retired.mesh.vertexCount);
+        m_indexAllocator.Free(retired.mesh.firstIndex, retired.mesh.indexCount);
+        m_retiredMeshes[i] = m_retiredMeshes.back();
+        m_retiredMeshes.pop_back();
+    }
+}
+
+MeshID GfxMeshRegistry::AddMesh(std::span<const GfxStandardVertex> vertices, std::span<const uint16_t> indices)
+{
+    ReleaseRetiredMeshes();
+
+    const uint32_t vertexOffset = m_vertexAllocator.Allocate(uint32_t(vertices.size()));
+    if (vertexOffset == RangeAllocator::c_invalidOffset)
+        throw std::runtime_error("mesh registry is out of vertex space");
+    const uint32_t firstIndex = m_indexAllocator.Allocate(uint32_t(indices.size()));
+    if (firstIndex == RangeAllocator::c_invalidOffset)
+    {
+        m_vertexAllocator.Free(vertexOffset, uint32_t(vertices.size()));
+        throw std::runtime_error("mesh registry is out of index space");
+    }
+
+    GfxMesh mesh;
+    mesh.firstIndex = firstIndex;
+    mesh.indexCount = uint32_t(indices.size());
+    mesh.vertexOffset = int32_t(vertexOffset);
+    mesh.vertexCount = uint32_t(vertices.size());
+    glm::vec2 boundsMin = vertices.empty() ? glm::vec2(0.0f) : vertices[0].pos;
+    glm::vec2 boundsMax = boundsMin;
+    for (const GfxStandardVertex& vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+    // flat meshes still need a non zero scale to divide by
+    const glm::vec2 halfExtent = glm::max((boundsMax - boundsMin) * 0.5f, glm::vec2(1e-6f));
+    const glm::vec2 center = (boundsMin + boundsMax) * 0.5f;
+    mesh.positionScaleBias = glm::vec4(halfExtent, center);
+
+    size_t id = m_meshes.size();
+    if (m_freeMeshIds.empty())
+    {
+        m_meshes.push_back(mesh);
+    }
+    else
+    {
+        id = m_freeMeshIds.back();
+        m_freeMeshIds.pop_back();
+        m_meshes[id] = mesh;
+    }
+
+    const size_t dataOffset = m_pendingData.size();
+    const size_t vertexBytes = vertices.size() * c_vertexStride;
+    m_pendingData.resize(dataOffset + vertexBytes + indices.size_bytes());
+    // converted to the compact gpu layout here, nothing else sees it
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        GfxStandardVertex::Encode(vertices[i], mesh.positionScaleBias, m_pendingData.data() + dataOffset + i * c_vertexStride);
+    }
+    memcpy(m_pendingData.data() + dataOffset + vertexBytes, indices.data(), indices.size_bytes());
+    m_pendingUploads.push_back({ id, dataOffset });
+
+    return MeshID(id);
+}
+
+void GfxMeshRegistry::RemoveMesh(MeshID meshID)
+{
+    // a mesh that never made it to the gpu doesn't need copying any more
+    for (PendingUpload& upload : m_pendingUploads)
+    {
+        if (upload.mesh == meshID.id)
+            upload.mesh = ~size_t(0);
+    }
+    m_retiredMeshes.push_back({ m_meshes[meshID.id], GraphicEngine::GetInstance().GetFrameCount() });
+    m_meshes[meshID.id] = {};
+    m_freeMeshIds.push_back(uint32_t(meshID.id));
+}
+
+void GfxMeshRegistry::RecordUploads(const GfxCommandBuffer& commandBuffer, GfxBuffer& staging, size_t stagingOffset)
+{
+    for (const PendingUpload& upload : m_pendingUploads)
+    {
+        if (upload.mesh == ~size_t(0))
+            continue;
+        const GfxMesh& mesh = m_meshes[upload.mesh];
+        const size_t vertexBytes = mesh.vertexCount * c_vertexStride;
+        const size_t srcOffset = stagingOffset + upload.dataOffset;
+        if (mesh.vertexCount)
+            staging.CopyTo(m_vertexBuffer, commandBuffer, vertexBytes, srcOffset, size_t(mesh.vertexOffset) * c_vertexStride);
+        if (mesh.indexCount)
+            staging.CopyTo(m_indexBuffer, commandBuffer, mesh.indexCount * sizeof(uint16_t), srcOffset + vertexBytes, size_t(mesh.firstIndex) * sizeof(uint16_t));
+    }
+
+    // the copies have to land before any draw of this frame reads the vertices
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    m_pendingUploads.clear();
+    m_pendingData.clear();
+}
+
+void GfxMeshRegistry::Upload()
+{
+    if (m_pendingUploads.empty())
+        return;
+
+    GraphicEngine& ge = GraphicEngine::GetInstance();
+    GfxBuffer staging;
+    staging.CreateBuffer(*m_device, m_pendingData.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    memcpy(staging.Map(), m_pendingData.data(), m_pendingData.size());
+    staging.Unmap();
+
+    ge.BeginOutOfFrameRecording();
+    ge.BeginRecordingGraphics();
+    RecordUploads(ge.GetCurrentCommandBuffer(), staging, 0);
+    ge.EndRecording();
+    ge.Submit();
+    ge.EndOutOfFrameRecording();
+    // the staging buffer goes away with this call
+    API_CALL(vkQueueWaitIdle, m_device->GetGraphicsQueue());
+    staging.CleanUp();
+}
+
+void GfxMeshRegistry::FlushUploads()
+{
+    ReleaseRetiredMeshes();
+    if (m_pendingUploads.empty())
+        return;
+
+    CPU_ProfileZone(MeshUploads);
+    memcpy(m_staging.Reserve(m_pendingData.size()), m_pendingData.data(), m_pendingData.size());
+    const size_t stagingOffset = m_staging.GetOffset();
+    m_staging.Commit(m_pendingData.size());
+    RecordUploads(GraphicEngine::GetInstance().GetCurrentCommandBuffer(), m_staging.GetBuffer(), stagingOffset);
+}
+
+void GfxMeshRegistry::RemoveAllMeshes()
+{
+    m_meshes.clear();
+    m_freeMeshIds.clear();
+    m_pendingUploads.clear();
+    m_pendingData.clear();
+    m_retiredMeshes.clear();
+    m_vertexAllocator.Reset();
+    m_indexAllocator.Reset();
+}
+
+void GfxMeshRegistry::FillPacket(GfxDrawPacket& packet, MeshID meshID)
+{
+    const GfxMesh& mesh = m_meshes[meshID.id];
+    packet.vertexBuffer = m_vertexBuffer;
+    packet.indexBuffer = m_indexBuffer;
+    packet.indexType = c_indexType;
+    packet.indexCount = mesh.indexCount;
+    packet.firstIndex = mesh.firstIndex;
+    packet.vertexOffset = mesh.vertexOffset;
+    packet.positionScaleBias = mesh.positionScaleBias;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "Includes/Defines.h"
+#include "vulkan/vulkan.h"
+#include "Engine/RangeAllocator.h"
+#include "GfxDevice.h"
+#include "GfxBuffer.h"
+#include "GfxFrameStream.h"
+#include "GfxVertex.h"
+#include "GfxDrawList.h"
+
+#include <span>
+#include <vector>
+
+// where a mesh lives in the shared vertex and index buffers
+struct GfxMesh
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+    // half extent (xy) and center (zw) of the mesh's bounds, positions are stored as snorm16 relative to them
+    glm::vec4 positionScaleBias;
+};
+
+struct MeshID
+{
+    size_t id;
+};
+
+// packs every mesh into one vertex and one index buffer so draws of different meshes only differ in their draw
+// arguments, the buffers are bound once and GfxDrawList can batch the draws into a single indirect draw
+// vertex and index ranges are suballocated from free lists. added meshes are staged on the cpu until Upload (outside
+// of a frame) or FlushUploads (inside one), removed meshes keep their ranges until no frame in flight can draw them
+// not thread safe, meshes are added and removed on the thread that renders
+class GfxMeshRegistry
+{
+    DefaultSingleton(GfxMeshRegistry);
+private:
+    GfxMeshRegistry() = default;
+    GfxDevice* m_device;
+    GfxBuffer m_vertexBuffer;
+    GfxBuffer m_indexBuffer;
+    RangeAllocator m_vertexAllocator;
+    RangeAllocator m_indexAllocator;
+
+    std::vector<GfxMesh> m_meshes;
+    std::vector<uint32_t> m_freeMeshIds;
+
+    struct PendingUpload
+    {
+        size_t mesh;
+        // vertices followed by indices in m_pendingData
+        size_t dataOffset;
+    };
+    std::vector<PendingUpload> m_pendingUploads;
+    std::vector<uint8_t> m_pendingData;
+
+    struct RetiredMesh
+    {
+        GfxMesh mesh;
+        uint64_t retireFrame;
+    };
+    std::vector<RetiredMesh> m_retiredMeshes;
+
+    GfxFrameStream m_staging{ VK_BUFFER_USAGE_TRANSFER_SRC_BIT };
+
+    void ReleaseRetiredMeshes();
+    // records the pending copies from staging (holding m_pendingData at stagingOffset) and clears them
+    void RecordUploads(const GfxCommandBuffer& commandBuffer, GfxBuffer& staging, size_t stagingOffset);
+public:
+    static const VkIndexType c_indexType = VK_INDEX_TYPE_UINT16;
+    static const uint32_t c_vertexStride = GfxStandardVertex::Layout::c_stride;
+
+    void Init(GfxDevice& device, uint32_t maxVertices = 1 << 20, uint32_t maxIndices = 1 << 22);
+    void CleanUp();
+
+    // indices are relative to the mesh's own vertices, throws if the buffers have no room left
+    MeshID AddMesh(std::span<const GfxStandardVertex> vertices, std::span<const uint16_t> indices);
+    // the id can be handed out again straight away, the ranges once frames in flight are done with them
+    void RemoveMesh(MeshID mesh);
+    // copies meshes added since the last upload to the gpu and waits for it, call outside of a frame
+    void Upload();
+    // records the copies of meshes added since the last upload into the current command buffer, call inside a frame
+    // before the render pass that draws them
+    void FlushUploads();
+    // no frames using the meshes can be in flight
+    void RemoveAllMeshes();
+
+    const GfxMesh& GetMesh(MeshID mesh) const { return m_meshes[mesh.id]; }
+    size_t GetMeshCount() const { return m_meshes.size() - m_freeMeshIds.size(); }
+    uint32_t GetFreeVertices() const { return m_vertexAllocator.GetFreeCount(); }
+    uint32_t GetFreeIndices() const { return m_indexAllocator.GetFreeCount(); }
+    // sets the buffers and draw arguments of packet to draw mesh
+    void FillPacket(GfxDrawPacket& packet, MeshID mesh);
+
+    GfxBuffer& GetVertexBuffer() { return m_vertexBuffer; }
+    GfxBuffer& GetIndexBuffer() { return m_indexBuffer; }
+};
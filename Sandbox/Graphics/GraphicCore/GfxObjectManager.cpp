@@ -5,17 +5,22 @@
 #include "Engine/PlatformManager.h"
 #include "../ShaderManagement/GfxShaderManager.h"
 #include "GfxPipelineStateManager.h"
+#include "../autogen/ShaderData.h"
 
 #include <vector>
+#include <cassert>
 #include "GfxObjectManager.h"
 
+// the objects are uploaded as is, so they have to match what the shaders index
+static_assert(ShaderStructs::StorageBuffer::GlobalTransformStride == sizeof(GfxObject));
+
 void GfxObjectManager::Init(GfxDevice& device, uint32_t maxFrames)
 {
     m_buffer.resize(maxFrames);
     for (uint32_t i = 0; i < maxFrames; ++i)
     {
-        m_buffer[i].CreateLayout(device);
-        m_buffer[i].CreateBuffer(c_maxObjects * sizeof(GfxObject));
+        m_buffer[i].CreateLayout(device, ShaderStructs::StorageBuffer::Set);
+        m_buffer[i].CreateBuffer(m_maxObjects * sizeof(GfxObject));
     }
 }
 
@@ -24,12 +29,27 @@ void GfxObjectManager::CleanUp()
     for (uint32_t i = 0; i < m_buffer.size(); ++i)
     {
         m_buffer[i].CleanUp();
-        m_buffer[i].CleanUpLayouts();
     }
 }
 
+void GfxObjectManager::SetCapacity(uint32_t maxObjects)
+{
+    assert(m_objectList.size() <= maxObjects);
+    m_maxObjects = maxObjects;
+    for (uint32_t i = 0; i < m_buffer.size(); ++i)
+    {
+        m_buffer[i].Resize(m_maxObjects * sizeof(GfxObject));
+    }
+}
+
+void GfxObjectManager::RemoveAllObjects()
+{
+    m_objectList.clear();
+}
+
 ObjectID GfxObjectManager::AddObject(GfxObject obj)
 {
+    assert(m_objectList.size() < m_maxObjects);
     m_objectList.emplace_back(obj);
     return ObjectID(m_objectList.size() - 1);
 }
@@ -41,8 +61,14 @@ void GfxObjectManager::UpdateObject(ObjectID objectID, GfxObject obj)
 
 void GfxObjectManager::UpdateBuffers(uint32_t currentFrame)
 {
+    UpdateBuffers(currentFrame, m_objectList.data(), m_objectList.size());
+}
+
+void GfxObjectManager::UpdateBuffers(uint32_t currentFrame, const GfxObject* objects, size_t count)
+{
+    assert(count <= m_maxObjects);
     m_currentFrame = currentFrame;
-    m_buffer[currentFrame].UpdateBuffer(m_objectList.data(), 0, m_objectList.size() * sizeof(m_objectList[0]));
+    m_buffer[currentFrame].UpdateBuffer(objects, 0, count * sizeof(GfxObject));
 }
 
 GfxStructuredBuffer& GfxObjectManager::GetBuffer()
@@ -15,18 +15,27 @@ private:
     // sorted dirtyList (by size) for updated objects to move in
     // when updating just copying either the back or a large enough empty space
     std::vector<uint32_t> m_indexList; // eventually this will be used to track the elements pos in the object list
-    const uint32_t c_maxObjects = 256;
+    uint32_t m_maxObjects = 256;
     uint32_t m_currentFrame;
 public:
     void Init(GfxDevice& device, uint32_t maxFrames);
 
     void CleanUp();
 
+    // recreates the per frame buffers, no frames can be in flight
+    void SetCapacity(uint32_t maxObjects);
+    uint32_t GetCapacity() const { return m_maxObjects; }
+    void RemoveAllObjects();
+
     // return handle that will update position if the object is modified?
     ObjectID AddObject(GfxObject obj = {});
 
     void UpdateObject(ObjectID objectID, GfxObject obj);
     void UpdateBuffers(uint32_t currentFrame);
+    // uploads objects simulated elsewhere (eg. a frame handed to the render thread) instead of the stored ones
+    void UpdateBuffers(uint32_t currentFrame, const GfxObject* objects, size_t count);
+    size_t GetObjectCount() const { return m_objectList.size(); }
+    const GfxObject* GetObjects() const { return m_objectList.data(); }
 
     GfxStructuredBuffer& GetBuffer();
 };
\ No newline at end of file
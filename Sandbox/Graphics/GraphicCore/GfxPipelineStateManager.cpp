@@ -1,34 +1,36 @@
 #include "GfxPipelineStateManager.h"
 #include "GfxObjectManager.h"
 #include "GfxVertex.h"
+#include "Engine/JobSystem.h"
 
-GfxPipelineLayout& GfxPipelineStateManager::CreatePipelineLayout(uint32_t hash)
+void GfxPipelineStateManager::CommitStates(GfxCommandBuffer& commandBuffer)
 {
-    GfxPipelineLayout pipelineLayout;
-
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = m_setCount;
-    pipelineLayoutInfo.pSetLayouts = m_setLayouts;
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-    API_CALL(vkCreatePipelineLayout, *m_device, &pipelineLayoutInfo, nullptr, &pipelineLayout.pipelineLayout);
-
-    m_activePipelineLayout.insert({ hash, pipelineLayout });
-    return m_activePipelineLayout.at(hash);
+    BindPipeline(commandBuffer);
+    BindDescriptorSets(commandBuffer);
 }
 
-void GfxPipelineStateManager::CommitStates(GfxCommandBuffer& commandBuffer)
+void GfxPipelineStateManager::BindPipeline(VkCommandBuffer commandBuffer)
 {
     API_CALL(vkCmdBindPipeline, commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GetPipeline());
+}
 
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GetPipelineLayout(), 0, 1, (*m_structuredBuffer), 0, nullptr);
-    for (int i = 0; i < 3; ++i)
+void GfxPipelineStateManager::BindDescriptorSets(VkCommandBuffer commandBuffer)
+{
+    VkPipelineLayout layout = GetPipelineLayout();
+    const uint32_t setCount = GfxDescriptorLayoutCache::GetInstance().GetSetCount();
+    // one call per run of consecutive bound sets
+    for (uint32_t first = 0; first < setCount;)
     {
-        if (!m_uniformBuffer[i])
-            break;
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GetPipelineLayout(), i + 1, 1, *(m_uniformBuffer[i]), 0, nullptr);
+        if (!m_descriptorSets[first])
+        {
+            ++first;
+            continue;
+        }
+        uint32_t count = 1;
+        while (first + count < setCount && m_descriptorSets[first + count])
+            ++count;
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, first, count, &m_descriptorSets[first], 0, nullptr);
+        first += count;
     }
 }
 
@@ -36,22 +38,44 @@ GfxPipeline& GfxPipelineStateManager::CreatePipeline(uint32_t hash)
 {
     GfxPipeline pipe = {};
 
+    assert((m_vertexShader && m_pixelShader) || m_computeShader);
+    GfxPipelineDesc& desc = pipe.desc;
+    desc.vertexShader = m_vertexShader;
+    desc.pixelShader = m_pixelShader;
+    desc.computeShader = m_computeShader;
+    desc.topology = m_topology;
+    desc.polygonMode = m_polygonMode;
+    desc.renderPass = GetRenderState().renderPass;
+    for (; desc.attachmentCount < 8; ++desc.attachmentCount)
+    {
+        if (!m_RenderTargetImageView[desc.attachmentCount].has_value())
+            break;
+        desc.blendStates[desc.attachmentCount] = m_rtBlendStates[desc.attachmentCount];
+    }
+
+    pipe.pipeline = CreateVkPipeline(desc);
+
+    m_activePipelines.emplace(hash, pipe);
+    return m_activePipelines.at(hash);
+}
+
+VkPipeline GfxPipelineStateManager::CreateVkPipeline(const GfxPipelineDesc& desc) const
+{
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    assert((m_vertexShader && m_pixelShader) || m_computeShader);
     VkPipelineShaderStageCreateInfo shaderStages[2] = {};
-    if (m_vertexShader)
+    if (desc.vertexShader)
     {
         pipelineInfo.stageCount = 2;
 
         shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-        shaderStages[0].module = *m_vertexShader;
+        shaderStages[0].module = *desc.vertexShader;
         shaderStages[0].pName = "main";
 
         shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        shaderStages[1].module = *m_pixelShader;
+        shaderStages[1].module = *desc.pixelShader;
         shaderStages[1].pName = "main";
     }
     else
@@ -60,55 +84,101 @@ GfxPipeline& GfxPipelineStateManager::CreatePipeline(uint32_t hash)
 
         shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[0].stage = VK_SHADER_STAGE_COMPUTE_BIT;
-        shaderStages[0].module = *m_computeShader;
+        shaderStages[0].module = *desc.computeShader;
         shaderStages[0].pName = "main";
     }
     pipelineInfo.pStages = shaderStages;
 
-    GfxPipelineLayout layout = GetPipelineLayout();
-    pipelineInfo.layout = layout.pipelineLayout;
+    pipelineInfo.layout = m_pipelineLayout.pipelineLayout;
 
-    GfxRenderState renderstate = GetRenderState();
-    pipelineInfo.renderPass = renderstate.renderPass;
+    pipelineInfo.renderPass = desc.renderPass;
     pipelineInfo.subpass = 0;
 
     PipelineMiscInfo pipelineMisc = {};
 
-    FillPipelineCreateMiscInfo(pipelineInfo, pipelineMisc);
+    FillPipelineCreateMiscInfo(pipelineInfo, pipelineMisc, desc);
 
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
     pipelineInfo.basePipelineIndex = -1; // Optional
 
-    API_CALL(vkCreateGraphicsPipelines, *m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipe.pipeline);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    API_CALL(vkCreateGraphicsPipelines, *m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    return pipeline;
+}
 
-    m_activePipelines.emplace(hash, pipe);
-    return m_activePipelines.at(hash);
+uint32_t GfxPipelineStateManager::RebuildPipelines(const std::vector<const GfxShader*>& shaders, JobCounter& counter)
+{
+    std::vector<Job> jobs;
+    for (auto& entry : m_activePipelines)
+    {
+        GfxPipeline& pipeline = entry.second;
+        if (std::none_of(shaders.begin(), shaders.end(), [&](const GfxShader* shader) { return pipeline.desc.UsesShader(shader); }))
+            continue;
+
+        // map nodes never move, so the job can point straight at the pipeline
+        jobs.push_back({ [](void* data, uint32_t, uint32_t)
+        {
+            CPU_ProfileZone(RebuildPipeline);
+            GfxPipeline& pipeline = *static_cast<GfxPipeline*>(data);
+            pipeline.rebuilt = GfxPipelineStateManager::GetInstance().CreateVkPipeline(pipeline.desc);
+        }, &pipeline, 0, 0, nullptr });
+    }
+    if (!jobs.empty())
+        JobSystem::GetInstance().Run(jobs.data(), uint32_t(jobs.size()), &counter);
+    return uint32_t(jobs.size());
+}
+
+void GfxPipelineStateManager::SwapRebuiltPipelines(uint64_t frameCount)
+{
+    for (auto& entry : m_activePipelines)
+    {
+        GfxPipeline& pipeline = entry.second;
+        if (pipeline.rebuilt == VK_NULL_HANDLE)
+            continue;
+        // m_currentPipeline points at the same node, the next bind picks up the new pipeline
+        m_retiredPipelines.push_back({ pipeline.pipeline, frameCount });
+        pipeline.pipeline = pipeline.rebuilt;
+        pipeline.rebuilt = VK_NULL_HANDLE;
+    }
 }
 
-void GfxPipelineStateManager::FillPipelineCreateMiscInfo(VkGraphicsPipelineCreateInfo& pipelineInfo, PipelineMiscInfo& pipelineMisc)
+void GfxPipelineStateManager::ReleaseRetiredPipelines(uint64_t frameCount, uint32_t framesInFlight)
 {
-    pipelineMisc.dynamicStates =
+    uint32_t released = 0;
+    for (auto& retired : m_retiredPipelines)
+    {
+        if (frameCount < retired.retireFrame + framesInFlight)
+            break;
+        API_CALL(vkDestroyPipeline, *m_device, retired.pipeline, nullptr);
+        ++released;
+    }
+    m_retiredPipelines.erase(m_retiredPipelines.begin(), m_retiredPipelines.begin() + released);
+}
+
+void GfxPipelineStateManager::FillPipelineCreateMiscInfo(VkGraphicsPipelineCreateInfo& pipelineInfo, PipelineMiscInfo& pipelineMisc, const GfxPipelineDesc& desc)
+{
+    static constexpr VkDynamicState c_dynamicStates[] =
     {
       VK_DYNAMIC_STATE_VIEWPORT,
       VK_DYNAMIC_STATE_SCISSOR
     };
 
     pipelineMisc.dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    pipelineMisc.dynamicState.dynamicStateCount = static_cast<uint32_t>(pipelineMisc.dynamicStates.size());
-    pipelineMisc.dynamicState.pDynamicStates = pipelineMisc.dynamicStates.data();
+    pipelineMisc.dynamicState.dynamicStateCount = static_cast<uint32_t>(std::size(c_dynamicStates));
+    pipelineMisc.dynamicState.pDynamicStates = c_dynamicStates;
 
     
     pipelineMisc.vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO; 
-    pipelineMisc.bindingDescription = GfxStandardVertex::GetBindingDescription();
-    pipelineMisc.attributeDescriptions = GfxStandardVertex::GetAttributeDescriptions();
+    std::span<const VkVertexInputBindingDescription> bindingDescriptions = GfxStandardVertex::GetBindingDescriptions();
+    std::span<const VkVertexInputAttributeDescription> attributeDescriptions = GfxStandardVertex::GetAttributeDescriptions();
 
-    pipelineMisc.vertexInputInfo.vertexBindingDescriptionCount = 1;
-    pipelineMisc.vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(pipelineMisc.attributeDescriptions.size());
-    pipelineMisc.vertexInputInfo.pVertexBindingDescriptions = &pipelineMisc.bindingDescription;
-    pipelineMisc.vertexInputInfo.pVertexAttributeDescriptions = pipelineMisc.attributeDescriptions.data();
+    pipelineMisc.vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    pipelineMisc.vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    pipelineMisc.vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+    pipelineMisc.vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
     pipelineMisc.inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    pipelineMisc.inputAssembly.topology = m_topology;
+    pipelineMisc.inputAssembly.topology = desc.topology;
     pipelineMisc.inputAssembly.primitiveRestartEnable = VK_FALSE;
 
     pipelineMisc.viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
@@ -118,7 +188,7 @@ void GfxPipelineStateManager::FillPipelineCreateMiscInfo(VkGraphicsPipelineCreat
     pipelineMisc.rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     pipelineMisc.rasterizer.depthClampEnable = VK_FALSE;
     pipelineMisc.rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    pipelineMisc.rasterizer.polygonMode = m_polygonMode;
+    pipelineMisc.rasterizer.polygonMode = desc.polygonMode;
     pipelineMisc.rasterizer.lineWidth = 1.0f;
     pipelineMisc.rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
     pipelineMisc.rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
@@ -135,26 +205,25 @@ void GfxPipelineStateManager::FillPipelineCreateMiscInfo(VkGraphicsPipelineCreat
     pipelineMisc.multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
     pipelineMisc.multisampling.alphaToOneEnable = VK_FALSE; // Optional
 
-    uint32_t attachmentCount = 0;
-    for (; attachmentCount < 8; ++attachmentCount)
+    const uint32_t attachmentCount = desc.attachmentCount;
+    for (uint32_t attachment = 0; attachment < attachmentCount; ++attachment)
     {
-        pipelineMisc.colorBlendAttachment[attachmentCount] = {};
-        if (!m_RenderTargetImageView[attachmentCount].has_value())
-            break;
-        if (m_rtBlendStates[attachmentCount].blendEnabled)
+        const RenderTargetBlendStates& blendState = desc.blendStates[attachment];
+        pipelineMisc.colorBlendAttachment[attachment] = {};
+        if (blendState.blendEnabled)
         {
-            pipelineMisc.colorBlendAttachment[attachmentCount].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-            pipelineMisc.colorBlendAttachment[attachmentCount].blendEnable = VK_TRUE;
-            pipelineMisc.colorBlendAttachment[attachmentCount].srcColorBlendFactor = m_rtBlendStates[attachmentCount].srcColorBlend;
-            pipelineMisc.colorBlendAttachment[attachmentCount].dstColorBlendFactor = m_rtBlendStates[attachmentCount].dstColorBlend;
-            pipelineMisc.colorBlendAttachment[attachmentCount].colorBlendOp = m_rtBlendStates[attachmentCount].colorBlendOp;
-            pipelineMisc.colorBlendAttachment[attachmentCount].srcAlphaBlendFactor = m_rtBlendStates[attachmentCount].srcAlphaBlend;
-            pipelineMisc.colorBlendAttachment[attachmentCount].dstAlphaBlendFactor = m_rtBlendStates[attachmentCount].dstAlphaBlend;
-            pipelineMisc.colorBlendAttachment[attachmentCount].alphaBlendOp = m_rtBlendStates[attachmentCount].alphaBlendOp;
+            pipelineMisc.colorBlendAttachment[attachment].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            pipelineMisc.colorBlendAttachment[attachment].blendEnable = VK_TRUE;
+            pipelineMisc.colorBlendAttachment[attachment].srcColorBlendFactor = blendState.srcColorBlend;
+            pipelineMisc.colorBlendAttachment[attachment].dstColorBlendFactor = blendState.dstColorBlend;
+            pipelineMisc.colorBlendAttachment[attachment].colorBlendOp = blendState.colorBlendOp;
+            pipelineMisc.colorBlendAttachment[attachment].srcAlphaBlendFactor = blendState.srcAlphaBlend;
+            pipelineMisc.colorBlendAttachment[attachment].dstAlphaBlendFactor = blendState.dstAlphaBlend;
+            pipelineMisc.colorBlendAttachment[attachment].alphaBlendOp = blendState.alphaBlendOp;
         }
         else
         {
-            pipelineMisc.colorBlendAttachment[attachmentCount].blendEnable = VK_FALSE;
+            pipelineMisc.colorBlendAttachment[attachment].blendEnable = VK_FALSE;
         }
     }
 
@@ -245,49 +314,84 @@ GfxRenderState& GfxPipelineStateManager::CreateRenderState(uint32_t hash)
 
     API_CALL(vkCreateRenderPass, *m_device, &renderPassInfo, nullptr, &renderState.renderPass);
 
-    GfxSwapChain& swapChain = m_device->GetSwapChain();
     // TODO get frame buffer from resource manager
     // manage it in some way other then having 3 LOL
+    renderState.frameBuffer = CreateFramebuffer(renderState.renderPass, attachments, 1);
+
+    m_RenderState.emplace(hash, renderState);
+
+    return m_RenderState.at(hash);
+}
+
+VkFramebuffer GfxPipelineStateManager::CreateFramebuffer(VkRenderPass renderPass, VkImageView* attachments, uint32_t attachmentCount)
+{
+    GfxSwapChain& swapChain = m_device->GetSwapChain();
 
     VkFramebufferCreateInfo framebufferInfo{};
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferInfo.renderPass = renderState.renderPass;
-    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = attachmentCount;
     framebufferInfo.pAttachments = attachments;
     framebufferInfo.width = swapChain.GetExtent().x;
     framebufferInfo.height = swapChain.GetExtent().y;
     framebufferInfo.layers = 1;
 
-    API_CALL(vkCreateFramebuffer, *m_device, &framebufferInfo, nullptr, &(renderState.frameBuffer));
-
-    m_RenderState.emplace(hash, renderState);
-
-    return m_RenderState.at(hash);
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    API_CALL(vkCreateFramebuffer, *m_device, &framebufferInfo, nullptr, &framebuffer);
+    return framebuffer;
 }
 
-GfxPipelineLayout& GfxPipelineStateManager::GetPipelineLayout()
+void GfxPipelineStateManager::RecreateSwapChainFramebuffers(const std::vector<VkImage>& oldImages, std::vector<VkFramebuffer>& retiredFramebuffers)
 {
-    uint32_t hash = 0;
-    m_setCount = 1;
+    GfxSwapChain& swapChain = m_device->GetSwapChain();
+    const std::vector<VkImage>& newImages = swapChain.GetImages();
+    InvalidateRenderTargets();
 
-    for (int i = 0; i < 3; ++i)
+    // render states are keyed by the images they render to, swapchain targets only use a single attachment
+    for (size_t i = 0; i < oldImages.size(); ++i)
     {
-        if (!m_uniformBuffer[i])
-            break;
-        hash |= m_hasher(m_setLayouts[i]);
-        ++m_setCount;
+        uint32_t oldHash = uint32_t(m_hasher(oldImages[i]));
+        auto rp = m_RenderState.find(oldHash);
+        if (rp == m_RenderState.end())
+            continue;
+
+        GfxRenderState renderState = rp->second;
+        m_RenderState.erase(rp);
+        retiredFramebuffers.push_back(renderState.frameBuffer);
+
+        if (i >= newImages.size())
+        {
+            // fewer images then before, command buffers in flight may still reference the render pass so keep it until CleanUp
+            m_retiredRenderPasses.push_back(renderState.renderPass);
+            continue;
+        }
+
+        VkImageView attachment = swapChain.GetImageViews()[i];
+        renderState.frameBuffer = CreateFramebuffer(renderState.renderPass, &attachment, 1);
+        m_RenderState.emplace(uint32_t(m_hasher(newImages[i])), renderState);
     }
-    auto pipeLayoutSearchRes = m_activePipelineLayout.find(hash);
+}
 
-    if (pipeLayoutSearchRes == m_activePipelineLayout.end())
-        return CreatePipelineLayout(hash);
-    else
-        return pipeLayoutSearchRes->second;
+GfxPipelineLayout& GfxPipelineStateManager::GetPipelineLayout()
+{
+    return m_pipelineLayout;
 }
 
 void GfxPipelineStateManager::Init(GfxDevice& device)
 {
     m_device = &device;
+
+    const GfxDescriptorLayoutCache& layoutCache = GfxDescriptorLayoutCache::GetInstance();
+    const VkPushConstantRange& pushConstantRange = layoutCache.GetPushConstantRange();
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = layoutCache.GetSetCount();
+    pipelineLayoutInfo.pSetLayouts = layoutCache.GetSetLayouts();
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantRange.size ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    API_CALL(vkCreatePipelineLayout, *m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout.pipelineLayout);
 }
 
 void GfxPipelineStateManager::CleanUp()
@@ -295,13 +399,16 @@ void GfxPipelineStateManager::CleanUp()
     for (auto& pipeline : m_activePipelines)
     {
         API_CALL(vkDestroyPipeline, *m_device, pipeline.second.pipeline, nullptr);
+        if (pipeline.second.rebuilt != VK_NULL_HANDLE)
+            API_CALL(vkDestroyPipeline, *m_device, pipeline.second.rebuilt, nullptr);
     }
-    for (auto& pipeline : m_activePipelineLayout)
-    {
-        API_CALL(vkDestroyPipelineLayout, *m_device, pipeline.second.pipelineLayout, nullptr);
-    }
+    ReleaseRetiredPipelines(~0ull, 0);
+    API_CALL(vkDestroyPipelineLayout, *m_device, m_pipelineLayout.pipelineLayout, nullptr);
+    m_pipelineLayout = {};
     m_activePipelines.clear();
-    m_activePipelineLayout.clear();
+    m_currentPipeline = nullptr;
+    std::fill(std::begin(m_descriptorSets), std::end(m_descriptorSets), VkDescriptorSet(VK_NULL_HANDLE));
+    m_currentRenderState = nullptr;
     // destroy here since to destroy this resource, you need access to the device.
     for (auto& rp : m_RenderState)
     {
@@ -309,17 +416,29 @@ void GfxPipelineStateManager::CleanUp()
         API_CALL(vkDestroyFramebuffer, *m_device, rp.second.frameBuffer, nullptr);
     }
     m_RenderState.clear();
+    for (auto& renderPass : m_retiredRenderPasses)
+    {
+        API_CALL(vkDestroyRenderPass, *m_device, renderPass, nullptr);
+    }
+    m_retiredRenderPasses.clear();
 }
 
 GfxPipeline& GfxPipelineStateManager::GetPipeline()
 {
+    if (m_currentPipeline)
+        return *m_currentPipeline;
+
     // TODO: hash pipeline layouts and pipelines
+    // pipelines only depend on render pass compatibility so hash the target formats rather then the images,
+    // this keeps pipelines valid across swapchain images and swapchain recreation
     uint32_t renderPassHash = 0;
-    for (int i = 0; i < sizeof(m_RenderTargetImageView); ++i)
+    uint32_t blendHash = 0;
+    for (size_t i = 0; i < std::size(m_RenderTargetImageView); ++i)
     {
         if (m_RenderTargetImageView[i].has_value())
         {
-            renderPassHash ^= m_hasher(m_RenderTargetImageView[i]->GetVkImage());
+            renderPassHash ^= uint32_t(std::hash<uint32_t>{}(m_RenderTargetImageView[i]->GetFormat() + i));
+            blendHash = blendHash * 31 + uint32_t(m_rtBlendStates[i]);
         }
         else
         {
@@ -332,21 +451,46 @@ GfxPipeline& GfxPipelineStateManager::GetPipeline()
     pipelineHash ^= m_hasher((void*)m_pixelShader);
     pipelineHash ^= m_hasher((void*)m_computeShader);
 
+    // fixed function state baked into the pipeline
+    uint32_t stateHash = (uint32_t(m_topology) * 31 + uint32_t(m_polygonMode)) * 31 + blendHash;
+    pipelineHash ^= uint32_t(std::hash<uint32_t>{}(stateHash));
+
     uint32_t hash = pipelineHash + renderPassHash;
 
     auto pipe = m_activePipelines.find(hash);
     if (pipe != m_activePipelines.end())
-        return (pipe->second);
-    // pipeline does not exist at this point
+    {
+        m_currentPipeline = &pipe->second;
+        assert(MatchesCurrentState(m_currentPipeline->desc) && "pipeline hash collision");
+    }
+    else
+    {
+        m_currentPipeline = &CreatePipeline(hash);
+    }
+    return *m_currentPipeline;
+}
 
-    return CreatePipeline(hash);
+bool GfxPipelineStateManager::MatchesCurrentState(const GfxPipelineDesc& desc) const
+{
+    if (desc.vertexShader != m_vertexShader || desc.pixelShader != m_pixelShader || desc.computeShader != m_computeShader ||
+        desc.topology != m_topology || desc.polygonMode != m_polygonMode)
+        return false;
+    for (uint32_t i = 0; i < desc.attachmentCount; ++i)
+    {
+        if (!m_RenderTargetImageView[i].has_value() || uint32_t(desc.blendStates[i]) != uint32_t(m_rtBlendStates[i]))
+            return false;
+    }
+    return desc.attachmentCount == std::size(m_RenderTargetImageView) || !m_RenderTargetImageView[desc.attachmentCount].has_value();
 }
 
-GfxRenderState GfxPipelineStateManager::GetRenderState()
+const GfxRenderState& GfxPipelineStateManager::GetRenderState()
 {
+    if (m_currentRenderState)
+        return *m_currentRenderState;
+
     // TODO: hash render passes
     uint32_t renderPassHash = 0;
-    for (int i = 0; i < sizeof(m_RenderTargetImageView); ++i)
+    for (size_t i = 0; i < std::size(m_RenderTargetImageView); ++i)
     {
         if (m_RenderTargetImageView[i].has_value())
         {
@@ -359,29 +503,22 @@ GfxRenderState GfxPipelineStateManager::GetRenderState()
     }
     auto rp = m_RenderState.find(renderPassHash);
     if (rp != m_RenderState.end())
-    {
-        GfxRenderState ret = rp->second;
-        for (uint32_t i = 0; i < 8; ++i)
-        {
-            if (m_clearValues[i].has_value())
-                ret.clearValues[i] = m_clearValues[i];
-            else
-                break;
-        }
-        return ret;
-    }
-
-    GfxRenderState ret = CreateRenderState(renderPassHash);
+        m_currentRenderState = &rp->second;
+    else
+        m_currentRenderState = &CreateRenderState(renderPassHash);
+    return *m_currentRenderState;
+}
 
-    for (uint32_t i = 0; i < 8; ++i)
+uint32_t GfxPipelineStateManager::GetClearValues(VkClearValue (&clearValues)[8]) const
+{
+    uint32_t count = 0;
+    while (count < std::size(m_clearValues) && m_clearValues[count].has_value())
     {
-        if (m_clearValues[i].has_value())
-            ret.clearValues[i] = m_clearValues[i];
-        else
-            break;
+        const glm::vec4& clearValue = *m_clearValues[count];
+        clearValues[count].color = { { clearValue.x, clearValue.y, clearValue.z, clearValue.w } };
+        ++count;
     }
-
-    return ret;
+    return count;
 }
 
 void GfxPipelineStateManager::SetVertexInputState(VertexInputState state)
@@ -392,16 +529,19 @@ void GfxPipelineStateManager::SetVertexInputState(VertexInputState state)
 void GfxPipelineStateManager::SetTopology(VkPrimitiveTopology topology)
 {
     m_topology = topology;
+    m_currentPipeline = nullptr;
 }
 
 void GfxPipelineStateManager::SetPolygonMode(VkPolygonMode polygonMode)
 {
     m_polygonMode = polygonMode;
+    m_currentPipeline = nullptr;
 }
 
 void GfxPipelineStateManager::SetRTBlendState(RenderTargetBlendStates blendState, size_t targetRT)
 {
     m_rtBlendStates[targetRT] = blendState;
+    m_currentPipeline = nullptr;
 }
 
 void GfxPipelineStateManager::SetRTClearvalue(uint32_t rtIndex, glm::vec4 clearValue)
@@ -418,10 +558,14 @@ void GfxPipelineStateManager::ResetRenderTargets()
         m_rtBlendStates[i].blendEnabled = false;
         m_clearValues[i].reset();
     }
+    InvalidateRenderTargets();
 }
 
 void GfxPipelineStateManager::SetShader(const GfxShader& shader)
 {
+    const GfxShader* vertexShader = m_vertexShader;
+    const GfxShader* pixelShader = m_pixelShader;
+    const GfxShader* computeShader = m_computeShader;
     switch (shader.GetShaderType())
     {
     case ShaderType::CS:
@@ -438,6 +582,8 @@ void GfxPipelineStateManager::SetShader(const GfxShader& shader)
         m_computeShader = nullptr;
         break;
     }
+    if (vertexShader != m_vertexShader || pixelShader != m_pixelShader || computeShader != m_computeShader)
+        m_currentPipeline = nullptr;
 }
 
 VertexInputState::operator uint32_t() const
@@ -449,5 +595,11 @@ RenderTargetBlendStates::operator uint32_t() const
 {
     if (!blendEnabled)
         return 0;
-    return 0;
+    uint32_t hash = 1;
+    for (uint32_t value : { uint32_t(srcColorBlend), uint32_t(dstColorBlend), uint32_t(colorBlendOp),
+                            uint32_t(srcAlphaBlend), uint32_t(dstAlphaBlend), uint32_t(alphaBlendOp) })
+    {
+        hash = hash * 31 + value;
+    }
+    return hash;
 }
@@ -1,5 +1,7 @@
 #pragma once
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include "vulkan/vulkan.h"
 
 #include "Includes/Defines.h"
@@ -14,6 +16,7 @@
 #include "Graphics/ShaderManagement/GfxShader.h"
 #include "GfxUniformBuffer.hpp"
 #include "GfxStructuredBuffer.h"
+#include "GfxDescriptorLayoutCache.h"
 
 #include "glm/glm.hpp"
 #include <unordered_map>
@@ -27,21 +30,10 @@ struct GfxPipelineLayout
     }
 };
 
-struct GfxPipeline
-{
-    VkPipeline pipeline;
-    operator VkPipeline()
-    {
-        return pipeline;
-    }
-};
-
 struct GfxRenderState
 {
     VkRenderPass renderPass;
     VkFramebuffer frameBuffer;
-
-    std::optional<glm::vec4> clearValues[8];
 };
 
 struct RenderTargetBlendStates
@@ -59,6 +51,37 @@ struct RenderTargetBlendStates
     operator uint32_t() const;
 };
 
+// everything a pipeline is created from, kept with it so it can be rebuilt when its shaders are reloaded
+struct GfxPipelineDesc
+{
+    const GfxShader* vertexShader;
+    const GfxShader* pixelShader;
+    const GfxShader* computeShader;
+    VkPrimitiveTopology topology;
+    VkPolygonMode polygonMode;
+    // render passes live until CleanUp, so this stays valid
+    VkRenderPass renderPass;
+    uint32_t attachmentCount;
+    RenderTargetBlendStates blendStates[8];
+
+    bool UsesShader(const GfxShader* shader) const
+    {
+        return shader && (vertexShader == shader || pixelShader == shader || computeShader == shader);
+    }
+};
+
+struct GfxPipeline
+{
+    VkPipeline pipeline;
+    GfxPipelineDesc desc;
+    // built on a job by RebuildPipelines, takes over from pipeline in SwapRebuiltPipelines
+    VkPipeline rebuilt;
+    operator VkPipeline()
+    {
+        return pipeline;
+    }
+};
+
 struct VertexInputState
 {
     size_t m_descriptionCount;
@@ -68,14 +91,24 @@ struct VertexInputState
     operator uint32_t() const;
 };
 
+class JobCounter;
+
 class GfxPipelineStateManager
 {
     DefaultSingleton(GfxPipelineStateManager);
 private:
+    struct RetiredPipeline
+    {
+        VkPipeline pipeline;
+        uint64_t retireFrame;
+    };
+
     std::unordered_map<uint64_t, GfxPipeline> m_activePipelines;
     std::unordered_map<uint64_t, GfxRenderState> m_RenderState;
-    std::unordered_map<uint64_t, GfxPipelineLayout> m_activePipelineLayout;
     std::optional<GfxImageView> m_RenderTargetImageView[8];
+    std::vector<VkRenderPass> m_retiredRenderPasses;
+    // replaced by a rebuild, frames in flight may still use them
+    std::vector<RetiredPipeline> m_retiredPipelines;
 
     std::hash<void*> m_hasher;
     GfxDevice* m_device;
@@ -89,16 +122,27 @@ private:
     // renderpass variables
     std::optional<glm::vec4> m_clearValues[8];
 
+    // results of the last lookups, dropped whenever a state they depend on changes
+    // so draws that keep the same state skip hashing and map lookups
+    GfxPipeline* m_currentPipeline = nullptr;
+    GfxRenderState* m_currentRenderState = nullptr;
+
+    void InvalidateRenderTargets()
+    {
+        m_currentPipeline = nullptr;
+        m_currentRenderState = nullptr;
+    }
+
     GfxPipeline& CreatePipeline(uint32_t hash);
+    // whether desc was built from the currently set shaders, fixed function state and target count
+    bool MatchesCurrentState(const GfxPipelineDesc& desc) const;
+    // only reads desc and state that is fixed after Init, so it can run on any thread
+    VkPipeline CreateVkPipeline(const GfxPipelineDesc& desc) const;
     GfxRenderState& CreateRenderState(uint32_t hash);
-    GfxPipelineLayout& CreatePipelineLayout(uint32_t hash);
+    VkFramebuffer CreateFramebuffer(VkRenderPass renderPass, VkImageView* attachments, uint32_t attachmentCount);
 
     struct PipelineMiscInfo
     {
-        std::vector<VkDynamicState> dynamicStates;
-        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
-        VkVertexInputBindingDescription bindingDescription;
-
         VkPipelineDynamicStateCreateInfo dynamicState;
 
         VkPipelineVertexInputStateCreateInfo vertexInputInfo;
@@ -114,12 +158,12 @@ private:
         VkPipelineColorBlendStateCreateInfo colorBlending;
     };
 
-    void FillPipelineCreateMiscInfo(VkGraphicsPipelineCreateInfo& pipelineInfo, PipelineMiscInfo& miscInfo);
+    static void FillPipelineCreateMiscInfo(VkGraphicsPipelineCreateInfo& pipelineInfo, PipelineMiscInfo& miscInfo, const GfxPipelineDesc& desc);
 
-    GfxStructuredBuffer* m_structuredBuffer;
-    GfxUniformBufferBase* m_uniformBuffer[3];
-    VkDescriptorSetLayout m_setLayouts[4];
-    uint32_t m_setCount = 0;
+    // every pipeline uses the layout built from GfxDescriptorLayoutCache, so bound sets stay valid across pipelines
+    GfxPipelineLayout m_pipelineLayout = {};
+    // indexed by the set number the shaders declare, VK_NULL_HANDLE until something is bound there
+    VkDescriptorSet m_descriptorSets[GfxDescriptorLayoutCache::c_maxSets] = {};
 
     uint32_t shaderCount = 0;
     const GfxShader* m_computeShader = nullptr;
@@ -127,14 +171,20 @@ private:
     const GfxShader* m_vertexShader = nullptr;
 
 public:
+    // after GfxDescriptorLayoutCache::Init
     void Init(GfxDevice& device);
     void CleanUp();
 
     GfxPipeline& GetPipeline();
-    GfxRenderState GetRenderState();
+    const GfxRenderState& GetRenderState();
     GfxPipelineLayout& GetPipelineLayout();
+    // fills the clear values of the bound render targets, returns how many there are
+    uint32_t GetClearValues(VkClearValue (&clearValues)[8]) const;
 
     void CommitStates(GfxCommandBuffer& commandBuffer);
+    // the halves of CommitStates, for callers that track which of them changed (eg. GfxDrawList)
+    void BindPipeline(VkCommandBuffer commandBuffer);
+    void BindDescriptorSets(VkCommandBuffer commandBuffer);
 
     void SetVertexInputState(VertexInputState state);
     void SetTopology(VkPrimitiveTopology topology);
@@ -144,28 +194,46 @@ public:
     void SetRTClearvalue(uint32_t rtIndex, glm::vec4 clearValue);
     void SetRenderTarget(uint32_t rtIndex, uint32_t uid)
     {
-        m_RenderTargetImageView[rtIndex] = GfxResourceManager::GetImageView(uid);
-        m_clearValues[rtIndex] = glm::vec4(0, 0, 0, 0);
+        SetRenderTarget(rtIndex, GfxResourceManager::GetImageView(uid));
     }
     void SetRenderTarget(uint32_t rtIndex, GfxImageView& imageView)
     {
-        m_RenderTargetImageView[rtIndex] = imageView;
+        std::optional<GfxImageView>& target = m_RenderTargetImageView[rtIndex];
+        if (!target.has_value() || target->GetVkImage() != imageView.GetVkImage())
+        {
+            // pipelines only care about the format, cycling through swapchain images keeps them
+            if (!target.has_value() || target->GetFormat() != imageView.GetFormat())
+                m_currentPipeline = nullptr;
+            m_currentRenderState = nullptr;
+            target = imageView;
+        }
         m_clearValues[rtIndex] = glm::vec4(0, 0, 0, 0);
     }
 
     void BindDescriptor(GfxUniformBufferBase& uniformBuffer)
     {
-        m_uniformBuffer[uniformBuffer.GetSetIndex() - uniformBuffer.c_uniformBufferOffset] = &uniformBuffer;
-        m_setLayouts[uniformBuffer.GetSetIndex()] = uniformBuffer.GetLayout();
+        m_descriptorSets[uniformBuffer.GetSetIndex()] = uniformBuffer;
     }
     void BindStructuredBuffer(GfxStructuredBuffer& structuredBuffer)
     {
-        m_structuredBuffer = &structuredBuffer;
-        m_setLayouts[0] = structuredBuffer.GetLayout();
+        m_descriptorSets[structuredBuffer.GetSetIndex()] = structuredBuffer;
     }
 
     void ResetRenderTargets();
 
+    // rebuilds the cached framebuffers of the old swapchain images against the new swapchain images
+    // render passes and pipelines are kept, the old framebuffers are appended to retiredFramebuffers
+    // as they may still be in use by frames in flight
+    void RecreateSwapChainFramebuffers(const std::vector<VkImage>& oldImages, std::vector<VkFramebuffer>& retiredFramebuffers);
+
     void SetShader(const GfxShader& shader);
+
+    // recreates every pipeline using one of shaders on the job system, counter reaches 0 once they are all built
+    // the old pipelines stay in use until SwapRebuiltPipelines. returns how many are being rebuilt
+    uint32_t RebuildPipelines(const std::vector<const GfxShader*>& shaders, JobCounter& counter);
+    // once the counter from RebuildPipelines is done, retires the replaced pipelines at frameCount
+    void SwapRebuiltPipelines(uint64_t frameCount);
+    // destroys pipelines retired framesInFlight or more frames before frameCount
+    void ReleaseRetiredPipelines(uint64_t frameCount, uint32_t framesInFlight);
 };
 
@@ -1,21 +1,16 @@
 #include "GfxStructuredBuffer.h"
+#include "GfxDescriptorLayoutCache.h"
 
-void GfxStructuredBuffer::CreateLayout(GfxDevice& device)
+void GfxStructuredBuffer::CreateLayout(GfxDevice& device, uint32_t set)
 {
     m_device = &device;
-    VkDescriptorSetLayoutBinding sboLayoutBinding{};
-    sboLayoutBinding.binding = 0;
-    sboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    sboLayoutBinding.descriptorCount = 1;
-    sboLayoutBinding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
-    sboLayoutBinding.pImmutableSamplers = nullptr; // Optional
-
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &sboLayoutBinding;
-
-    API_CALL(vkCreateDescriptorSetLayout, device, &layoutInfo, nullptr, &m_descriptorSetLayout);
+    m_setIndex = set;
+    const GfxDescriptorLayoutCache& layoutCache = GfxDescriptorLayoutCache::GetInstance();
+    const VkDescriptorSetLayoutBinding* binding = layoutCache.FindBinding(set, 0);
+    UNUSED_PARAM(binding);
+    assert(binding && binding->descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+    m_descriptorSetLayout = layoutCache.GetSetLayout(set);
 }
 
 void GfxStructuredBuffer::CreateBuffer(uint32_t size)
@@ -32,6 +27,19 @@ void GfxStructuredBuffer::CreateBuffer(uint32_t size)
 
     vkAllocateDescriptorSets(*m_device, &allocInfo, &m_descriptorSet);
 
+    WriteDescriptor(size);
+}
+
+void GfxStructuredBuffer::Resize(uint32_t size)
+{
+    // descriptor set is kept and pointed at the new buffer
+    CleanUp();
+    m_buffer.CreateBuffer(*m_device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    WriteDescriptor(size);
+}
+
+void GfxStructuredBuffer::WriteDescriptor(uint32_t size)
+{
     VkDescriptorBufferInfo bufferInfo{};
     bufferInfo.buffer = m_buffer;
     bufferInfo.offset = 0;
@@ -55,9 +63,9 @@ void GfxStructuredBuffer::CreateBuffer(uint32_t size)
     m_gpuMem = m_buffer.Map();
 }
 
-void GfxStructuredBuffer::UpdateBuffer(void* data, size_t src_offset, size_t size)
+void GfxStructuredBuffer::UpdateBuffer(const void* data, size_t src_offset, size_t size)
 {
-    memcpy(m_gpuMem, (uint8_t*)data + src_offset, size);
+    memcpy(m_gpuMem, (const uint8_t*)data + src_offset, size);
 }
 
 void GfxStructuredBuffer::CleanUp()
@@ -65,8 +73,3 @@ void GfxStructuredBuffer::CleanUp()
     m_buffer.Unmap();
     m_buffer.CleanUp();
 }
-
-void GfxStructuredBuffer::CleanUpLayouts()
-{
-    API_CALL(vkDestroyDescriptorSetLayout, *m_device, m_descriptorSetLayout, nullptr);
-}
@@ -1,5 +1,7 @@
 #pragma once
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include "vulkan/vulkan.h"
 
 #include "Includes/Defines.h"
@@ -13,18 +15,27 @@ class GfxStructuredBuffer
     GfxDevice* m_device;
     VkDescriptorSetLayout m_descriptorSetLayout;
     VkDescriptorSet m_descriptorSet;
+    uint32_t m_setIndex;
 
     GfxBuffer m_buffer;
     void* m_gpuMem;
+
+    void WriteDescriptor(uint32_t size);
 public:
 
-    void CreateLayout(GfxDevice& device);
+    // takes the layout of set from GfxDescriptorLayoutCache, the buffer is expected at binding 0
+    void CreateLayout(GfxDevice& device, uint32_t set);
 
     VkDescriptorSetLayout GetLayout()
     {
         return m_descriptorSetLayout;
     }
 
+    uint32_t GetSetIndex() const
+    {
+        return m_setIndex;
+    }
+
     operator VkDescriptorSet* ()
     {
         return &m_descriptorSet;
@@ -35,10 +46,10 @@ public:
     }
 
     void CreateBuffer(uint32_t size);
+    // buffer must not be in use by the gpu
+    void Resize(uint32_t size);
 
-    void UpdateBuffer(void* data, size_t src_offset, size_t size);
+    void UpdateBuffer(const void* data, size_t src_offset, size_t size);
 
     void CleanUp();
-
-    void CleanUpLayouts();
 };
@@ -3,18 +3,45 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#ifdef _WIN32
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h>
+#endif
 
 void GfxSurface::Init(VkInstance instance)
 {
     m_instance = instance;
+    if (PlatformManager::GetInstance().IsHeadless())
+    {
+        InitHeadless();
+        return;
+    }
+#ifdef _WIN32
     VkWin32SurfaceCreateInfoKHR createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
     createInfo.hwnd = glfwGetWin32Window(PlatformManager::GetInstance().GetWindow());
     createInfo.hinstance = GetModuleHandle(nullptr);
 
     API_CALL(vkCreateWin32SurfaceKHR, m_instance, &createInfo, nullptr, &m_surface);
+#else
+    API_CALL(glfwCreateWindowSurface, m_instance, PlatformManager::GetInstance().GetWindow(), nullptr, &m_surface);
+#endif
+}
+
+void GfxSurface::InitHeadless()
+{
+    // VK_EXT_headless_surface gives a presentable surface without a window so the
+    // swapchain path stays the same, requires the extension to be enabled on the instance
+    auto func = (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(m_instance, "vkCreateHeadlessSurfaceEXT");
+    if (func == nullptr)
+    {
+        throw std::runtime_error("VK_EXT_headless_surface is not supported!");
+    }
+
+    VkHeadlessSurfaceCreateInfoEXT createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+    API_CALL(func, m_instance, &createInfo, nullptr, &m_surface);
 }
 
 void GfxSurface::Cleanup()
@@ -1,5 +1,7 @@
 #pragma once
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include "vulkan/vulkan.h"
 
 #include "Includes/Defines.h"
@@ -15,6 +17,8 @@ class GfxSurface
 {
     VkSurfaceKHR m_surface = VK_NULL_HANDLE;
     VkInstance m_instance = VK_NULL_HANDLE;
+
+    void InitHeadless();
 public:
     operator VkSurfaceKHR() const
     {
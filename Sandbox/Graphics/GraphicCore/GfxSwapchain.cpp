@@ -1,10 +1,6 @@
 #include "GfxSwapchain.h"
 #include "GfxDevice.h"
 
-#define GLFW_INCLUDE_VULKAN
-#include <GLFW/glfw3.h>
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include <GLFW/glfw3native.h>
 #include <algorithm>
 
 bool GfxSwapChain::IsFormatAvailable(VkSurfaceFormatKHR format)
@@ -30,17 +26,43 @@ bool GfxSwapChain::IsPresentModeAvailable(VkPresentModeKHR format)
 
 void GfxSwapChain::Init(GfxDevice& device, VkSurfaceFormatKHR swapchainFormat, const GfxSurface& surface, glm::vec2 size)
 {
-    SwapChainSupportDetails swapChainSupport = surface.QuerySwapChainSupport(device);
-    QueueFamilyIndices queueFamily = device.GetQueueFamily();
-
     m_device = &device;
+    m_surface = &surface;
+    m_surfaceFormat = swapchainFormat;
+
+    CreateSwapChain(size, VK_NULL_HANDLE);
+}
+
+void GfxSwapChain::Recreate(glm::vec2 size, GfxRetiredSwapChain& retired, std::vector<VkImage>& oldImages)
+{
+    VkSwapchainKHR oldSwapChain = m_swapChain;
+    oldImages.swap(m_swapChainImages);
+    // swap rather then copy, copying GfxImageView would destroy the views still in use by frames in flight
+    retired.imageViews.swap(m_swapChainImageViews);
+
+    CreateSwapChain(size, oldSwapChain);
+
+    retired.swapChain = oldSwapChain;
+}
+
+void GfxSwapChain::CreateSwapChain(glm::vec2 size, VkSwapchainKHR oldSwapChain)
+{
+    SwapChainSupportDetails swapChainSupport = m_surface->QuerySwapChainSupport(*m_device);
+    QueueFamilyIndices queueFamily = m_device->GetQueueFamily();
+
     m_availableFormats = swapChainSupport.formats;
     m_availablePresentModes = swapChainSupport.presentModes;
 
-    assert(IsFormatAvailable(swapchainFormat));
+    if (!IsFormatAvailable(m_surfaceFormat))
+    {
+        // headless and software implementations do not always expose the requested format
+        assert(!m_availableFormats.empty());
+        Log<Severe>("Swapchain format %d not available, falling back to %d\n", m_surfaceFormat.format, m_availableFormats[0].format);
+        m_surfaceFormat = m_availableFormats[0];
+    }
 
 
-    VkSurfaceFormatKHR surfaceFormat = swapchainFormat;
+    VkSurfaceFormatKHR surfaceFormat = m_surfaceFormat;
     VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
 
     if (IsPresentModeAvailable(VK_PRESENT_MODE_MAILBOX_KHR))
@@ -57,7 +79,7 @@ void GfxSwapChain::Init(GfxDevice& device, VkSurfaceFormatKHR swapchainFormat, c
 
     VkSwapchainCreateInfoKHR createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    createInfo.surface = surface;
+    createInfo.surface = *m_surface;
 
     createInfo.minImageCount = imageCount;
     createInfo.imageFormat = surfaceFormat.format;
@@ -65,13 +87,17 @@ void GfxSwapChain::Init(GfxDevice& device, VkSurfaceFormatKHR swapchainFormat, c
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // needed to read back frames for captures
+    m_supportsCapture = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if (m_supportsCapture)
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
     createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
 
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    createInfo.oldSwapchain = oldSwapChain;
     uint32_t queueFamilyIndices[] = { queueFamily.graphicsFamily.value(), queueFamily.presentFamily.value(),  queueFamily.computeFamily.value() };
 
     if (queueFamily.graphicsFamily != queueFamily.presentFamily && queueFamily.graphicsFamily != queueFamily.computeFamily)
@@ -92,6 +118,7 @@ void GfxSwapChain::Init(GfxDevice& device, VkSurfaceFormatKHR swapchainFormat, c
     API_CALL(vkGetSwapchainImagesKHR, *m_device, m_swapChain, &imageCount, nullptr);
     m_swapChainImages.resize(imageCount);
     API_CALL(vkGetSwapchainImagesKHR, *m_device, m_swapChain, &imageCount, m_swapChainImages.data());
+    m_swapChainImageViews.clear();
     m_swapChainImageViews.resize(m_swapChainImages.size());
 
     for (size_t i = 0; i < m_swapChainImages.size(); i++)
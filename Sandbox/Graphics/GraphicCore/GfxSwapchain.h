@@ -1,5 +1,7 @@
 #pragma once
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include "vulkan/vulkan.h"
 
 #include "Includes/Defines.h"
@@ -10,10 +12,21 @@
 
 #include "glm/glm.hpp"
 
+// resources of a replaced swapchain, kept alive until the frames still using them retire
+struct GfxRetiredSwapChain
+{
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    std::vector<GfxImageView> imageViews;
+    std::vector<VkFramebuffer> framebuffers;
+    uint64_t retireFrame = 0;
+};
+
 class GfxSwapChain
 {
-    VkSwapchainKHR m_swapChain;
+    VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
     GfxDevice* m_device = nullptr;
+    const GfxSurface* m_surface = nullptr;
+    VkSurfaceFormatKHR m_surfaceFormat;
     std::vector<VkImage> m_swapChainImages;
     std::vector<GfxImageView> m_swapChainImageViews;
     std::vector<VkSurfaceFormatKHR> m_availableFormats;
@@ -23,21 +36,30 @@ class GfxSwapChain
     glm::u32vec2 m_extent;
     uint32_t m_currentImageIndex;
     uint8_t m_numFrames;
+    bool m_supportsCapture = false;
+
+    void CreateSwapChain(glm::vec2 size, VkSwapchainKHR oldSwapChain);
 public:
     operator VkSwapchainKHR() const
     {
         return m_swapChain;
     }
     void Init(GfxDevice& device, VkSurfaceFormatKHR swapchainFormat, const GfxSurface& surface, glm::vec2 size);
+    // creates a new swapchain from the current one, the old swapchain and its image views are moved into retired
+    // images of the old swapchain are written to oldImages so cached framebuffers can be remapped
+    void Recreate(glm::vec2 size, GfxRetiredSwapChain& retired, std::vector<VkImage>& oldImages);
     VkFormat GetSwapChainFormat() const;
 
     VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, glm::vec2 winSize) const;
     glm::u32vec2 GetExtent() const { return m_extent; };
     VkExtent2D GetVkExtent() const { return { m_extent.x, m_extent.y }; };
     std::vector <GfxImageView>& GetImageViews() { return m_swapChainImageViews; };
+    const std::vector<VkImage>& GetImages() const { return m_swapChainImages; };
     size_t GetNumImageViews() const { return m_numFrames; };
 
     GfxImageView& GetCurrentImageView() { return m_swapChainImageViews[m_currentImageIndex]; };
+    VkImage GetCurrentImage() const { return m_swapChainImages[m_currentImageIndex]; };
+    bool SupportsCapture() const { return m_supportsCapture; };
 
     void SetCurrentImageIndex(uint32_t imageIndex) { m_currentImageIndex = imageIndex; };
     uint32_t& GetCurrentImageIndex() { return m_currentImageIndex; };
@@ -1,5 +1,7 @@
 #pragma once
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include "vulkan/vulkan.h"
 
 #include "Includes/Defines.h"
@@ -7,11 +9,11 @@
 #include "GfxDevice.h"
 #include "GfxBuffer.h"
 #include "GfxDescriptorPool.h"
+#include "GfxDescriptorLayoutCache.h"
 
 class GfxUniformBufferBase
 {
 public:
-    static const uint32_t c_uniformBufferOffset = 1;
     virtual VkDescriptorSetLayout GetLayout() = 0;
     virtual constexpr uint32_t GetSetIndex() = 0;
 
@@ -20,7 +22,8 @@ public:
     virtual operator VkDescriptorSet& () = 0;
 };
 
-template<typename Data, uint32_t SetIndex = 0>
+// Data is normally one of the ShaderStructs ShaderBuilder generates, which carry the set they are bound to
+template<typename Data, uint32_t SetIndex = Data::Set>
 class GfxUniformBuffer : public GfxUniformBufferBase
 {
     static GfxDevice* s_device;
@@ -32,6 +35,7 @@ class GfxUniformBuffer : public GfxUniformBufferBase
 public:
     Data m_data;
 
+    // takes the set layout from GfxDescriptorLayoutCache, which has to be initialized
     static void CreateLayout(GfxDevice& device);
 
     VkDescriptorSetLayout GetLayout() override
@@ -50,7 +54,7 @@ public:
 
     constexpr uint32_t GetSetIndex() override
     {
-        return SetIndex + c_uniformBufferOffset;
+        return SetIndex;
     }
 
     void CreateBuffer()
@@ -99,8 +103,6 @@ public:
         m_buffer.Unmap();
         m_buffer.CleanUp();
     }
-
-    static void CleanUpLayouts();
 };
 
 
@@ -108,26 +110,14 @@ template<typename Data, uint32_t SetIndex>
 void GfxUniformBuffer<Data, SetIndex>::CreateLayout(GfxDevice& device)
 {
     s_device = &device;
-    VkDescriptorSetLayoutBinding uboLayoutBinding{};
-    uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
-    uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
-
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
-
-    API_CALL(vkCreateDescriptorSetLayout, device, &layoutInfo, nullptr, &s_descriptorSetLayout);
-
-}
-
-template<typename Data, uint32_t SetIndex>
-void GfxUniformBuffer<Data, SetIndex>::CleanUpLayouts()
-{
-    API_CALL(vkDestroyDescriptorSetLayout, *s_device, s_descriptorSetLayout, nullptr);
+    const GfxDescriptorLayoutCache& layoutCache = GfxDescriptorLayoutCache::GetInstance();
+    const VkDescriptorSetLayoutBinding* binding = layoutCache.FindBinding(SetIndex, 0);
+    UNUSED_PARAM(binding);
+    assert(binding && binding->descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    // the shaders must not read past the end of Data
+    assert(layoutCache.GetBufferSize(SetIndex, 0) <= sizeof(Data));
+
+    s_descriptorSetLayout = layoutCache.GetSetLayout(SetIndex);
 }
 
 template<typename Data, uint32_t SetIndex>
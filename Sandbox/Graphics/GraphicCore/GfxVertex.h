@@ -1,39 +1,172 @@
 #pragma once
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include "vulkan/vulkan.h"
 
 #include "glm/glm.hpp"
-#include <vector>
+#include "glm/gtc/packing.hpp"
+#include <array>
+#include <cstring>
+#include <span>
 
+// vertex attribute formats, Source is what the cpu side works with and Storage what ends up in the vertex buffer
+struct GfxFloat2
+{
+    using Source = glm::vec2;
+    using Storage = glm::vec2;
+    static constexpr VkFormat c_format = VK_FORMAT_R32G32_SFLOAT;
+    static Storage Encode(const Source& value) { return value; }
+};
+
+struct GfxFloat3
+{
+    using Source = glm::vec3;
+    using Storage = glm::vec3;
+    static constexpr VkFormat c_format = VK_FORMAT_R32G32B32_SFLOAT;
+    static Storage Encode(const Source& value) { return value; }
+};
+
+// [-1, 1] in 16 bits per component, values outside are clamped
+struct GfxSnorm16x2
+{
+    using Source = glm::vec2;
+    using Storage = uint32_t;
+    static constexpr VkFormat c_format = VK_FORMAT_R16G16_SNORM;
+    static Storage Encode(const Source& value) { return glm::packSnorm2x16(value); }
+};
+
+struct GfxHalf2
+{
+    using Source = glm::vec2;
+    using Storage = uint32_t;
+    static constexpr VkFormat c_format = VK_FORMAT_R16G16_SFLOAT;
+    static Storage Encode(const Source& value) { return glm::packHalf2x16(value); }
+};
+
+struct GfxRgba8
+{
+    using Source = glm::vec4;
+    using Storage = uint32_t;
+    static constexpr VkFormat c_format = VK_FORMAT_R8G8B8A8_UNORM;
+    static Storage Encode(const Source& value) { return glm::packUnorm4x8(value); }
+};
+
+// unit vector folded onto an octahedron and stored as 2 snorm16s, the shader unfolds it with
+// n = vec3(e, 1 - |e.x| - |e.y|); if (n.z < 0) n.xy = (1 - abs(n.yx)) * sign(n.xy); normalize(n)
+struct GfxOctNormal16
+{
+    using Source = glm::vec3;
+    using Storage = uint32_t;
+    static constexpr VkFormat c_format = VK_FORMAT_R16G16_SNORM;
+    static Storage Encode(const Source& normal)
+    {
+        glm::vec2 encoded = glm::vec2(normal) / (glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z));
+        if (normal.z < 0.0f)
+        {
+            glm::vec2 sign = { encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f };
+            encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+        }
+        return glm::packSnorm2x16(encoded);
+    }
+};
+
+// per instance data at binding 1, filled in by GfxDrawList
+struct GfxInstance
+{
+    // index into the object structured buffer
+    uint32_t objectIndex;
+    // the mesh's position = stored position * xy + zw, see GfxMesh
+    glm::vec4 positionScaleBias;
+};
 
+namespace GfxVertexLayoutDetail
+{
+    template<size_t Count>
+    constexpr std::array<uint32_t, Count> PrefixSums(const std::array<uint32_t, Count>& sizes)
+    {
+        std::array<uint32_t, Count> offsets{};
+        uint32_t offset = 0;
+        for (size_t i = 0; i < Count; ++i)
+        {
+            offsets[i] = offset;
+            offset += sizes[i];
+        }
+        return offsets;
+    }
+
+    static constexpr uint32_t c_instanceAttributeCount = 2;
+
+    // vertex attributes at binding 0 in order, followed by the GfxInstance attributes at binding 1
+    template<size_t Count>
+    constexpr std::array<VkVertexInputAttributeDescription, Count + c_instanceAttributeCount> MakeAttributes(const std::array<VkFormat, Count>& formats, const std::array<uint32_t, Count>& offsets)
+    {
+        std::array<VkVertexInputAttributeDescription, Count + c_instanceAttributeCount> attributes{};
+        for (uint32_t i = 0; i < Count; ++i)
+        {
+            attributes[i] = { .location = i, .binding = 0, .format = formats[i], .offset = offsets[i] };
+        }
+        attributes[Count] = { .location = uint32_t(Count), .binding = 1, .format = VK_FORMAT_R32_UINT, .offset = offsetof(GfxInstance, objectIndex) };
+        attributes[Count + 1] = { .location = uint32_t(Count + 1), .binding = 1, .format = VK_FORMAT_R32G32B32A32_SFLOAT, .offset = offsetof(GfxInstance, positionScaleBias) };
+        return attributes;
+    }
+}
+
+// tightly packed vertex made of the given attribute formats, locations follow the order they are listed in and
+// the instance attributes come right after them. binding and attribute descriptions are generated at compile time
+template<typename... Attributes>
+struct GfxVertexLayout
+{
+    static constexpr size_t c_attributeCount = sizeof...(Attributes);
+    static constexpr std::array<uint32_t, c_attributeCount> c_offsets = GfxVertexLayoutDetail::PrefixSums<c_attributeCount>({ uint32_t(sizeof(typename Attributes::Storage))... });
+    static constexpr uint32_t c_stride = (0 + ... + uint32_t(sizeof(typename Attributes::Storage)));
+    static constexpr std::array<VkVertexInputBindingDescription, 2> c_bindingDescriptions =
+    { {
+        { .binding = 0, .stride = c_stride, .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
+        { .binding = 1, .stride = sizeof(GfxInstance), .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE },
+    } };
+    static constexpr std::array<VkVertexInputAttributeDescription, c_attributeCount + GfxVertexLayoutDetail::c_instanceAttributeCount> c_attributeDescriptions =
+        GfxVertexLayoutDetail::MakeAttributes<c_attributeCount>({ Attributes::c_format... }, c_offsets);
+
+    // encodes one vertex to destination, which needs c_stride bytes
+    static void Write(uint8_t* destination, const typename Attributes::Source&... values)
+    {
+        size_t attribute = 0;
+        (WriteAttribute<Attributes>(destination + c_offsets[attribute++], values), ...);
+    }
+
+private:
+    template<typename Attribute>
+    static void WriteAttribute(uint8_t* destination, const typename Attribute::Source& value)
+    {
+        const typename Attribute::Storage encoded = Attribute::Encode(value);
+        memcpy(destination, &encoded, sizeof(encoded));
+    }
+};
+
+// what meshes are authored in, GfxMeshRegistry converts them to Layout when they are added
 struct GfxStandardVertex
 {
     glm::vec2 pos;
     glm::vec3 color;
 
-    static VkVertexInputBindingDescription GetBindingDescription() {
-        VkVertexInputBindingDescription bindingDescription{};
+    // 8 bytes instead of 20. positions are snorm16 within the mesh's bounds, the shader scales them back with the
+    // mesh's positionScaleBias
+    using Layout = GfxVertexLayout<GfxSnorm16x2, GfxRgba8>;
 
-        bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(GfxStandardVertex);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    // positionScaleBias maps the mesh's bounds onto [-1, 1], see GfxMesh
+    static void Encode(const GfxStandardVertex& vertex, const glm::vec4& positionScaleBias, uint8_t* destination)
+    {
+        const glm::vec2 position = (vertex.pos - glm::vec2(positionScaleBias.z, positionScaleBias.w)) / glm::vec2(positionScaleBias.x, positionScaleBias.y);
+        Layout::Write(destination, position, glm::vec4(vertex.color, 1.0f));
+    }
 
-        return bindingDescription;
+    static std::span<const VkVertexInputBindingDescription> GetBindingDescriptions()
+    {
+        return Layout::c_bindingDescriptions;
     }
-    static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions() 
+    static std::span<const VkVertexInputAttributeDescription> GetAttributeDescriptions()
     {
-        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
-        attributeDescriptions.resize(2);
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(GfxStandardVertex, pos);
-
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(GfxStandardVertex, color);
-
-        return attributeDescriptions;
+        return Layout::c_attributeDescriptions;
     }
 };
@@ -1,12 +1,12 @@
 #pragma once
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <vulkan/vulkan.h>
 #include <stdexcept>
 #include <vector>
 
-#ifndef NDEBUG
-#include <iostream>
-#endif
+#include "Includes/Defines.h"
 
 template<typename T, typename... Args>
 VkResult API_CALL(T t, Args&&... args)
@@ -19,7 +19,7 @@ VkResult API_CALL(T t, Args&&... args)
         VkResult res = t(args...);
         if (res != VK_SUCCESS)
         {
-            std::cout << "API error " << res << std::endl;
+            Log<Severe>("API error %d\n", res);
         }
         return res;
 #endif
@@ -4,6 +4,10 @@
 #include "Includes/Defines.h"
 #include "Engine/PlatformManager.h"
 #include "../ShaderManagement/GfxShaderManager.h"
+#include "Engine/AllocationCounter.h"
+#include "Engine/FrameAllocator.h"
+#include "GfxMeshRegistry.h"
+#include "GfxDescriptorLayoutCache.h"
 
 #include <vector>
 
@@ -12,6 +16,7 @@ uint32_t thread_local GraphicEngine::ms_thread_id = 0;
 void* operator new(std::size_t count)
 {
     auto ptr = malloc(count);
+    AllocationCounter::CountAllocation(count);
     TracyAlloc(ptr, count);
     return ptr;
 }
@@ -88,22 +93,26 @@ VKAPI_ATTR VkBool32 VKAPI_CALL GraphicEngine::debugCallback(VkDebugUtilsMessageS
     case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
         return VK_FALSE;
         // TMI
-        //  Log("Vulkan Verbose: %s\n", Debug, pCallbackData->pMessage);
+        //  Log<Debug>("Vulkan Verbose: %s\n", pCallbackData->pMessage);
         //  break;
     case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
-        Log("Vulkan Info : %s\n", Debug, pCallbackData->pMessage);
+        Log<Debug>("Vulkan Info : %s\n", pCallbackData->pMessage);
         break;
     case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
-        Log("Vulkan Warning: %s\n", Debug, pCallbackData->pMessage);
+        Log<Debug>("Vulkan Warning: %s\n", pCallbackData->pMessage);
         break;
     case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
-        Log("Vulkan Error: %s\n", Debug, pCallbackData->pMessage);
+        Log<Debug>("Vulkan Error: %s\n", pCallbackData->pMessage);
         break;
     default:
-        Log("Vulkan Unkown: %s\n", Debug, pCallbackData->pMessage);
+        Log<Debug>("Vulkan Unkown: %s\n", pCallbackData->pMessage);
         break;
     }
+#ifdef _WIN32
+    // the logger thread would print the message after the break, make sure it is out before stopping
+    Logger::Flush();
     __debugbreak();
+#endif
     return VK_FALSE;
 }
 
@@ -165,17 +174,17 @@ void GraphicEngine::InitLayerExtInfo()
         vkEnumerateInstanceLayerProperties(&layerCount, m_availLayers.data());
     }
 #ifdef DEBUG
-    Log("available extensions:\n", Verbose);
+    Log<Verbose>("available extensions:\n");
 
     for (const auto& extension : m_availExtensions)
     {
-        Log("\t%s\n", Verbose, extension.extensionName);
+        Log<Verbose>("\t%s\n", extension.extensionName);
     }
 
-    Log("available Layers:\n", Verbose);
+    Log<Verbose>("available Layers:\n");
     for (const auto& layer : m_availLayers)
     {
-        Log("\t%s\n", Verbose, layer.layerName);
+        Log<Verbose>("\t%s\n", layer.layerName);
     }
 #endif
     DEBUG_ONLY(m_layerExtInitialised = true);
@@ -211,7 +220,7 @@ void GraphicEngine::AddLayer(const char* layerName, bool required)
     else
     {
         assert(!required);
-        Log("Layer %s not avaiable", Severe, layerName);
+        Log<Severe>("Layer %s not avaiable", layerName);
     }
 }
 
@@ -223,7 +232,7 @@ void GraphicEngine::AddExtension(const char* extensionName, bool required)
     else
     {
         assert(!required);
-        Log("Extension %s not avaiable", Severe, extensionName);
+        Log<Severe>("Extension %s not avaiable", extensionName);
     }
 }
 
@@ -241,11 +250,19 @@ void GraphicEngine::Init()
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
 
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    if (PlatformManager::GetInstance().IsHeadless())
+    {
+        m_requiredVulkanExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+        m_requiredVulkanExtensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+    }
+    else
+    {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-    m_EnabledExtensions.insert(m_EnabledExtensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+        m_EnabledExtensions.insert(m_EnabledExtensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     for (const auto name : m_requiredVulkanExtensions)
         AddExtension(name, true);
@@ -274,6 +291,8 @@ void GraphicEngine::Init()
     m_device.Init(m_vkInstance);
     GfxShaderManager::CreateInstance();
     GfxShaderManager::GetInstance().Init(m_device);
+    GfxDescriptorLayoutCache::CreateInstance();
+    GfxDescriptorLayoutCache::GetInstance().Init(m_device);
     GfxPipelineStateManager::CreateInstance();
     m_cachedPipelineManager = GfxPipelineStateManager::GetInstancePtr();
     m_cachedPipelineManager->Init(m_device);
@@ -303,8 +322,13 @@ void GraphicEngine::Init()
     m_objectManager = GfxObjectManager::GetInstancePtr();
     m_objectManager->Init(m_device, MAX_FRAMES_IN_FLIGHT);
 
+    GfxMeshRegistry::CreateInstance();
+    GfxMeshRegistry::GetInstance().Init(m_device);
+
 
     InitSyncObjects();
+    m_frameCapture.Init(m_device, MAX_FRAMES_IN_FLIGHT);
+    m_gpuProfiler.Init(m_device, MAX_FRAMES_IN_FLIGHT);
 
 #ifdef PROFILE
     m_profileCommandBuffer = m_commandPool.GetUntrackedCommandBuffer();
@@ -317,7 +341,7 @@ void GraphicEngine::BeginRenderPass()
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 
-    GfxRenderState renderState = m_cachedPipelineManager->GetRenderState();
+    const GfxRenderState& renderState = m_cachedPipelineManager->GetRenderState();
     renderPassInfo.renderPass = renderState.renderPass;
     renderPassInfo.framebuffer = renderState.frameBuffer;
 
@@ -325,14 +349,8 @@ void GraphicEngine::BeginRenderPass()
     renderPassInfo.renderArea.extent = m_device.GetSwapChain().GetVkExtent();
 
     VkClearValue clearColor[8];
-    uint32_t i = 0;
-    while (renderState.clearValues[i].has_value())
-    {
-        clearColor[i] = { renderState.clearValues[i]->x, renderState.clearValues[i]->y, renderState.clearValues[i]->z, renderState.clearValues[i]->z };
-        ++i;
-    }
+    renderPassInfo.clearValueCount = m_cachedPipelineManager->GetClearValues(clearColor);
     renderPassInfo.pClearValues = clearColor;
-    renderPassInfo.clearValueCount = i;
 
     API_CALL(vkCmdBeginRenderPass, m_currentCommmandBuffer[ms_thread_id], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -346,7 +364,11 @@ void GraphicEngine::EndRenderPass()
 void GraphicEngine::CommitStates()
 {
     m_cachedPipelineManager->CommitStates(m_currentCommmandBuffer[ms_thread_id]);
+    SetDynamicStates();
+}
 
+void GraphicEngine::SetDynamicStates()
+{
     VkExtent2D swapChainExtent = m_device.GetSwapChain().GetVkExtent();
     VkViewport viewport{};
     viewport.x = 0.0f;
@@ -382,6 +404,7 @@ void GraphicEngine::BeginRecordingGraphics()
     m_currentCommmandBuffer[ms_thread_id] = m_commandPool.GetGraphicsCommandBuffer();
 
     m_currentCommmandBuffer[ms_thread_id].StartRecording();
+    m_gpuProfiler.BeginCommandBuffer(m_currentCommmandBuffer[ms_thread_id]);
 }
 
 void GraphicEngine::BeginRecordingCompute()
@@ -397,22 +420,95 @@ void GraphicEngine::BeginRecordingCompute()
 
 void GraphicEngine::EndRecording()
 {
+    m_gpuProfiler.EndCommandBuffer(m_currentCommmandBuffer[ms_thread_id]);
     m_currentCommmandBuffer[ms_thread_id].EndRecording();
 }
 
-void GraphicEngine::StartFrame()
+bool GraphicEngine::StartFrame()
 {
     CPU_ProfileZone(StartFrame);
     uint32_t imageIndex = 0;
 
     m_currentFrameIndex = (m_currentFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+    ++m_frameCount;
 
     vkWaitForFences(m_device, 1, &inFlightFence[m_currentFrameIndex], VK_TRUE, UINT64_MAX);
+    FrameAllocator::BeginFrame();
+    ReleaseRetiredSwapChains();
+    m_cachedPipelineManager->ReleaseRetiredPipelines(m_frameCount, MAX_FRAMES_IN_FLIGHT);
+    m_frameCapture.Resolve(m_currentFrameIndex);
+
+    VkResult res = vkAcquireNextImageKHR(m_device, m_device.GetSwapChain(), UINT64_MAX, imageAvailableSemaphore[m_currentFrameIndex], VK_NULL_HANDLE, &imageIndex);
+    if (res == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        // semaphore is not signaled when out of date so it can be reused for the new swapchain
+        if (!RecreateSwapChain())
+            return false;
+        res = vkAcquireNextImageKHR(m_device, m_device.GetSwapChain(), UINT64_MAX, imageAvailableSemaphore[m_currentFrameIndex], VK_NULL_HANDLE, &imageIndex);
+    }
+    // suboptimal still signals the semaphore, recreate after presenting instead
+    if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR)
+    {
+        Log<Severe>("Failed to acquire swapchain image %d\n", res);
+        return false;
+    }
+
+    // only reset once we know work will be submitted, otherwise the next wait on this fence never returns
     vkResetFences(m_device, 1, &inFlightFence[m_currentFrameIndex]);
-    vkAcquireNextImageKHR(m_device, m_device.GetSwapChain(), UINT64_MAX, imageAvailableSemaphore[m_currentFrameIndex], VK_NULL_HANDLE, &imageIndex);
     m_device.GetSwapChain().SetCurrentImageIndex(imageIndex);
     m_commandPool.SetCurrentFrame(m_currentFrameIndex);
+    m_gpuProfiler.BeginFrame(m_currentFrameIndex, m_frameCount);
+
+    return true;
+}
+
+bool GraphicEngine::RecreateSwapChain()
+{
+    CPU_ProfileZone(RecreateSwapChain);
+    PlatformManager& pm = PlatformManager::GetInstance();
+    pm.ConsumeResized();
+
+    // minimised windows have a 0 sized framebuffer, nothing can be created until it is restored
+    // this can run on the render thread so waiting for the window events is left to the main thread
+    glm::vec2 size = pm.GetSize();
+    if (size.x == 0 || size.y == 0)
+        return false;
 
+    // no device idle here, frames in flight keep using the old swapchain resources until they retire
+    GfxRetiredSwapChain retired;
+    std::vector<VkImage> oldImages;
+    m_device.GetSwapChain().Recreate(size, retired, oldImages);
+    m_cachedPipelineManager->RecreateSwapChainFramebuffers(oldImages, retired.framebuffers);
+
+    retired.retireFrame = m_frameCount;
+    m_retiredSwapChains.emplace_back(std::move(retired));
+    return true;
+}
+
+void GraphicEngine::DestroyRetiredSwapChain(GfxRetiredSwapChain& retired)
+{
+    for (auto framebuffer : retired.framebuffers)
+    {
+        API_CALL(vkDestroyFramebuffer, m_device, framebuffer, nullptr);
+    }
+    retired.framebuffers.clear();
+    retired.imageViews.clear();
+    API_CALL(vkDestroySwapchainKHR, m_device, retired.swapChain, nullptr);
+}
+
+void GraphicEngine::ReleaseRetiredSwapChains(bool force)
+{
+    // every frame slot has been waited on since the swapchain was retired
+    // once MAX_FRAMES_IN_FLIGHT frames have started after the retiring frame
+    uint32_t released = 0;
+    for (auto& retired : m_retiredSwapChains)
+    {
+        if (!force && m_frameCount < retired.retireFrame + MAX_FRAMES_IN_FLIGHT)
+            break;
+        DestroyRetiredSwapChain(retired);
+        ++released;
+    }
+    m_retiredSwapChains.erase(m_retiredSwapChains.begin(), m_retiredSwapChains.begin() + released);
 }
 
 void GraphicEngine::Submit()
@@ -476,9 +572,24 @@ void GraphicEngine::Flip()
     presentInfo.pImageIndices = &m_device.GetSwapChain().GetCurrentImageIndex();
     presentInfo.pResults = nullptr; // Optional
 
-    vkQueuePresentKHR(m_device.GetPresentQueue(), &presentInfo);
+    VkResult res = vkQueuePresentKHR(m_device.GetPresentQueue(), &presentInfo);
 
     m_commandPool.FrameFlip();
+
+    bool resized = PlatformManager::GetInstance().ConsumeResized();
+    if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR || resized)
+    {
+        RecreateSwapChain();
+    }
+    else if (res != VK_SUCCESS)
+    {
+        Log<Severe>("Failed to present swapchain image %d\n", res);
+    }
+}
+
+void GraphicEngine::CaptureFrame(const std::string& path)
+{
+    m_frameCapture.Record(m_currentCommmandBuffer[ms_thread_id], m_currentFrameIndex, path);
 }
 
 uint32_t GraphicEngine::GetCurrentFrame()
@@ -508,6 +619,13 @@ void GraphicEngine::Cleanup()
 {
     vkDeviceWaitIdle(m_device);
     CleanupSyncObjects();
+    ReleaseRetiredSwapChains(true);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        m_frameCapture.Resolve(i);
+    }
+    m_frameCapture.CleanUp();
+    m_gpuProfiler.CleanUp();
 
 #ifdef PROFILE
     m_commandPool.ReleaseUntrackedCommandBuffer(m_profileCommandBuffer.GetVkCommandBuffer());
@@ -515,10 +633,12 @@ void GraphicEngine::Cleanup()
 #endif
 
     m_objectManager->CleanUp();
+    GfxMeshRegistry::GetInstance().CleanUp();
     GfxDescriptorPool::GetInstance().CleanUp();
     m_commandPool.CleanUp();
     GfxShaderManager::GetInstance().CleanUp();
     GfxPipelineStateManager::GetInstance().CleanUp();
+    GfxDescriptorLayoutCache::GetInstance().CleanUp();
 
     m_device.CleanUp();
 
@@ -7,6 +7,9 @@
 #include "GfxCommandPool.h"
 #include "GfxDescriptorPool.h"
 #include "GfxObjectManager.h"
+#include "GfxFrameCapture.h"
+#include "GfxGpuProfiler.h"
+#include "Engine/JobSystem.h"
 
 #include <vector>
 #ifdef PROFILE
@@ -26,7 +29,8 @@ private:
     GraphicEngine();
     VkInstance m_vkInstance = VK_NULL_HANDLE;
 
-    static const uint32_t c_maxThreads = 8;
+    // one command buffer slot per job system thread
+    static const uint32_t c_maxThreads = JobSystem::c_maxThreads;
 #ifndef NDEBUG
 
     VkDebugUtilsMessengerEXT m_debugMessenger = VK_NULL_HANDLE;
@@ -77,9 +81,20 @@ private:
     std::vector<VkFence> inFlightFence;
 
     uint32_t m_currentFrameIndex;
+    // total frames started, used to know when retired resources are no longer used by frames in flight
+    uint64_t m_frameCount = 0;
+
+    std::vector<GfxRetiredSwapChain> m_retiredSwapChains;
+
+    GfxFrameCapture m_frameCapture;
+    GfxGpuProfiler m_gpuProfiler;
 
     void InitSyncObjects();
     void CleanupSyncObjects();
+
+    bool RecreateSwapChain();
+    void DestroyRetiredSwapChain(GfxRetiredSwapChain& retired);
+    void ReleaseRetiredSwapChains(bool force = false);
 public:
     const int MAX_FRAMES_IN_FLIGHT = 2;
     void InitLayerExtInfo();
@@ -89,6 +104,14 @@ public:
     void AddExtension(const char* extensionName, bool required = false);
     GfxDevice& GetDevice() { return m_device; };
 
+    // maps the calling thread onto its own command buffer slot, set by the job system for its threads
+    static void SetThreadId(uint32_t threadId)
+    {
+        assert(threadId < c_maxThreads);
+        ms_thread_id = threadId;
+    }
+    static uint32_t GetThreadId() { return ms_thread_id; }
+
     void Init();
     void Cleanup();
 
@@ -96,6 +119,8 @@ public:
     void EndRenderPass();
 
     void CommitStates();
+    // viewport and scissor covering the swapchain, part of CommitStates
+    void SetDynamicStates();
 
     void BeginOutOfFrameRecording();
     void EndOutOfFrameRecording();
@@ -104,11 +129,18 @@ public:
     void BeginRecordingCompute();
     void EndRecording();
 
-    void StartFrame();
+    // returns false if there is nothing to render to this frame (eg. minimised window)
+    bool StartFrame();
     void Submit();
     void SubmitWithSync();
     void Flip();
+
+    // writes the current swapchain image to path once the frame has finished on the gpu
+    // call after the last render pass of the frame
+    void CaptureFrame(const std::string& path);
     uint32_t GetCurrentFrame();
+    uint64_t GetFrameCount() const { return m_frameCount; }
+    GfxGpuProfiler& GetGpuProfiler() { return m_gpuProfiler; }
 
     const GfxCommandBuffer& GetCurrentCommandBuffer();
 #ifdef PROFILE
@@ -34,3 +34,20 @@ bool GfxShader::Init(GfxDevice& device, ShaderType shaderType, const uint32_t* s
 
     return true;
 }
+
+bool GfxShader::Reload(const uint32_t* shaderCode, size_t size)
+{
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = size;
+    createInfo.pCode = shaderCode;
+
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    if (API_CALL(vkCreateShaderModule, *m_device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+        return false;
+
+    if (m_shaderModule != VK_NULL_HANDLE)
+        vkDestroyShaderModule(*m_device, m_shaderModule, nullptr);
+    m_shaderModule = shaderModule;
+    return true;
+}
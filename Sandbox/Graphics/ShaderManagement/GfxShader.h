@@ -15,4 +15,7 @@ public:
     ShaderType GetShaderType() const;
     operator VkShaderModule() const;
     bool Init(GfxDevice& device, ShaderType shaderType, const uint32_t* shaderCode, size_t size);
+    // replaces the module in place so everything holding this GfxShader sees the new code, pipelines already created
+    // from the old module keep working. the old module is destroyed, nothing may be creating a pipeline with it
+    bool Reload(const uint32_t* shaderCode, size_t size);
 };
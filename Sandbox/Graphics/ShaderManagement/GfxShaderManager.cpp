@@ -1,82 +1,202 @@
 #include "GfxShaderManager.h"
 #include "../autogen/ShaderData.h"
 #include "Includes/Defines.h"
+#include "Engine/JobSystem.h"
 
 #include <fstream>
 #include <cassert>
+#include <stdexcept>
 
-void GfxShaderManager::LoadShaderPerms(ShaderInfo& shaderName, uint32_t baseHash, uint32_t defineFlags, uint32_t numDefines)
-{
-    uint32_t curDefineFlags = (1 << (numDefines - 1) << ShaderDefineBitshift);
+// GPU zones are only useful if captures taken alongside them map back to the shader source, the profile configuration
+// builds its shaders with ShaderBuilder --debug-info so the optimizer keeps it
+#ifdef PROFILE
+static_assert(ShaderDebugInfo, "PROFILE builds need shaders built with --debug-info, check the Sandbox pre-build step");
+#endif
 
-    for (uint32_t i = 0; i < numDefines; ++i)
+void GfxShaderManager::RegisterShaderPerms(ShaderInfo& shaderName, uint32_t baseHash)
+{
+    for (uint32_t i = 0; i < shaderName.GetNumPermutations(); ++i)
     {
-        uint32_t hash = (baseHash & ShaderKeyMask) | ((defineFlags | (curDefineFlags >> i)) & ShaderDefineMask);
-        CreateShader(shaderName, hash);
-
-        // recursively initialise all permutations
-        LoadShaderPerms(shaderName, baseHash, (defineFlags | (curDefineFlags >> i) & ShaderDefineMask), (numDefines - 1) - i);
+        ShaderKey key = CombineShaderKey(baseHash & ShaderKeyMask, shaderName.GetPermutation(i));
+        assert(m_shaderMap.find(key) == m_shaderMap.end());
+        ShaderEntry& entry = m_shaderMap[key];
+        entry.info = &shaderName;
+        entry.key = key;
     }
 }
 
-void GfxShaderManager::LoadShaderPerms(ShaderInfo& shaderName, uint32_t baseHash, uint32_t numDefines)
-{
-    Log("Loading Shader %s\n", Verbose, std::string(shaderName).c_str());
-    CreateShader(shaderName, baseHash);
-    LoadShaderPerms(shaderName, baseHash, 0, numDefines);
-}
-
-void GfxShaderManager::CreateShader(ShaderInfo& shaderName, uint32_t hash)
+bool GfxShaderManager::ReadShaderFile(ShaderInfo& shaderName, uint32_t hash, std::vector<char>& code)
 {
-    std::string shaderFolderPath = "../Bin/Shaders/";
     char shaderFullName[128];
-    sprintf_s<128>(shaderFullName, "%s_%08X.spv", std::string(shaderName).c_str(), hash);
-    std::string shaderPath = shaderFolderPath + shaderFullName;
-
-    assert(m_shaderMap.find(hash) == m_shaderMap.end());
-
-    GfxShader shader;
+    snprintf(shaderFullName, sizeof(shaderFullName), "%s_%08X.spv", std::string(shaderName).c_str(), hash);
+    std::string shaderPath = std::string(c_shaderFolder) + shaderFullName;
 
     std::ifstream fs{ shaderPath, std::ios::ate | std::ios::binary };
     if (!fs.is_open())
     {
-        Log("Cannot find Shader %s at %s\n", Severe, shaderFullName, shaderPath.c_str());
-        return;
+        Log<Severe>("Cannot find Shader %s at %s\n", shaderFullName, shaderPath.c_str());
+        return false;
     }
 
     size_t fileSize = (size_t)fs.tellg();
-    std::vector<char> buffer(fileSize);
+    code.resize(fileSize);
     fs.seekg(0);
-    fs.read(buffer.data(), fileSize);
-    fs.close();
+    fs.read(code.data(), fileSize);
+    return true;
+}
+
+bool GfxShaderManager::CreateShader(ShaderInfo& shaderName, uint32_t hash, GfxShader& shader)
+{
+    char shaderFullName[128];
+    snprintf(shaderFullName, sizeof(shaderFullName), "%s_%08X.spv", std::string(shaderName).c_str(), hash);
+
+    if (const ShaderArchiveEntry* entry = FindShaderArchiveEntry(m_archiveEntries, m_archiveEntryCount, hash))
+    {
+        const uint8_t* code = m_archive.GetData() + entry->offset;
+        // the mapping is only checked for corruption in debug, release trusts ShaderBuilder
+        assert(ShaderContentHash(code, size_t(entry->size)) == entry->hash);
+        try
+        {
+            shader.Init(*m_device, ShaderType(shaderName.GetShaderStage()), reinterpret_cast<const uint32_t*>(code), size_t(entry->size));
+        }
+        catch (...)
+        {
+            Log<Severe>("Failed to init Shader %s\n", shaderFullName);
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<char> buffer;
+    if (!ReadShaderFile(shaderName, hash, buffer))
+        return false;
 
     try
     {
-        m_shaderMap[hash].Init(*m_device, ShaderType(shaderName.GetShaderStage()), reinterpret_cast<const uint32_t*>(buffer.data()), buffer.size());
+        shader.Init(*m_device, ShaderType(shaderName.GetShaderStage()), reinterpret_cast<const uint32_t*>(buffer.data()), buffer.size());
     }
     catch (...)
     {
-        Log("Failed to init Shader %s\n", Severe, shaderFullName);
+        Log<Severe>("Failed to init Shader %s\n", shaderFullName);
+        return false;
+    }
+    return true;
+}
+
+void GfxShaderManager::LoadEntry(ShaderEntry& entry)
+{
+    if (entry.loaded.load(std::memory_order_acquire))
+        return;
+
+    std::call_once(entry.loadFlag, [this, &entry]()
+    {
+        CPU_ProfileZone(LoadShader);
+        Log<Verbose>("Loading Shader %s %08X\n", std::string(*entry.info).c_str(), entry.key);
+        entry.valid = CreateShader(*entry.info, entry.key, entry.shader);
+        if (entry.valid)
+            m_loadedCount.fetch_add(1, std::memory_order_relaxed);
+        entry.loaded.store(true, std::memory_order_release);
+    });
+}
+
+const GfxShader& GfxShaderManager::Load(ShaderKey key)
+{
+    auto itr = m_shaderMap.find(key);
+    if (itr == m_shaderMap.end())
+        throw std::runtime_error("shader permutation was not built");
+
+    ShaderEntry& entry = itr->second;
+    LoadEntry(entry);
+    if (!entry.valid)
+        throw std::runtime_error("shader permutation failed to load");
+    return entry.shader;
+}
+
+void GfxShaderManager::Prefetch(const ShaderKey* keys, uint32_t count, JobCounter& counter)
+{
+    std::vector<Job> jobs;
+    jobs.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        auto itr = m_shaderMap.find(keys[i]);
+        if (itr == m_shaderMap.end())
+        {
+            Log<Debug>("Prefetching shader %08X which was not built\n", keys[i]);
+            continue;
+        }
+        if (itr->second.loaded.load(std::memory_order_acquire))
+            continue;
+
+        // entries never move, so the job can point straight at it
+        jobs.push_back({ [](void* data, uint32_t, uint32_t)
+        {
+            GfxShaderManager::GetInstance().LoadEntry(*static_cast<ShaderEntry*>(data));
+        }, &itr->second, 0, 0, nullptr });
+    }
+    if (!jobs.empty())
+        JobSystem::GetInstance().Run(jobs.data(), uint32_t(jobs.size()), &counter);
+}
+
+void GfxShaderManager::Reload(const ShaderKey* keys, uint32_t count, std::vector<const GfxShader*>& reloaded)
+{
+    std::vector<char> code;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        auto itr = m_shaderMap.find(keys[i]);
+        if (itr == m_shaderMap.end())
+            continue;
+
+        ShaderEntry& entry = itr->second;
+        // a load after the swap would come from the stale archive
+        LoadEntry(entry);
+        if (!entry.valid || !ReadShaderFile(*entry.info, entry.key, code))
+            continue;
+        if (!entry.shader.Reload(reinterpret_cast<const uint32_t*>(code.data()), code.size()))
+        {
+            Log<Severe>("Failed to reload Shader %s %08X\n", std::string(*entry.info).c_str(), entry.key);
+            continue;
+        }
+        reloaded.push_back(&entry.shader);
     }
 }
 
 void GfxShaderManager::Init(GfxDevice& device)
 {
     m_device = &device;
+
+    std::string archivePath = std::string(c_shaderFolder) + ShaderArchiveName;
+    if (m_archive.Open(archivePath.c_str()))
+    {
+        m_archiveEntries = GetShaderArchiveEntries(m_archive.GetData(), m_archive.GetSize());
+        if (m_archiveEntries)
+        {
+            m_archiveEntryCount = reinterpret_cast<const ShaderArchiveHeader*>(m_archive.GetData())->entryCount;
+        }
+        else
+        {
+            Log<Severe>("%s is not a valid shader archive, loading loose .spv files\n", archivePath.c_str());
+            m_archive.Close();
+        }
+    }
     for (auto& shaderInfo : g_shaderInfos)
     {
         uint32_t baseHash = (*shaderInfo);
 
-        LoadShaderPerms(*shaderInfo, baseHash, shaderInfo->GetNumDefines());
+        RegisterShaderPerms(*shaderInfo, baseHash);
     }
+    Log<Verbose>("%u shader permutations available, %u in the archive\n", uint32_t(m_shaderMap.size()), m_archiveEntryCount);
 }
 
 const GfxShader& GfxShaderManager::GetShader(ShaderKey key)
 {
-    return ms_instance->m_shaderMap.at(key);
+    return ms_instance->Load(key);
 }
 
 void GfxShaderManager::CleanUp()
 {
     m_shaderMap.clear();
+    m_loadedCount.store(0, std::memory_order_relaxed);
+    m_archive.Close();
+    m_archiveEntries = nullptr;
+    m_archiveEntryCount = 0;
 }
@@ -1,33 +1,79 @@
 #pragma once
 
 #include "Shared/ShaderIncludes.h"
+#include "Shared/ShaderArchive.h"
 #include "../autogen/ShaderData.h"
 #include "Includes/Defines.h"
 #include "Graphics/GraphicCore/GfxDevice.h"
 #include "GfxShader.h"
+#include "Engine/MappedFile.h"
 
+#include <atomic>
+#include <mutex>
 #include <unordered_map>
 #include "vulkan/vulkan.h"
 
+class JobCounter;
+
+// every permutation listed in ShaderData.h is known from Init, but its .spv is only read and its module created by
+// the first GetShader (or ahead of time through Prefetch), so startup only pays for the shaders that get used
+// with ShaderBuilder's archive (ShaderArchive.h) mapped, modules are created straight from the mapping without
+// opening or copying anything, loose .spv files are only read for permutations missing from it
 class GfxShaderManager
 {
     DefaultSingleton(GfxShaderManager);
 private:
-    std::unordered_map<ShaderKey, GfxShader> m_shaderMap;
-    void LoadShaderPerms(ShaderInfo& shaderName, uint32_t baseHash, uint32_t defineFlags, uint32_t numDefines);
-    void LoadShaderPerms(ShaderInfo& shaderName, uint32_t baseHash, uint32_t numDefines);
-    void CreateShader(ShaderInfo& shaderName, uint32_t hash);
+    // where ShaderBuilder puts the .spv files and the archive, relative to the working directory
+    static constexpr const char* c_shaderFolder = "../Bin/Shaders/";
+
+    struct ShaderEntry
+    {
+        ShaderInfo* info = nullptr;
+        ShaderKey key = 0;
+        std::once_flag loadFlag;
+        // set once the load finished, whether it worked or not
+        std::atomic<bool> loaded{ false };
+        bool valid = false;
+        GfxShader shader;
+    };
+
+    // filled in by Init and left alone until CleanUp so lookups can happen from any thread without locking
+    std::unordered_map<ShaderKey, ShaderEntry> m_shaderMap;
+    std::atomic<uint32_t> m_loadedCount{ 0 };
+
+    MappedFile m_archive;
+    const ShaderArchiveEntry* m_archiveEntries = nullptr;
+    uint32_t m_archiveEntryCount = 0;
+
+    void RegisterShaderPerms(ShaderInfo& shaderName, uint32_t baseHash);
+    // the permutation's .spv in c_shaderFolder, false if it can't be read
+    static bool ReadShaderFile(ShaderInfo& shaderName, uint32_t hash, std::vector<char>& code);
+    bool CreateShader(ShaderInfo& shaderName, uint32_t hash, GfxShader& shader);
+    void LoadEntry(ShaderEntry& entry);
+    const GfxShader& Load(ShaderKey key);
 
     GfxDevice* m_device;
 public:
     void Init(GfxDevice& device);
     void CleanUp();
+    // loads the module on the calling thread if nobody did yet, throws if the permutation was not built
     static const GfxShader& GetShader(ShaderKey key);
     template<typename ShaderType>
-    const GfxShader& GetShader(ShaderType, ShaderKey defineHash) const
+    const GfxShader& GetShader(ShaderType, ShaderKey defineHash)
     {
         ShaderKey hash = (defineHash & ShaderDefineMask) | ShaderType::Hash;
-        return m_shaderMap.at(hash);
+        return Load(hash);
     }
-};
 
+    // loads the modules on job system workers, counter reaches 0 once they are all created
+    // GetShader on a key that is still loading waits for it
+    void Prefetch(const ShaderKey* keys, uint32_t count, JobCounter& counter);
+    uint32_t GetLoadedCount() const { return m_loadedCount.load(std::memory_order_relaxed); }
+    uint32_t GetShaderCount() const { return uint32_t(m_shaderMap.size()); }
+    static const char* GetShaderFolder() { return c_shaderFolder; }
+
+    // swaps in the modules of freshly built .spv files, the archive is not consulted as it still has the old code
+    // permutations nobody loaded yet are loaded first. reloaded gets every GfxShader that changed
+    // render thread only (see GfxShaderReloader), pipelines must not be created while this runs
+    void Reload(const ShaderKey* keys, uint32_t count, std::vector<const GfxShader*>& reloaded);
+};
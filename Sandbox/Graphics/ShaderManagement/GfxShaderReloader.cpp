@@ -0,0 +1,162 @@
+#include "GfxShaderReloader.h"
+#include "GfxShaderManager.h"
+#include "../autogen/ShaderData.h"
+#include "Graphics/GraphicCore/GfxPipelineStateManager.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+namespace
+{
+    // splits a make rule into its words, undoing the escaping ShaderBuilder's depfile does
+    std::vector<std::string> SplitRule(const std::string& line)
+    {
+        std::vector<std::string> words(1);
+        for (size_t i = 0; i < line.size(); ++i)
+        {
+            if (line[i] == '\\' && i + 1 < line.size() && (line[i + 1] == ' ' || line[i + 1] == '#'))
+                words.back() += line[++i];
+            else if (line[i] == '$' && i + 1 < line.size() && line[i + 1] == '$')
+                words.back() += line[++i];
+            else if (line[i] == ' ')
+                words.emplace_back();
+            else
+                words.back() += line[i];
+        }
+        std::erase_if(words, [](const std::string& word) { return word.empty(); });
+        return words;
+    }
+}
+
+void GfxShaderReloader::LoadDependencies()
+{
+    m_dependents.clear();
+    std::ifstream fs(std::string(c_intermediateFolder) + c_depFile);
+    std::string line;
+    while (std::getline(fs, line))
+    {
+        std::vector<std::string> words = SplitRule(line);
+        if (words.size() < 2 || words[0].back() != ':')
+            continue;
+        words[0].pop_back();
+
+        // <shader name>_<key in hex>.spv, the ShaderData.h rule has no key
+        std::filesystem::path target = words[0];
+        std::string stem = target.stem().string();
+        size_t separator = stem.rfind('_');
+        if (target.extension() != ".spv" || separator == std::string::npos)
+            continue;
+        ShaderKey key = ShaderKey(strtoul(stem.c_str() + separator + 1, nullptr, 16));
+
+        for (size_t i = 1; i < words.size(); ++i)
+        {
+            m_dependents[std::filesystem::path(words[i]).lexically_normal()].push_back(key);
+        }
+    }
+}
+
+bool GfxShaderReloader::Init()
+{
+    if (!m_watcher.Open(c_sourceFolder))
+    {
+        Log<Severe>("Cannot watch %s, shader hot reload is off\n", c_sourceFolder);
+        return false;
+    }
+    LoadDependencies();
+    if (m_dependents.empty())
+        Log<Severe>("No shader dependencies in %s%s, shader hot reload won't find anything to rebuild\n", c_intermediateFolder, c_depFile);
+    return true;
+}
+
+void GfxShaderReloader::CleanUp()
+{
+    if (m_builder.joinable())
+        m_builder.join();
+    JobSystem::GetInstance().WaitForCounter(m_pipelineCounter);
+    m_watcher.Close();
+    m_dependents.clear();
+    m_pendingKeys.clear();
+    m_retryKeys.clear();
+    m_buildingKeys.clear();
+}
+
+void GfxShaderReloader::StartBuild()
+{
+    m_buildingKeys.assign(m_pendingKeys.begin(), m_pendingKeys.end());
+    m_buildingKeys.insert(m_buildingKeys.end(), m_retryKeys.begin(), m_retryKeys.end());
+    m_pendingKeys.clear();
+    m_retryKeys.clear();
+
+    // the same options as the build that produced ShaderData.h, so only the edited permutations miss the cache
+    std::string command = std::string("\"") + c_shaderBuilder + "\" \"" + c_sourceFolder + "\" \"" + c_intermediateFolder + "\" \"" +
+        GfxShaderManager::GetShaderFolder() + "\" " + ShaderBuilderOptions + " --hot-reload";
+#ifdef _WIN32
+    // cmd strips the outer quotes of a command starting with one
+    command = "\"" + command + "\"";
+#endif
+    Log<Debug>("Rebuilding %zu shader permutations\n", m_buildingKeys.size());
+
+    m_buildDone.store(false, std::memory_order_relaxed);
+    m_builder = std::thread([this, command]()
+    {
+        m_buildResult = std::system(command.c_str());
+        m_buildDone.store(true, std::memory_order_release);
+    });
+}
+
+void GfxShaderReloader::FinishBuild()
+{
+    m_builder.join();
+    // includes may have been added or removed
+    LoadDependencies();
+    if (m_buildResult != 0)
+    {
+        Log<Severe>("ShaderBuilder failed (%d), keeping the current shaders\n", m_buildResult);
+        m_retryKeys.insert(m_buildingKeys.begin(), m_buildingKeys.end());
+        m_buildingKeys.clear();
+        return;
+    }
+
+    std::vector<const GfxShader*> reloaded;
+    GfxShaderManager::GetInstance().Reload(m_buildingKeys.data(), uint32_t(m_buildingKeys.size()), reloaded);
+    m_buildingKeys.clear();
+    if (reloaded.empty())
+        return;
+
+    m_rebuildingPipelines = GfxPipelineStateManager::GetInstance().RebuildPipelines(reloaded, m_pipelineCounter);
+    Log<Debug>("Reloaded %zu shader permutations, rebuilding %u pipelines\n", reloaded.size(), m_rebuildingPipelines);
+}
+
+void GfxShaderReloader::Update(uint64_t frameCount)
+{
+    CPU_ProfileZone(ShaderReload);
+    std::vector<std::filesystem::path> changed;
+    m_watcher.Poll(changed);
+    for (auto& path : changed)
+    {
+        // files nothing is built from (new shaders, editor backups) can't be reloaded
+        auto dependents = m_dependents.find(path);
+        if (dependents == m_dependents.end())
+            continue;
+        m_pendingKeys.insert(dependents->second.begin(), dependents->second.end());
+        m_lastChange = std::chrono::steady_clock::now();
+    }
+
+    if (m_rebuildingPipelines && m_pipelineCounter.IsDone())
+    {
+        GfxPipelineStateManager::GetInstance().SwapRebuiltPipelines(frameCount);
+        m_rebuildingPipelines = 0;
+    }
+
+    if (m_builder.joinable())
+    {
+        if (!m_buildDone.load(std::memory_order_acquire))
+            return;
+        FinishBuild();
+    }
+
+    // modules are only swapped once the previous pipeline rebuilds are done with them
+    if (!m_pendingKeys.empty() && !m_rebuildingPipelines && std::chrono::steady_clock::now() - m_lastChange >= c_settleTime)
+        StartBuild();
+}
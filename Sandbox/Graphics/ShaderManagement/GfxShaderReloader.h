@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Shared/ShaderIncludes.h"
+#include "Includes/Defines.h"
+#include "Engine/FileWatcher.h"
+#include "Engine/JobSystem.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+
+// hot reload of shader sources while the engine runs
+// a saved file reruns ShaderBuilder --hot-reload on a thread of its own, its cache only recompiles the permutations
+// whose source changed. the permutations built from the file (per ShaderBuilder's depfile) then get new modules and
+// the pipelines using them are rebuilt on the job system, frames keep drawing with the old pipelines until the new
+// ones are swapped in and nothing waits for the device
+// ShaderBuilder refuses changes to the interface in ShaderData.h (bindings, blocks, permutations), those need a restart
+class GfxShaderReloader
+{
+    DefaultSingleton(GfxShaderReloader);
+private:
+    // relative to the working directory like GfxShaderManager's output folder, the same folders the pre-build uses
+    static constexpr const char* c_sourceFolder = "../Shaders/";
+    static constexpr const char* c_intermediateFolder = "../Bin/Build/Shaders/";
+    static constexpr const char* c_depFile = "ShaderDeps.d";
+#ifdef _WIN32
+    static constexpr const char* c_shaderBuilder = "../Bin/exe/x64/ShaderBuilder.exe";
+#else
+    static constexpr const char* c_shaderBuilder = "../Bin/exe/x64/ShaderBuilder";
+#endif
+    // editors tend to save in several steps, the build starts once the files were left alone for this long
+    static constexpr std::chrono::milliseconds c_settleTime{ 200 };
+
+    FileWatcher m_watcher;
+    // source file -> permutations built from it
+    std::map<std::filesystem::path, std::vector<ShaderKey>> m_dependents;
+
+    std::set<ShaderKey> m_pendingKeys;
+    // from builds that failed, their .spv files may have changed anyway so they go along with the next build
+    std::set<ShaderKey> m_retryKeys;
+    std::chrono::steady_clock::time_point m_lastChange;
+
+    std::thread m_builder;
+    std::atomic<bool> m_buildDone{ false };
+    int m_buildResult = 0;
+    std::vector<ShaderKey> m_buildingKeys;
+
+    JobCounter m_pipelineCounter;
+    uint32_t m_rebuildingPipelines = 0;
+
+    // reads ShaderBuilder's depfile into m_dependents
+    void LoadDependencies();
+    void StartBuild();
+    void FinishBuild();
+public:
+    // false if the shader sources can't be watched
+    bool Init();
+    // waits for a running build and pipeline rebuilds
+    void CleanUp();
+
+    // render thread, before GraphicEngine::StartFrame. frameCount retires the pipelines that were replaced
+    void Update(uint64_t frameCount);
+};
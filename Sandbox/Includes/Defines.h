@@ -3,10 +3,13 @@
 #include <cassert>
 #include <cstdio>
 #include <stdint.h>
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include <tracy/public/tracy/Tracy.hpp>
 #include <vulkan/vulkan.h>
 #include <tracy/public/tracy/TracyVulkan.hpp>
+#include "Logger.h"
 
 #define DefaultSingleton(ClassName) \
 private:\
@@ -40,29 +43,23 @@ enum MessageSeverity
 #define UNUSED_PARAM(t) ((void)t)
 
 
-#ifdef NDEBUG
-const uint32_t g_messageLevel = None;
+// messages above this level are compiled out
+#if defined(LOG_LEVEL)
+constexpr uint32_t g_messageLevel = LOG_LEVEL;
+#elif defined(NDEBUG)
+constexpr uint32_t g_messageLevel = None;
 #else
-const uint32_t g_messageLevel = Verbose;
+constexpr uint32_t g_messageLevel = Verbose;
 #endif
 
-template<typename... Args>
-void Log(const char* t, uint32_t logLevel, [[maybe_unused]] Args... args)
+// queues the message for the logger thread, see Logger
+template<uint32_t Level, typename... Args>
+void Log([[maybe_unused]] const char* t, [[maybe_unused]] Args... args)
 {
-#ifndef NDEBUG
-    if (logLevel <= g_messageLevel)
+    if constexpr (Level != None && Level <= g_messageLevel)
     {
-        char temp[2048];
-        sprintf_s(temp, t, args...);
-        printf(temp);
-        OutputDebugStringA(temp);
-
+        Logger::Write(Level, t, args...);
     }
-#else
-    UNUSED_PARAM(t);
-    UNUSED_PARAM(logLevel);
-#endif
-
 }
 
 #ifdef NDEBUG
@@ -76,7 +73,7 @@ expression
 template<typename... Args>
 void DebugLog(const char* t, Args... args)
 {
-    Log(t, Debug, args...);
+    Log<Debug>(t, args...);
 }
 
 #ifdef PROFILE
@@ -87,8 +84,12 @@ void DebugLog(const char* t, Args... args)
 #define CPU_ProfileZone(ProfileTag) ZoneScopedN(#ProfileTag);
 #define CPU_ProfileZone_Color(ProfileTag, Color) ZoneScopedNC(#ProfileTag, Color);
 
-#define GPU_ProfileZone(ProfileTag) TracyVkZone(GraphicEngine::GetInstance().GetProfileContext(), GraphicEngine::GetInstance().GetCurrentCommandBuffer(), #ProfileTag);
-#define GPU_ProfileZone_Color(ProfileTag, Color) TracyVkZoneC(GraphicEngine::GetInstance().GetProfileContext(), GraphicEngine::GetInstance().GetCurrentCommandBuffer(), #ProfileTag, Color);
+#define GPU_ProfileZone(ProfileTag) TracyVkZone(GraphicEngine::GetInstance().GetProfileContext(), GraphicEngine::GetInstance().GetCurrentCommandBuffer(), #ProfileTag); GfxGpuProfileScope ProfileTag##_GpuScope(#ProfileTag);
+#define GPU_ProfileZone_Color(ProfileTag, Color) TracyVkZoneC(GraphicEngine::GetInstance().GetProfileContext(), GraphicEngine::GetInstance().GetCurrentCommandBuffer(), #ProfileTag, Color); GfxGpuProfileScope ProfileTag##_GpuScope(#ProfileTag);
+
+// fibers have to be named with a pointer that stays valid, needs TRACY_FIBERS
+#define Fiber_ProfileEnter(Name) TracyFiberEnter(Name);
+#define Fiber_ProfileLeave TracyFiberLeave;
 
 void* operator new(std::size_t count);
 void operator delete(void* ptr) noexcept;
@@ -98,6 +99,9 @@ void operator delete(void* ptr) noexcept;
 #define DeclareProfileMarker(Name)
 #define CPU_ProfileZone(ProfileTag)
 #define CPU_ProfileZone_Color(ProfileTag, Color)
-#define GPU_ProfileZone(ProfileTag)
-#define GPU_ProfileZone_Color(ProfileTag, Color)
+// the built in gpu profiler is always available, see GfxGpuProfiler
+#define GPU_ProfileZone(ProfileTag) GfxGpuProfileScope ProfileTag##_GpuScope(#ProfileTag);
+#define GPU_ProfileZone_Color(ProfileTag, Color) GfxGpuProfileScope ProfileTag##_GpuScope(#ProfileTag);
+#define Fiber_ProfileEnter(Name)
+#define Fiber_ProfileLeave
 #endif
@@ -0,0 +1,213 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+// lock free asynchronous logger
+// every thread that logs claims a single producer ring buffer, the logger thread is the only consumer
+// callers only copy the format string pointer and the raw argument bytes (strings are copied), formatting
+// and writing the output happens on the logger thread
+// messages from one thread stay in order, messages from different threads can interleave in any order
+class Logger
+{
+public:
+    // receives formatted, null terminated lines on the logger thread
+    using Sink = void(*)(const char* text, uint32_t length, uint32_t level);
+    using DecodeFunc = uint32_t(*)(const char* fmt, const uint8_t* args, char* out, uint32_t outSize);
+
+    static const uint32_t c_maxLineLength = 2048;
+    static const uint32_t c_maxStringLength = c_maxLineLength - 1;
+
+    struct MessageHeader
+    {
+        // null for padding at the end of the ring
+        DecodeFunc decode;
+        const char* fmt;
+        uint32_t level;
+        // whole record including the header
+        uint32_t size;
+    };
+
+    class Ring
+    {
+    public:
+        static const uint32_t c_capacity = 1 << 16;
+        // larger messages are written synchronously so a single record never blocks the ring
+        static const uint32_t c_maxMessageSize = c_capacity / 4;
+
+        std::atomic<bool> m_claimed{ false };
+
+        // producer side
+        alignas(64) std::atomic<uint64_t> m_head{ 0 };
+        uint64_t m_cachedTail = 0;
+        uint64_t m_reserved = 0;
+
+        // consumer side
+        alignas(64) std::atomic<uint64_t> m_tail{ 0 };
+
+        alignas(64) uint8_t m_data[c_capacity];
+
+        // returns nullptr if the consumer has not freed enough space yet
+        uint8_t* Reserve(uint32_t size)
+        {
+            uint64_t head = m_head.load(std::memory_order_relaxed);
+            uint32_t pos = uint32_t(head % c_capacity);
+            uint32_t contiguous = c_capacity - pos;
+            // records never wrap, the end of the ring is skipped instead
+            uint64_t needed = size <= contiguous ? size : uint64_t(contiguous) + size;
+
+            if (head + needed - m_cachedTail > c_capacity)
+            {
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                if (head + needed - m_cachedTail > c_capacity)
+                    return nullptr;
+            }
+
+            m_reserved = needed;
+            if (size <= contiguous)
+                return m_data + pos;
+
+            // too small for a header, the consumer skips it implicitly
+            if (contiguous >= sizeof(MessageHeader))
+            {
+                MessageHeader padding{ nullptr, nullptr, 0, contiguous };
+                memcpy(m_data + pos, &padding, sizeof(padding));
+            }
+            return m_data;
+        }
+
+        void Commit()
+        {
+            m_head.store(m_head.load(std::memory_order_relaxed) + m_reserved, std::memory_order_release);
+        }
+    };
+
+private:
+    static const uint32_t c_maxRings = 64;
+
+    inline static std::atomic<Ring*> ms_rings[c_maxRings] = {};
+    inline static std::atomic<bool> ms_running{ false };
+    inline static std::atomic<Sink> ms_sink{ nullptr };
+    inline static std::thread ms_thread;
+
+    // claims a ring for the calling thread on first use, nullptr if every ring is taken
+    static Ring* GetThreadRing();
+    static void WriteSync(const char* text, uint32_t length, uint32_t level);
+    static void ThreadMain();
+    // returns true if anything was written
+    static bool Drain(Ring& ring, char* buffer);
+
+    template<typename T>
+    static constexpr bool IsString = std::is_same_v<T, const char*> || std::is_same_v<T, char*>;
+
+    static uint32_t StringLength(const char* str)
+    {
+        return str ? uint32_t(std::min<size_t>(strlen(str), c_maxStringLength)) : 0;
+    }
+
+    template<typename T>
+    static uint32_t PackedSize(const T& value)
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_pointer_v<T> || std::is_enum_v<T>, "Log arguments must be printf compatible, pass strings as c strings");
+        if constexpr (IsString<T>)
+            return uint32_t(sizeof(uint32_t)) + StringLength(value) + 1;
+        else
+            return uint32_t(sizeof(T));
+    }
+
+    template<typename T>
+    static uint8_t* Pack(uint8_t* dst, const T& value)
+    {
+        if constexpr (IsString<T>)
+        {
+            uint32_t length = StringLength(value);
+            memcpy(dst, &length, sizeof(length));
+            if (length)
+                memcpy(dst + sizeof(length), value, length);
+            dst[sizeof(length) + length] = '\0';
+            return dst + sizeof(length) + length + 1;
+        }
+        else
+        {
+            memcpy(dst, &value, sizeof(T));
+            return dst + sizeof(T);
+        }
+    }
+
+    template<typename T>
+    static auto Unpack(const uint8_t*& src)
+    {
+        if constexpr (IsString<T>)
+        {
+            uint32_t length;
+            memcpy(&length, src, sizeof(length));
+            const char* str = reinterpret_cast<const char*>(src + sizeof(length));
+            src += sizeof(length) + length + 1;
+            return str;
+        }
+        else
+        {
+            T value;
+            memcpy(&value, src, sizeof(T));
+            src += sizeof(T);
+            return value;
+        }
+    }
+
+    template<typename... Args>
+    static uint32_t Decode(const char* fmt, [[maybe_unused]] const uint8_t* args, char* out, uint32_t outSize)
+    {
+        // braced initialisation unpacks the arguments in order
+        std::tuple<decltype(Unpack<Args>(args))...> values{ Unpack<Args>(args)... };
+        int length = std::apply([&](auto... unpacked) { return snprintf(out, outSize, fmt, unpacked...); }, values);
+        return length < 0 ? 0 : std::min(uint32_t(length), outSize - 1);
+    }
+
+public:
+    // starts the logger thread, messages before Start and after Stop are written synchronously
+    static void Start();
+    // writes everything still queued and joins the logger thread
+    static void Stop();
+    // blocks until everything logged before the call has been written
+    static void Flush();
+
+    // null restores the default of stdout (and the debugger output on windows)
+    static void SetSink(Sink sink);
+
+    template<typename... Args>
+    static void Write(uint32_t level, const char* fmt, Args... args)
+    {
+        uint32_t size = uint32_t(sizeof(MessageHeader)) + (0 + ... + PackedSize(args));
+        // keep headers aligned
+        size = (size + 7) & ~7u;
+
+        Ring* ring = nullptr;
+        if (size <= Ring::c_maxMessageSize && ms_running.load(std::memory_order_relaxed))
+            ring = GetThreadRing();
+
+        if (!ring)
+        {
+            char buffer[c_maxLineLength];
+            int length = snprintf(buffer, sizeof(buffer), fmt, args...);
+            WriteSync(buffer, length < 0 ? 0 : std::min(uint32_t(length), c_maxLineLength - 1), level);
+            return;
+        }
+
+        uint8_t* dst;
+        while (!(dst = ring->Reserve(size)))
+        {
+            std::this_thread::yield();
+        }
+
+        MessageHeader header{ &Decode<std::decay_t<Args>...>, fmt, level, size };
+        memcpy(dst, &header, sizeof(header));
+        [[maybe_unused]] uint8_t* cursor = dst + sizeof(header);
+        ((cursor = Pack(cursor, args)), ...);
+        ring->Commit();
+    }
+};
@@ -0,0 +1,274 @@
+#include "ProcessPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstring>
+
+extern char** environ;
+#endif
+
+namespace
+{
+  // handles/fds created for one child must not leak into another child spawned at the same time, otherwise
+  // that child keeps the pipe open and the reader never sees the end of it
+  std::mutex g_spawnMutex;
+
+#ifdef _WIN32
+  // windows command line quoting, backslashes are only special in front of a quote
+  void AppendQuoted(std::wstring& commandLine, const std::wstring& arg)
+  {
+    if (!commandLine.empty())
+      commandLine += L' ';
+    if (!arg.empty() && arg.find_first_of(L" \t\"") == std::wstring::npos)
+    {
+      commandLine += arg;
+      return;
+    }
+    commandLine += L'"';
+    size_t backslashes = 0;
+    for (wchar_t c : arg)
+    {
+      if (c == L'\\')
+      {
+        ++backslashes;
+        continue;
+      }
+      if (c == L'"')
+        commandLine.append(backslashes * 2 + 1, L'\\');
+      else
+        commandLine.append(backslashes, L'\\');
+      backslashes = 0;
+      commandLine += c;
+    }
+    commandLine.append(backslashes * 2, L'\\');
+    commandLine += L'"';
+  }
+#endif
+}
+
+ProcessPool::ProcessPool(size_t maxProcesses)
+{
+  if (!maxProcesses)
+    maxProcesses = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < maxProcesses; ++i)
+  {
+    m_workers.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+ProcessPool::~ProcessPool()
+{
+  WaitAll();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_exit = true;
+  }
+  m_jobAdded.notify_all();
+  for (auto& worker : m_workers)
+  {
+    worker.join();
+  }
+}
+
+void ProcessPool::Run(std::wstring program, std::vector<std::wstring> args, Callback onComplete)
+{
+  Run([program = std::move(program), args = std::move(args)]() { return Execute(program, args); }, std::move(onComplete));
+}
+
+void ProcessPool::Run(Task task, Callback onComplete)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back({ std::move(task), std::move(onComplete) });
+  }
+  m_jobAdded.notify_one();
+}
+
+size_t ProcessPool::WaitAll()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_jobsDone.wait(lock, [this]() { return m_jobs.empty() && m_running == 0; });
+  size_t failures = m_failures;
+  m_failures = 0;
+  return failures;
+}
+
+void ProcessPool::WorkerLoop()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true)
+  {
+    m_jobAdded.wait(lock, [this]() { return m_exit || !m_jobs.empty(); });
+    if (m_jobs.empty())
+      return;
+
+    Job job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    ++m_running;
+    lock.unlock();
+
+    auto start = std::chrono::steady_clock::now();
+    Result result = { -1, {}, 0.0 };
+    // an exception would end the worker thread and with it the program, report the task as failed instead
+    try
+    {
+      result = job.task();
+    }
+    catch (const std::exception& e)
+    {
+      result.output = std::string("task failed: ") + e.what() + "\n";
+    }
+    catch (...)
+    {
+      result.output = "task failed with an unknown exception\n";
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (job.onComplete)
+    {
+      std::lock_guard<std::mutex> callbackLock(m_callbackMutex);
+      job.onComplete(result);
+    }
+
+    lock.lock();
+    if (result.exitCode)
+      ++m_failures;
+    --m_running;
+    if (m_jobs.empty() && m_running == 0)
+      m_jobsDone.notify_all();
+  }
+}
+
+#ifdef _WIN32
+ProcessPool::Result ProcessPool::Execute(const std::wstring& program, const std::vector<std::wstring>& args)
+{
+  std::wstring commandLine;
+  AppendQuoted(commandLine, program);
+  for (auto& arg : args)
+  {
+    AppendQuoted(commandLine, arg);
+  }
+
+  HANDLE readPipe = nullptr;
+  HANDLE writePipe = nullptr;
+  PROCESS_INFORMATION pi = {};
+  BOOL created = FALSE;
+  {
+    std::lock_guard<std::mutex> lock(g_spawnMutex);
+    SECURITY_ATTRIBUTES sa = { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+    if (!CreatePipe(&readPipe, &writePipe, &sa, 0))
+      return { -1, "CreatePipe failed (" + std::to_string(GetLastError()) + ")\n", 0.0 };
+    SetHandleInformation(readPipe, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFOW si = {};
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdOutput = writePipe;
+    si.hStdError = writePipe;
+
+    // a program without a directory is searched for in PATH when the application name is null
+    created = CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi);
+    // the child has its own copy now, the read below ends once the child closes it
+    CloseHandle(writePipe);
+  }
+  if (!created)
+  {
+    DWORD error = GetLastError();
+    CloseHandle(readPipe);
+    return { -1, "CreateProcess failed (" + std::to_string(error) + ")\n", 0.0 };
+  }
+
+  Result result = { 0, {}, 0.0 };
+  char buffer[4096];
+  DWORD bytesRead = 0;
+  while (ReadFile(readPipe, buffer, sizeof(buffer), &bytesRead, nullptr) && bytesRead)
+  {
+    result.output.append(buffer, bytesRead);
+  }
+  CloseHandle(readPipe);
+
+  WaitForSingleObject(pi.hProcess, INFINITE);
+  DWORD exitCode = 0;
+  GetExitCodeProcess(pi.hProcess, &exitCode);
+  result.exitCode = int(exitCode);
+  CloseHandle(pi.hProcess);
+  CloseHandle(pi.hThread);
+  return result;
+}
+#else
+ProcessPool::Result ProcessPool::Execute(const std::wstring& program, const std::vector<std::wstring>& args)
+{
+  std::vector<std::string> narrowArgs;
+  narrowArgs.push_back(std::filesystem::path(program).string());
+  for (auto& arg : args)
+  {
+    narrowArgs.push_back(std::filesystem::path(arg).string());
+  }
+  std::vector<char*> argv;
+  for (auto& arg : narrowArgs)
+  {
+    argv.push_back(arg.data());
+  }
+  argv.push_back(nullptr);
+
+  int pipeFds[2];
+  pid_t pid = 0;
+  int spawnError = 0;
+  {
+    std::lock_guard<std::mutex> lock(g_spawnMutex);
+    if (pipe(pipeFds) != 0)
+      return { -1, std::string("pipe failed: ") + strerror(errno) + "\n", 0.0 };
+    fcntl(pipeFds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipeFds[1], F_SETFD, FD_CLOEXEC);
+
+    // dup2 clears close on exec on the child's stdout/stderr only
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDERR_FILENO);
+    spawnError = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipeFds[1]);
+  }
+  if (spawnError)
+  {
+    close(pipeFds[0]);
+    return { -1, "posix_spawn " + narrowArgs[0] + " failed: " + strerror(spawnError) + "\n", 0.0 };
+  }
+
+  Result result = { 0, {}, 0.0 };
+  char buffer[4096];
+  while (true)
+  {
+    ssize_t bytesRead = read(pipeFds[0], buffer, sizeof(buffer));
+    if (bytesRead < 0 && errno == EINTR)
+      continue;
+    if (bytesRead <= 0)
+      break;
+    result.output.append(buffer, size_t(bytesRead));
+  }
+  close(pipeFds[0]);
+
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+  {
+  }
+  if (WIFEXITED(status))
+    result.exitCode = WEXITSTATUS(status);
+  else
+    result.exitCode = -1;
+  return result;
+}
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// runs external processes (or in process work) with at most a fixed number alive at once
+// every process gets its stdout and stderr captured into one buffer, which is handed to the completion callback
+// once the process has exited so output of different processes never interleaves
+// waiting blocks on the process (WaitForSingleObject / waitpid) instead of polling
+class ProcessPool
+{
+public:
+  struct Result
+  {
+    int exitCode;
+    // stdout and stderr in the order the process wrote them
+    std::string output;
+    // wall time from starting the job to it finishing, set by the pool
+    double seconds;
+  };
+  using Callback = std::function<void(const Result&)>;
+  using Task = std::function<Result()>;
+
+  // 0 uses the hardware concurrency
+  explicit ProcessPool(size_t maxProcesses = 0);
+  ~ProcessPool();
+
+  ProcessPool(const ProcessPool&) = delete;
+  ProcessPool& operator=(const ProcessPool&) = delete;
+
+  // program is searched for in PATH if it has no directory. onComplete runs on a pool thread, calls are serialised
+  void Run(std::wstring program, std::vector<std::wstring> args, Callback onComplete = {});
+  // runs task on a pool thread in place of a process, it has to be safe to run concurrently with other tasks
+  // a task that throws counts as failed with the exception's message as its output
+  void Run(Task task, Callback onComplete = {});
+  // blocks until every queued process has finished, returns how many exited with a non zero code (or failed to start)
+  size_t WaitAll();
+
+  size_t GetMaxProcesses() const { return m_workers.size(); }
+
+  // runs program on the calling thread and waits for it, for tasks that do more than start a process
+  static Result Execute(const std::wstring& program, const std::vector<std::wstring>& args);
+
+private:
+  struct Job
+  {
+    Task task;
+    Callback onComplete;
+  };
+
+  std::vector<std::thread> m_workers;
+  std::deque<Job> m_jobs;
+  std::mutex m_mutex;
+  std::condition_variable m_jobAdded;
+  std::condition_variable m_jobsDone;
+  size_t m_running = 0;
+  size_t m_failures = 0;
+  bool m_exit = false;
+
+  // serialises callbacks
+  std::mutex m_callbackMutex;
+
+  void WorkerLoop();
+};
@@ -1,4 +1,5 @@
 #include "ShaderBuilder.h"
+#include "ShaderArchive.h"
 #include <iostream>
 #include <filesystem>
 #include <fstream>
@@ -7,8 +8,22 @@
 #include <unordered_map>
 #include <cassert>
 #include <memory>
-#include <windows.h>
 #include <cwctype>
+#include <cwchar>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vulkan/vk_enum_string_helper.h>
+
+#ifdef SHADERBUILDER_USE_SHADERC
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <link.h>
+#include <cstring>
+#endif
+#endif
 
 std::string wstringToString(std::wstring str)
 {
@@ -20,40 +35,384 @@ std::string wstringToString(std::wstring str)
     return ret;
 }
 
-size_t ShaderBuilder::CreateCompilationProcess(ShaderConfigInfoMapType::value_type& input, std::wstring intermediateFolder, std::wstring outputFolder, std::wstring shaderName)
+std::wstring stringToWstring(const std::string& str)
+{
+    return std::wstring(str.begin(), str.end());
+}
+
+bool ReadSpirvFile(const std::filesystem::path& path, std::vector<uint32_t>& words)
+{
+    std::ifstream spv(path, std::ios_base::binary | std::ios_base::ate);
+    if (!spv.is_open())
+        return false;
+    words.resize(size_t(spv.tellg()) / sizeof(uint32_t));
+    spv.seekg(0);
+    spv.read(reinterpret_cast<char*>(words.data()), std::streamsize(words.size() * sizeof(uint32_t)));
+    return bool(spv);
+}
+
+#ifdef SHADERBUILDER_USE_SHADERC
+const shaderc_shader_kind ShaderTypeToShadercKind[3] =
+{
+    shaderc_vertex_shader,
+    shaderc_fragment_shader,
+    shaderc_compute_shader
+};
+
+// file shaderc was loaded from, the shared library or this executable when it is linked in statically
+std::filesystem::path GetShadercModulePath()
+{
+#ifdef _WIN32
+    HMODULE module = GetModuleHandleW(L"shaderc_shared.dll");
+    wchar_t path[MAX_PATH];
+    DWORD length = GetModuleFileNameW(module, path, MAX_PATH);
+    if (!length || length == MAX_PATH)
+        return {};
+    return std::filesystem::path(std::wstring(path, length));
+#else
+    std::filesystem::path path;
+    dl_iterate_phdr([](dl_phdr_info* info, size_t, void* data)
+        {
+            if (!info->dlpi_name || !strstr(info->dlpi_name, "libshaderc"))
+                return 0;
+            *static_cast<std::filesystem::path*>(data) = info->dlpi_name;
+            return 1;
+        }, &path);
+    if (path.empty())
+    {
+        std::error_code error;
+        path = std::filesystem::read_symlink("/proc/self/exe", error);
+    }
+    return path;
+#endif
+}
+#endif
+
+
+std::wstring ShaderBuilder::GetCompilerPath()
+{
+#ifdef _WIN32
+    return L"../External/vulkan/glslc.exe";
+#else
+    // from the vulkan sdk / distro package
+    return L"glslc";
+#endif
+}
+
+std::vector<std::wstring> ShaderBuilder::GetOptimizationArgs() const
+{
+    std::vector<std::wstring> args;
+    switch (m_optimization)
+    {
+    case Optimization::None: args.push_back(L"-O0"); break;
+    case Optimization::Performance: args.push_back(L"-O"); break;
+    case Optimization::Size: args.push_back(L"-Os"); break;
+    }
+    args.push_back(L"-g");
+    return args;
+}
+
+std::string ShaderBuilder::FinishSpirv(std::vector<uint32_t>& words, ShaderKey key, const std::wstring& reflectionPath, const std::wstring& spvPath)
 {
+    SpirvReflection reflection;
+    std::string error;
+    if (!ReflectSpirv(words, reflection, error))
+        return std::filesystem::path(spvPath).filename().string() + ": " + error + "\n";
+    if (!reflectionPath.empty())
+    {
+        std::ofstream fs(std::filesystem::path(reflectionPath), std::ios_base::trunc);
+        fs << SerializeSpirvReflection(reflection);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        m_reflections[key] = std::move(reflection);
+    }
+
+    if (!m_debugInfo)
+        StripSpirvDebugInfo(words);
+    // a running engine (--hot-reload) can load the .spv at any time, it only ever sees the old or the new file
+    const std::filesystem::path tempPath = GetTempSpirvPath(spvPath);
+    {
+        std::ofstream spv(tempPath, std::ios_base::binary | std::ios_base::trunc);
+        spv.write(reinterpret_cast<const char*>(words.data()), std::streamsize(words.size() * sizeof(uint32_t)));
+        if (!spv)
+            return "cannot write " + tempPath.string() + "\n";
+    }
+    std::error_code renameError;
+    // windows refuses to replace a file while it is being read, which is only ever for a moment
+    for (uint32_t attempt = 0; attempt < 10; ++attempt)
+    {
+        std::filesystem::rename(tempPath, std::filesystem::path(spvPath), renameError);
+        if (!renameError)
+            return {};
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::filesystem::remove(tempPath, renameError);
+    return "cannot replace " + std::filesystem::path(spvPath).string() + "\n";
+}
+
+std::wstring ShaderBuilder::GetTempSpirvPath(const std::wstring& spvPath)
+{
+    return spvPath + L".tmp";
+}
+
+void ShaderBuilder::QueryCompilerVersion()
+{
+    m_compilerVersion.clear();
+#ifdef SHADERBUILDER_USE_SHADERC
+    // shaderc has no version query of its own (shaderc_get_spv_version is the SPIR-V version it targets), so the
+    // binary it was loaded from stands in for it. upgrading shaderc or glslang changes it and rebuilds everything
+    std::ifstream library(GetShadercModulePath(), std::ios_base::binary);
+    if (!library.is_open())
+    {
+        std::cout << "Warning: could not find the shaderc library, rebuilding everything\n";
+        return;
+    }
+    uint64_t hash = ShaderContentHash(nullptr, 0);
+    char buffer[64 * 1024];
+    while (library.read(buffer, sizeof(buffer)) || library.gcount())
+    {
+        hash = ShaderContentHash(buffer, size_t(library.gcount()), hash);
+    }
+    unsigned int version = 0;
+    unsigned int revision = 0;
+    shaderc_get_spv_version(&version, &revision);
+    std::ostringstream id;
+    id << "shaderc " << std::hex << hash << " spirv " << std::dec << version << "." << revision;
+    m_compilerVersion = id.str();
+    return;
+#endif
+    m_compilePool.Run(GetCompilerPath(), { L"--version" }, [this](const ProcessPool::Result& result)
+        {
+            if (!result.exitCode)
+                m_compilerVersion = result.output;
+        });
+    m_compilePool.WaitAll();
+    if (m_compilerVersion.empty())
+        std::cout << "Warning: could not get the compiler version, rebuilding everything\n";
+}
+
+void ShaderBuilder::LoadCache(const std::wstring& intermediateFolder)
+{
+    m_previousCache.clear();
+    m_cache.clear();
+    // without a version there is nothing to tell a different compiler's output apart
+    if (intermediateFolder.empty() || m_compilerVersion.empty())
+        return;
+
+    std::wifstream fs(std::filesystem::path(intermediateFolder + c_cacheFile));
+    std::wstring name;
+    uint64_t hash = 0;
+    while (fs >> name >> std::hex >> hash)
+    {
+        m_previousCache[name] = hash;
+    }
+}
+
+void ShaderBuilder::SaveCache(const std::wstring& intermediateFolder)
+{
+    if (intermediateFolder.empty())
+        return;
+
+    std::wofstream fs(std::filesystem::path(intermediateFolder + c_cacheFile), std::ios_base::trunc);
+    for (auto& itr : m_cache)
+    {
+        fs << itr.first << L" " << std::hex << itr.second << L"\n";
+    }
+}
+
+size_t ShaderBuilder::CreateCompilationProcess(ShaderConfigInfoMapType::value_type& input, std::wstring intermediateFolder, std::wstring outputFolder, std::wstring shaderName, const std::wstring& source, ShaderKey key)
+{
+    const std::wstring spvPath = outputFolder + shaderName + L".spv";
+    m_outputs[m_currentShader].push_back(spvPath);
+    m_archiveEntries.push_back({ key, spvPath });
+
+    uint64_t hash = ShaderContentHash(m_compilerVersion.data(), m_compilerVersion.size());
+    hash = ShaderContentHash(ShaderTypeToCharLong[int(input.first)], wcslen(ShaderTypeToCharLong[int(input.first)]) * sizeof(wchar_t), hash);
+    hash = ShaderContentHash(input.second.entryPoint.data(), (input.second.entryPoint.size() + 1) * sizeof(wchar_t), hash);
+    for (const std::wstring& arg : GetOptimizationArgs())
+    {
+        hash = ShaderContentHash(arg.data(), (arg.size() + 1) * sizeof(wchar_t), hash);
+    }
+    hash = ShaderContentHash(&m_debugInfo, sizeof(m_debugInfo), hash);
+    // the defines are part of the permutation source
+    hash = ShaderContentHash(source.data(), source.size() * sizeof(wchar_t), hash);
+
+    // without an intermediate folder there is no cache to keep the reflection for
+    const std::wstring reflectionPath = intermediateFolder.empty() ? std::wstring() : intermediateFolder + shaderName + c_reflectionExtension;
+    auto cached = m_previousCache.find(shaderName);
+    if (cached != m_previousCache.end() && cached->second == hash && std::filesystem::exists(spvPath))
+    {
+        std::ifstream reflectionFile{ std::filesystem::path(reflectionPath) };
+        std::stringstream reflectionText;
+        reflectionText << reflectionFile.rdbuf();
+        SpirvReflection reflection;
+        if (reflectionFile.is_open() && ParseSpirvReflection(reflectionText.str(), reflection))
+        {
+            std::lock_guard<std::mutex> lock(m_cacheMutex);
+            m_cache[shaderName] = hash;
+            m_reflections[key] = std::move(reflection);
+            ++m_upToDateCount;
+            return 0;
+        }
+    }
+
+    // output is printed in one go once the compilation is done so errors of different permutations don't interleave
+    std::string permutation = wstringToString(shaderName);
+    ++m_compiledCount;
+    auto onComplete = [this, permutation, shaderName, hash, spvPath](const ProcessPool::Result& result)
+        {
+            std::string message = result.output;
+            if (result.exitCode)
+            {
+                message += permutation + " failed (" + std::to_string(result.exitCode) + ")\n";
+                // the compiler leaves the output of an earlier build in place, it must not be packed or reported
+                std::error_code error;
+                std::filesystem::remove(std::filesystem::path(spvPath), error);
+                std::filesystem::remove(std::filesystem::path(GetTempSpirvPath(spvPath)), error);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(m_cacheMutex);
+                m_cache[shaderName] = hash;
+            }
+            // callbacks are serialised by the pool
+            m_timings.push_back({ permutation, result.seconds });
+            std::cout << message << std::flush;
+        };
+
+#ifdef SHADERBUILDER_USE_SHADERC
+    // the source never touches the disk, shaderc's compiler can be used from several threads at once
+    m_compilePool.Run([this, source = wstringToString(source), kind = ShaderTypeToShadercKind[int(input.first)],
+        entryPoint = wstringToString(input.second.entryPoint), permutation, spvPath, reflectionPath, key]()
+        {
+            shaderc::CompileOptions options;
+            options.SetForcedVersionProfile(450, shaderc_profile_none);
+            switch (m_optimization)
+            {
+            case Optimization::None: options.SetOptimizationLevel(shaderc_optimization_level_zero); break;
+            case Optimization::Performance: options.SetOptimizationLevel(shaderc_optimization_level_performance); break;
+            case Optimization::Size: options.SetOptimizationLevel(shaderc_optimization_level_size); break;
+            }
+            options.SetGenerateDebugInfo();
+            shaderc::SpvCompilationResult result = m_compiler.CompileGlslToSpv(source, kind, permutation.c_str(), entryPoint.c_str(), options);
+            if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+                return ProcessPool::Result{ 1, result.GetErrorMessage(), 0.0 };
+
+            std::vector<uint32_t> words(result.cbegin(), result.cend());
+            std::string error = FinishSpirv(words, key, reflectionPath, spvPath);
+            return ProcessPool::Result{ error.empty() ? 0 : 1, result.GetErrorMessage() + error, 0.0 };
+        }, std::move(onComplete));
+    (void)intermediateFolder;
+#else
+    const std::wstring permPath = intermediateFolder + shaderName + L".perm";
+    if (!intermediateFolder.empty())
+    {
+        std::wfstream outputFile;
+        outputFile.open(std::filesystem::path(permPath), std::ios_base::out | std::ios_base::trunc);
+        assert(outputFile.is_open());
+        outputFile << source;
+        outputFile.close();
+    }
+
     // compile with generated file
-    std::wstring exe = L"../External/vulkan/glslc.exe";
-    std::wstring command = exe +
-        L" -std=450 -fshader-stage=" + ShaderTypeToCharLong[int(input.first)] + L" " +
-        L"-fentry-point=" + input.second.entryPoint + L" \"" +
-        intermediateFolder + shaderName + L".perm\" -o \"" +
-        outputFolder + shaderName + L".spv\"";
-    LPWSTR temp = new wchar_t[command.length()];
-    lstrcpyW(temp, command.c_str());
-
-    STARTUPINFO si = {};
-    PROCESS_INFORMATION pi = {};
+    std::vector<std::wstring> args = {
+        L"-std=450",
+        std::wstring(L"-fshader-stage=") + ShaderTypeToCharLong[int(input.first)],
+        L"-fentry-point=" + input.second.entryPoint
+    };
+    for (std::wstring& arg : GetOptimizationArgs())
+    {
+        args.push_back(std::move(arg));
+    }
+    // glslc writes next to the .spv, FinishSpirv moves the result into place
+    const std::wstring tempPath = GetTempSpirvPath(spvPath);
+    args.insert(args.end(), { permPath, L"-o", tempPath });
+    m_compilePool.Run([this, args = std::move(args), key, reflectionPath, spvPath, tempPath]()
+        {
+            ProcessPool::Result result = ProcessPool::Execute(GetCompilerPath(), args);
+            if (result.exitCode)
+                return result;
+            std::vector<uint32_t> words;
+            std::string error = ReadSpirvFile(tempPath, words) ? FinishSpirv(words, key, reflectionPath, spvPath) : "cannot read " + std::filesystem::path(tempPath).string() + "\n";
+            if (!error.empty())
+            {
+                result.exitCode = 1;
+                result.output += error;
+            }
+            return result;
+        }, std::move(onComplete));
+#endif
+    return 0;
+}
 
-    size_t ret = 0;
-    // Start the child process. 
-    if (!CreateProcess(exe.c_str(),
-        temp,        // Command line
-        NULL,           // Process handle not inheritable
-        NULL,           // Thread handle not inheritable
-        0,          // Set handle inheritance to FALSE
-        0,              // No creation flags
-        NULL,           // Use parent's environment block
-        NULL,           // Use parent's starting directory 
-        &si,            // Pointer to STARTUPINFO structure
-        &pi)           // Pointer to PROCESS_INFORMATION structure
-        )
-    {
-        printf("CreateProcess failed (%d).\n", GetLastError());
-        throw(std::runtime_error("CreateProcess failed.\n"));
-    }
-    m_processInfo.insert({ pi.hProcess, pi.hThread });
-    return ret;
+size_t ShaderBuilder::CountSpirvInstructions(const std::vector<uint32_t>& words)
+{
+    // 5 word header, then every instruction starts with its word count in the high 16 bits
+    const uint32_t spirvMagic = 0x07230203;
+    if (words.size() < 5 || words[0] != spirvMagic)
+        return 0;
+    size_t count = 0;
+    for (size_t word = 5; word < words.size(); word += words[word] >> 16)
+    {
+        // a zero word count would never advance, the module is broken
+        if (!(words[word] >> 16))
+            return 0;
+        ++count;
+    }
+    return count;
+}
+
+void ShaderBuilder::ReportPermutations(const std::wstring& intermediateFolder)
+{
+    std::sort(m_timings.begin(), m_timings.end(), [](const CompileTiming& a, const CompileTiming& b) { return a.seconds > b.seconds; });
+    std::unordered_map<std::string, double> seconds;
+    double totalSeconds = 0.0;
+    for (auto& timing : m_timings)
+    {
+        seconds[timing.permutation] = timing.seconds;
+        totalSeconds += timing.seconds;
+    }
+
+    std::ofstream fs;
+    if (!intermediateFolder.empty())
+    {
+        fs.open(std::filesystem::path(intermediateFolder + c_reportFile), std::ios_base::trunc);
+        // ms is left empty for permutations that were up to date
+        fs << "permutation,ms,bytes,instructions\n";
+    }
+    size_t totalBytes = 0;
+    size_t totalInstructions = 0;
+    for (auto& entry : m_archiveEntries)
+    {
+        std::vector<uint32_t> words;
+        if (!ReadSpirvFile(entry.spvPath, words))
+            continue;
+        const size_t bytes = words.size() * sizeof(uint32_t);
+        const size_t instructions = CountSpirvInstructions(words);
+        totalBytes += bytes;
+        totalInstructions += instructions;
+
+        const std::string permutation = std::filesystem::path(entry.spvPath).stem().string();
+        if (!fs.is_open())
+            continue;
+        fs << permutation << ",";
+        auto timing = seconds.find(permutation);
+        if (timing != seconds.end())
+            fs << timing->second * 1000.0;
+        fs << "," << bytes << "," << instructions << "\n";
+    }
+
+    const char* optimization[] = { "unoptimized", "optimized for performance", "optimized for size" };
+    std::cout << m_archiveEntries.size() << " permutations " << optimization[int(m_optimization)] << (m_debugInfo ? " with debug info, " : ", ")
+        << totalBytes / 1024 << "KB, " << totalInstructions << " instructions\n";
+    if (m_timings.empty())
+        return;
+    std::cout << "compile time " << int(totalSeconds * 1000.0) << "ms over " << m_timings.size() << " permutations, slowest:\n";
+    for (size_t i = 0; i < std::min<size_t>(m_timings.size(), 5); ++i)
+    {
+        std::cout << "  " << m_timings[i].permutation << " " << int(m_timings[i].seconds * 1000.0) << "ms\n";
+    }
 }
 
 void ShaderBuilder::ProcessConfigInfo(std::wstringstream& ss, std::wstring shaderName, ShaderBuilder::ShaderConfigInfoMapType& map)
@@ -63,6 +422,9 @@ void ShaderBuilder::ProcessConfigInfo(std::wstringstream& ss, std::wstring shade
     // shader name, entry point
     std::unordered_map<ShaderType, std::wstring> uniqueShaders;
     std::vector<std::wstring> defines;
+    std::vector<std::wstring> exclusiveGroups;
+    std::vector<std::wstring> requirements;
+    std::vector<std::wstring> explicitPermutations;
     std::wstring input;
     auto GetInputLambda = [this](std::wstringstream& ss, std::wstring& input)->HeaderType
     {
@@ -83,12 +445,30 @@ void ShaderBuilder::ProcessConfigInfo(std::wstringstream& ss, std::wstring shade
     {
         if (type != HeaderType::INVALID)
         {
-            if (type == HeaderType::DEFINES)
+            std::vector<std::wstring>* list = nullptr;
+            switch (type)
+            {
+            case ShaderBuilder::HeaderType::DEFINES:
+                list = &defines;
+                break;
+            case ShaderBuilder::HeaderType::EXCLUSIVE:
+                list = &exclusiveGroups;
+                break;
+            case ShaderBuilder::HeaderType::REQUIRES:
+                list = &requirements;
+                break;
+            case ShaderBuilder::HeaderType::PERMUTATIONS:
+                list = &explicitPermutations;
+                break;
+            default:
+                break;
+            }
+            if (list)
             {
                 type = GetInputLambda(ss, input);
                 while (type == HeaderType::INVALID)
                 {
-                    defines.push_back(input);
+                    list->push_back(input);
                     if (ss.eof())
                         break;
                     type = GetInputLambda(ss, input);
@@ -109,6 +489,8 @@ void ShaderBuilder::ProcessConfigInfo(std::wstringstream& ss, std::wstring shade
                 case ShaderBuilder::HeaderType::PS_ENTRY_POINT:
                     uniqueShader.first = ShaderType::PS;
                     break;
+                default:
+                    break;
                 }
 
                 type = GetInputLambda(ss, input);
@@ -129,12 +511,17 @@ void ShaderBuilder::ProcessConfigInfo(std::wstringstream& ss, std::wstring shade
         }
     } while (!ss.eof());
 
+    if (defines.size() > 32 - ShaderDefineBitshift)
+        throw std::runtime_error("too many defines");
+    std::vector<uint32_t> permutations = SelectPermutations(defines, exclusiveGroups, requirements, explicitPermutations);
+
     for (auto itr : uniqueShaders)
     {
         std::pair< ShaderType, ShaderConfigInfo> mapInput;
         mapInput.first = itr.first;
         mapInput.second.entryPoint = itr.second;
         mapInput.second.defines = defines;
+        mapInput.second.permutations = permutations;
         mapInput.second.shaderName = shaderName;
         mapInput.second.shaderNameHash = hasher(std::wstring(ShaderTypeToChar[int(itr.first)]) + L"_" + shaderName) & ShaderKeyMask;
         map.insert(mapInput);
@@ -157,6 +544,22 @@ ShaderBuilder::HeaderType ShaderBuilder::IsHeader(std::wstring input)
         {
             return HeaderType::PS_ENTRY_POINT;
         }
+        if (input.compare(L"Permutations:") == 0)
+        {
+            return HeaderType::PERMUTATIONS;
+        }
+        break;
+    case 'E':
+        if (input.compare(L"Exclusive:") == 0)
+        {
+            return HeaderType::EXCLUSIVE;
+        }
+        break;
+    case 'R':
+        if (input.compare(L"Requires:") == 0)
+        {
+            return HeaderType::REQUIRES;
+        }
         break;
     case 'V':
         if (input.compare(L"VS_Entry:") == 0)
@@ -174,28 +577,79 @@ ShaderBuilder::HeaderType ShaderBuilder::IsHeader(std::wstring input)
     return HeaderType::INVALID;
 }
 
-size_t ShaderBuilder::CompilePermutations(
-    ShaderConfigInfoMapType::value_type& input,
-    const std::wstring origFile,
-    std::wstring intermediateFolder,
-    std::wstring outputFolder,
-    std::wstring curPermutation,
-    size_t nextPermutation,
-    std::vector<std::wstring> defines)
+std::vector<uint32_t> ShaderBuilder::SelectPermutations(
+    const std::vector<std::wstring>& defines,
+    const std::vector<std::wstring>& exclusiveGroups,
+    const std::vector<std::wstring>& requirements,
+    const std::vector<std::wstring>& explicitPermutations)
 {
-    size_t ret = 0;
-    for (; nextPermutation < input.second.defines.size(); ++nextPermutation)
+    // names joined by separator -> define key bits
+    auto parseMask = [&defines](const std::wstring& names, wchar_t separator)
     {
-        defines.push_back(input.second.defines[nextPermutation]);
+        uint32_t mask = 0;
+        std::wstringstream ss{ names };
+        std::wstring name;
+        while (std::getline(ss, name, separator))
+        {
+            auto itr = std::find(defines.begin(), defines.end(), name);
+            if (itr == defines.end())
+                throw std::runtime_error("unknown define " + wstringToString(name) + " in " + wstringToString(names));
+            mask |= 1u << uint32_t(itr - defines.begin());
+        }
+        return mask;
+    };
 
-        std::wstring generatedFilename = GeneratePermutation(input, origFile, curPermutation, intermediateFolder, defines);
+    std::vector<uint32_t> exclusiveMasks;
+    for (auto& group : exclusiveGroups)
+    {
+        exclusiveMasks.push_back(parseMask(group, L'|'));
+    }
+    // define bit, bits it needs
+    std::vector<std::pair<uint32_t, uint32_t>> requiredMasks;
+    for (auto& requirement : requirements)
+    {
+        size_t arrow = requirement.find(L"->");
+        if (arrow == requirement.npos)
+            throw std::runtime_error("expected Define->Required, got " + wstringToString(requirement));
+        requiredMasks.push_back({ parseMask(requirement.substr(0, arrow), L'+'), parseMask(requirement.substr(arrow + 2), L'+') });
+    }
+    auto isValid = [&](uint32_t mask)
+    {
+        for (uint32_t exclusive : exclusiveMasks)
+        {
+            uint32_t set = mask & exclusive;
+            if (set & (set - 1))
+                return false;
+        }
+        for (auto& required : requiredMasks)
+        {
+            if ((mask & required.first) && (mask & required.second) != required.second)
+                return false;
+        }
+        return true;
+    };
 
-        ret |= CreateCompilationProcess(input, intermediateFolder, outputFolder, generatedFilename);
+    std::vector<uint32_t> permutations;
+    if (explicitPermutations.empty())
+    {
+        for (uint32_t mask = 0; mask < (1u << defines.size()); ++mask)
+        {
+            if (isValid(mask))
+                permutations.push_back(mask);
+        }
+        return permutations;
+    }
 
-        ret |= CompilePermutations(input, origFile, intermediateFolder, outputFolder, curPermutation, nextPermutation + 1, defines);
-        defines.pop_back();
+    for (auto& permutation : explicitPermutations)
+    {
+        uint32_t mask = permutation == L"None" ? 0 : parseMask(permutation, L'+');
+        if (!isValid(mask))
+            throw std::runtime_error("permutation " + wstringToString(permutation) + " breaks an Exclusive or Requires rule");
+        if (std::find(permutations.begin(), permutations.end(), mask) == permutations.end())
+            permutations.push_back(mask);
     }
-    return ret;
+    std::sort(permutations.begin(), permutations.end());
+    return permutations;
 }
 
 size_t ShaderBuilder::CompilePermutations(
@@ -204,21 +658,28 @@ size_t ShaderBuilder::CompilePermutations(
     std::wstring intermediateFolder,
     std::wstring outputFolder)
 {
-    std::vector<std::wstring> defines{ ShaderTypeToChar[int(input.first)] };
-
     std::wstring curPermutation = std::wstring(ShaderTypeToChar[int(input.first)]) + L"_" + input.second.shaderName;
 
-    std::wstring generatedFilename = GeneratePermutation(input, origFile, curPermutation, intermediateFolder, defines);
+    size_t ret = 0;
+    for (uint32_t mask : input.second.permutations)
+    {
+        std::vector<std::wstring> defines{ ShaderTypeToChar[int(input.first)] };
+        for (uint32_t i = 0; i < input.second.defines.size(); ++i)
+        {
+            if (mask & (1u << i))
+                defines.push_back(input.second.defines[i]);
+        }
 
-    size_t ret = CreateCompilationProcess(input, intermediateFolder, outputFolder, generatedFilename);
+        std::wstring permutationSource;
+        std::wstring generatedFilename = GeneratePermutation(input, origFile, curPermutation, defines, permutationSource);
 
-    // generates define permutations if they exist
-    if (input.second.defines.size())
-        ret += CompilePermutations(input, origFile, intermediateFolder, outputFolder, curPermutation, 0, defines);
+        const ShaderKey key = CombineShaderKey(input.second.shaderNameHash, mask);
+        ret |= CreateCompilationProcess(input, intermediateFolder, outputFolder, generatedFilename, permutationSource, key);
+    }
     return ret;
 }
 
-std::wstring ShaderBuilder::GeneratePermutation(ShaderConfigInfoMapType::value_type& input, const std::wstring origFile, std::wstring permutationName, std::wstring intermediateFolder, std::vector<std::wstring> defines)
+std::wstring ShaderBuilder::GeneratePermutation(ShaderConfigInfoMapType::value_type& input, const std::wstring origFile, std::wstring permutationName, std::vector<std::wstring> defines, std::wstring& permutationSource)
 {
     uint32_t hash = uint32_t(hasher(std::wstring(permutationName))) & ShaderKeyMask;
     wchar_t file_cstr[128];
@@ -259,7 +720,7 @@ std::wstring ShaderBuilder::GeneratePermutation(ShaderConfigInfoMapType::value_t
     m_createdPermutations.insert(hash);
 
     // shaderType_shaderName_shaderHash
-    swprintf_s<128>(file_cstr, L"%s_%s_%08X", defines[0].c_str(), input.second.shaderName.c_str(), hash);
+    std::swprintf(file_cstr, 128, L"%ls_%ls_%08X", defines[0].c_str(), input.second.shaderName.c_str(), hash);
 
     std::wstringstream output;
 
@@ -268,57 +729,58 @@ std::wstring ShaderBuilder::GeneratePermutation(ShaderConfigInfoMapType::value_t
         output << "#define " << define << "\n";
     }
 
+    // errors report the line in the shader file rather than in the permutation
+    output << "#line 1\n";
     output << origFile;
-
-    if (!intermediateFolder.empty())
-    {
-        std::wfstream outputFile;
-        outputFile.open(intermediateFolder + file_cstr + L".perm", std::ios_base::out | std::ios_base::trunc);
-        assert(outputFile.is_open());
-        outputFile << output.str();
-        outputFile.close();
-    }
+    // written out by CreateCompilationProcess if it has to be compiled
+    permutationSource = output.str();
 
     return file_cstr;
 }
 
 size_t ShaderBuilder::WaitForAllProcessCompletion()
 {
-    size_t ret = 0;
-    for (auto& itr : m_processInfo)
+    return m_compilePool.WaitAll();
+}
+
+size_t ShaderBuilder::GenerateCPPHeaders()
+{
+    size_t failures = 0;
+    // every shader's interface is the union of its permutations', so one pipeline layout fits all of them
+    std::vector<SpirvReflection> reflections;
+    for (auto& shaderInfo : m_allShaderInfos)
     {
-        DWORD processRet = 0;
-        LPDWORD p_processRet = &processRet;
-        while (true)
+        SpirvReflection& reflection = reflections.emplace_back();
+        for (uint32_t mask : shaderInfo.second.permutations)
         {
-            GetExitCodeProcess(itr.first, p_processRet);
-            if (processRet != STILL_ACTIVE)
+            auto permutation = m_reflections.find(CombineShaderKey(shaderInfo.second.shaderNameHash, mask));
+            std::string error;
+            if (permutation != m_reflections.end() && !MergeSpirvReflection(reflection, permutation->second, error))
             {
-                if (processRet)
-                    ++ret;
-                CloseHandle(itr.first);
-                CloseHandle(itr.second);
+                std::cout << "Error: " << wstringToString(ShaderTypeToChar[uint32_t(shaderInfo.first)]) << "_" << wstringToString(shaderInfo.second.shaderName)
+                    << ": permutations disagree, " << error << "\n";
+                ++failures;
                 break;
             }
         }
     }
-    m_processInfo.clear();
-    return ret;
-}
 
-void ShaderBuilder::GenerateCPPHeaders()
-{
-    std::wfstream fs;
-    fs.open(L"../autogen/ShaderData.h", std::ios_base::out | std::ios_base::trunc);
+    std::wstringstream fs;
 
     fs << "#pragma once\n\n";
     fs << "#include \"../Include/Shared/ShaderIncludes.h\"\n";
+    fs << "#include \"glm/glm.hpp\"\n";
+    fs << "#include <cstddef>\n";
     fs << "#include <cstdint>\n";
     fs << "#include <memory>\n";
     fs << "#include <string>\n\n";
 
+    failures += GenerateBlockStructs(fs, reflections);
+
+    size_t shaderIndex = 0;
     for (auto& shaderInfo : m_allShaderInfos)
     {
+        const SpirvReflection& reflection = reflections[shaderIndex++];
         fs << "struct " << ShaderTypeToChar[uint32_t(shaderInfo.first)] << "_" << shaderInfo.second.shaderName << ": ShaderInfo {\n";
         int i = 0;
         fs << "  operator uint32_t() override {\n";
@@ -337,6 +799,56 @@ void ShaderBuilder::GenerateCPPHeaders()
         fs << "  static constexpr uint32_t Hash = " << std::to_wstring(shaderInfo.second.shaderNameHash) << ";\n\n";
         fs << "  static constexpr uint32_t NumFlags = " << std::to_wstring(shaderInfo.second.defines.size()) << ";\n\n";
 
+        // the define keys that were compiled, everything else is left out of the build
+        fs << "  static constexpr uint32_t NumPermutations = " << std::to_wstring(shaderInfo.second.permutations.size()) << ";\n";
+        fs << "  static constexpr uint32_t Permutations[] = {";
+        for (size_t permutation = 0; permutation < shaderInfo.second.permutations.size(); ++permutation)
+        {
+            fs << (permutation ? ", " : " ") << std::to_wstring(shaderInfo.second.permutations[permutation]);
+        }
+        fs << " };\n\n";
+        fs << "  uint32_t GetNumPermutations() override {\n";
+        fs << "    return NumPermutations;\n";
+        fs << "  }\n\n";
+        fs << "  uint32_t GetPermutation(uint32_t index) override {\n";
+        fs << "    return Permutations[index];\n";
+        fs << "  }\n\n";
+
+        // reflected from the SPIR-V, c++ has no empty arrays so an unused table keeps one zeroed entry
+        fs << "  static constexpr uint32_t NumBindings = " << std::to_wstring(reflection.bindings.size()) << ";\n";
+        fs << "  static constexpr ShaderBinding Bindings[" << std::to_wstring(std::max<size_t>(reflection.bindings.size(), 1)) << "] = {";
+        for (size_t i = 0; i < reflection.bindings.size(); ++i)
+        {
+            const SpirvBinding& binding = reflection.bindings[i];
+            const uint32_t size = binding.block >= 0 ? reflection.blocks[binding.block].size : 0;
+            fs << (i ? ",\n    " : "\n    ") << "{ " << binding.set << ", " << binding.binding << ", " << string_VkDescriptorType(binding.descriptorType) << ", "
+                << binding.count << ", " << size << " }";
+        }
+        fs << (reflection.bindings.empty() ? " };\n" : "\n  };\n");
+        fs << "  static constexpr uint32_t PushConstantSize = " << std::to_wstring(reflection.pushConstantSize) << ";\n";
+        fs << "  static constexpr uint32_t NumVertexInputs = " << std::to_wstring(reflection.vertexInputs.size()) << ";\n";
+        fs << "  static constexpr ShaderVertexInput VertexInputs[" << std::to_wstring(std::max<size_t>(reflection.vertexInputs.size(), 1)) << "] = {";
+        for (size_t i = 0; i < reflection.vertexInputs.size(); ++i)
+        {
+            fs << (i ? ", " : " ") << "{ " << reflection.vertexInputs[i].location << ", " << string_VkFormat(reflection.vertexInputs[i].format) << " }";
+        }
+        fs << " };\n\n";
+        fs << "  uint32_t GetNumBindings() override {\n";
+        fs << "    return NumBindings;\n";
+        fs << "  }\n\n";
+        fs << "  const ShaderBinding& GetBinding(uint32_t index) override {\n";
+        fs << "    return Bindings[index];\n";
+        fs << "  }\n\n";
+        fs << "  uint32_t GetPushConstantSize() override {\n";
+        fs << "    return PushConstantSize;\n";
+        fs << "  }\n\n";
+        fs << "  uint32_t GetNumVertexInputs() override {\n";
+        fs << "    return NumVertexInputs;\n";
+        fs << "  }\n\n";
+        fs << "  const ShaderVertexInput& GetVertexInput(uint32_t index) override {\n";
+        fs << "    return VertexInputs[index];\n";
+        fs << "  }\n\n";
+
         fs << "  struct Key {\n";
         for (auto define : shaderInfo.second.defines)
         {
@@ -348,12 +860,292 @@ void ShaderBuilder::GenerateCPPHeaders()
         fs << "};\n\n";
     }
 
+    // whether the .spv files kept their debug info, see ShaderBuilder --debug-info
+    fs << "constexpr bool ShaderDebugInfo = " << (m_debugInfo ? "true" : "false") << ";\n";
+    // GfxShaderReloader rebuilds with the same options, otherwise every permutation would miss the cache
+    const wchar_t* optimizationNames[] = { L"none", L"performance", L"size" };
+    fs << "constexpr const char* ShaderBuilderOptions = \"--optimize " << optimizationNames[uint32_t(m_optimization)] << (m_debugInfo ? " --debug-info" : "") << "\";\n\n";
+
     fs << "const std::shared_ptr<ShaderInfo> g_shaderInfos [] = {\n";
     for (auto& shaderInfo : m_allShaderInfos)
     {
         fs << "  std::make_shared<" << ShaderTypeToChar[uint32_t(shaderInfo.first)] << "_" << shaderInfo.second.shaderName << ">(),\n";
     }
     fs << "};\n";
+
+    // touching the header recompiles everything that includes it, leave it alone if nothing changed
+    const std::filesystem::path headerPath = L"../autogen/ShaderData.h";
+    std::wstring header = fs.str();
+    {
+        std::wifstream existing(headerPath);
+        std::wstringstream existingContent;
+        existingContent << existing.rdbuf();
+        if (existing.is_open() && existingContent.str() == header)
+            return failures;
+    }
+    if (m_hotReload)
+    {
+        std::cout << "Error: the shader interface changed (bindings, blocks, permutations or shaders), restart the engine to pick it up\n";
+        return failures + 1;
+    }
+    std::wofstream output(headerPath, std::ios_base::trunc);
+    output << header;
+    return failures;
+}
+
+size_t ShaderBuilder::GenerateBlockStructs(std::wstringstream& fs, const std::vector<SpirvReflection>& shaders)
+{
+    struct BlockUse
+    {
+        SpirvBlock block;
+        // set and binding if every shader binds the block at the same place
+        bool bound = false;
+        bool consistent = true;
+        uint32_t set = 0;
+        uint32_t binding = 0;
+        VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    };
+    size_t failures = 0;
+    std::map<std::string, BlockUse> blocks;
+    for (const SpirvReflection& shader : shaders)
+    {
+        for (const SpirvBlock& block : shader.blocks)
+        {
+            auto inserted = blocks.insert({ block.name, BlockUse{ block } });
+            if (!inserted.second && !SameSpirvBlockLayout(inserted.first->second.block, block))
+            {
+                std::cout << "Error: block " << block.name << " has different layouts in different shaders\n";
+                ++failures;
+            }
+        }
+        for (const SpirvBinding& binding : shader.bindings)
+        {
+            if (binding.block < 0)
+                continue;
+            BlockUse& use = blocks[shader.blocks[binding.block].name];
+            if (use.bound && (use.set != binding.set || use.binding != binding.binding))
+                use.consistent = false;
+            use.bound = true;
+            use.set = binding.set;
+            use.binding = binding.binding;
+            use.descriptorType = binding.descriptorType;
+        }
+    }
+    if (blocks.empty())
+        return failures;
+
+    // the SPIR-V offsets already follow std140 (uniform) or std430 (storage, push constant) rules, the asserts make
+    // sure the c++ compiler lays the struct out the same way
+    fs << "namespace ShaderStructs\n{\n";
+    for (auto& itr : blocks)
+    {
+        const SpirvBlock& block = itr.second.block;
+        const std::wstring name = stringToWstring(block.name);
+        fs << "struct " << name << " {\n";
+        if (itr.second.bound && itr.second.consistent)
+        {
+            fs << "  static constexpr uint32_t Set = " << itr.second.set << ";\n";
+            fs << "  static constexpr uint32_t Binding = " << itr.second.binding << ";\n";
+            fs << "  static constexpr VkDescriptorType DescriptorType = " << string_VkDescriptorType(itr.second.descriptorType) << ";\n\n";
+        }
+        uint32_t cursor = 0;
+        uint32_t padding = 0;
+        bool runtimeArray = false;
+        for (const SpirvBlockMember& member : block.members)
+        {
+            std::wstring memberName = stringToWstring(member.name);
+            if (member.runtimeArray)
+            {
+                // c++ can't express it, the array starts at Offset and has Stride bytes per element
+                memberName[0] = std::towupper(memberName[0]);
+                if (!member.cppType.empty())
+                    fs << "  using " << memberName << "Element = " << stringToWstring(member.cppType) << ";\n";
+                fs << "  static constexpr uint32_t " << memberName << "Offset = " << member.offset << ";\n";
+                fs << "  static constexpr uint32_t " << memberName << "Stride = " << member.arrayStride << ";\n";
+                runtimeArray = true;
+                continue;
+            }
+            if (member.offset > cursor)
+                fs << "  uint8_t pad" << padding++ << "[" << (member.offset - cursor) << "];\n";
+            if (member.cppType.empty())
+                fs << "  uint8_t " << memberName << "[" << member.size << "];\n";
+            else if (member.arrayLength > 1)
+                fs << "  " << stringToWstring(member.cppType) << " " << memberName << "[" << member.arrayLength << "];\n";
+            else
+                fs << "  " << stringToWstring(member.cppType) << " " << memberName << ";\n";
+            cursor = member.offset + member.size;
+        }
+        fs << "};\n";
+        for (const SpirvBlockMember& member : block.members)
+        {
+            if (!member.runtimeArray)
+                fs << "static_assert(offsetof(" << name << ", " << stringToWstring(member.name) << ") == " << member.offset << ");\n";
+        }
+        if (!runtimeArray)
+            fs << "static_assert(sizeof(" << name << ") == " << block.size << ");\n";
+        fs << "\n";
+    }
+    fs << "}\n\n";
+    return failures;
+}
+
+bool ShaderBuilder::ParseInclude(const std::wstring& line, std::wstring& include)
+{
+    size_t pos = line.find_first_not_of(L" \t");
+    if (pos == line.npos || line[pos] != L'#')
+        return false;
+    pos = line.find_first_not_of(L" \t", pos + 1);
+    if (pos == line.npos || line.compare(pos, 7, L"include") != 0)
+        return false;
+    pos = line.find_first_not_of(L" \t", pos + 7);
+    if (pos == line.npos || (line[pos] != L'"' && line[pos] != L'<'))
+        return false;
+    const wchar_t close = line[pos] == L'"' ? L'"' : L'>';
+    size_t end = line.find(close, pos + 1);
+    if (end == line.npos)
+        throw std::runtime_error("unterminated #include: " + wstringToString(line));
+    include = line.substr(pos + 1, end - pos - 1);
+    return true;
+}
+
+std::filesystem::path ShaderBuilder::FindInclude(const std::filesystem::path& includingFile, const std::wstring& include)
+{
+    for (const std::filesystem::path& folder : { includingFile.parent_path(), m_shaderFolder })
+    {
+        std::filesystem::path candidate = (folder / include).lexically_normal();
+        if (std::filesystem::is_regular_file(candidate))
+            return candidate;
+    }
+    throw std::runtime_error(includingFile.string() + ": cannot find include " + wstringToString(include));
+}
+
+void ShaderBuilder::ExpandIncludes(
+    const std::filesystem::path& file,
+    std::wstringstream& output,
+    std::vector<std::filesystem::path>& includeStack,
+    std::set<std::filesystem::path>& onceFiles)
+{
+    if (onceFiles.count(file))
+        return;
+    if (std::find(includeStack.begin(), includeStack.end(), file) != includeStack.end())
+        throw std::runtime_error(file.string() + ": recursive #include");
+
+    std::wifstream fs(file);
+    if (!fs.is_open())
+        throw std::runtime_error(file.string() + ": cannot open include");
+
+    includeStack.push_back(file);
+    std::vector<std::filesystem::path>& dependencies = m_dependencies[m_currentShader];
+    output << "#line 1\n";
+    size_t lineNumber = 0;
+    std::wstring line;
+    while (std::getline(fs, line))
+    {
+        ++lineNumber;
+        std::wstring include;
+        if (ParseInclude(line, include))
+        {
+            std::filesystem::path includePath = FindInclude(file, include);
+            if (std::find(dependencies.begin(), dependencies.end(), includePath) == dependencies.end())
+                dependencies.push_back(includePath);
+            ExpandIncludes(includePath, output, includeStack, onceFiles);
+            output << "#line " << (lineNumber + 1) << "\n";
+            continue;
+        }
+        size_t pos = line.find_first_not_of(L" \t");
+        if (pos != line.npos && line.compare(pos, 12, L"#pragma once") == 0)
+        {
+            onceFiles.insert(file);
+            output << "\n";
+            continue;
+        }
+        output << line << "\n";
+    }
+    includeStack.pop_back();
+}
+
+void ShaderBuilder::WriteArchive(const std::wstring& outputFolder)
+{
+    std::sort(m_archiveEntries.begin(), m_archiveEntries.end(), [](const ArchiveInput& a, const ArchiveInput& b) { return a.key < b.key; });
+
+    std::vector<ShaderArchiveEntry> entries;
+    std::vector<char> blobs;
+    for (auto& input : m_archiveEntries)
+    {
+        // permutations that failed to compile are left out, the engine reports them as missing
+        std::ifstream spv(std::filesystem::path(input.spvPath), std::ios_base::binary | std::ios_base::ate);
+        if (!spv.is_open())
+            continue;
+        size_t size = size_t(spv.tellg());
+        spv.seekg(0);
+
+        blobs.resize((blobs.size() + ShaderArchiveAlignment - 1) & ~(ShaderArchiveAlignment - 1));
+        entries.push_back({ input.key, 0, blobs.size(), size, 0 });
+        blobs.resize(blobs.size() + size);
+        spv.read(blobs.data() + entries.back().offset, std::streamsize(size));
+        entries.back().hash = ShaderContentHash(blobs.data() + entries.back().offset, size);
+    }
+
+    const ShaderArchiveHeader header = { ShaderArchiveMagic, ShaderArchiveVersion, uint32_t(entries.size()), 0 };
+    const uint64_t blobStart = sizeof(header) + entries.size() * sizeof(ShaderArchiveEntry);
+    for (auto& entry : entries)
+    {
+        entry.offset += blobStart;
+    }
+
+    std::string archive(reinterpret_cast<const char*>(&header), sizeof(header));
+    archive.append(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ShaderArchiveEntry));
+    archive.append(blobs.data(), blobs.size());
+
+    // same as ShaderData.h, leave an identical archive alone
+    const std::filesystem::path archivePath = std::filesystem::path(outputFolder) / ShaderArchiveName;
+    {
+        std::ifstream existing(archivePath, std::ios_base::binary);
+        std::stringstream existingContent;
+        existingContent << existing.rdbuf();
+        if (existing.is_open() && existingContent.str() == archive)
+            return;
+    }
+    std::ofstream fs(archivePath, std::ios_base::binary | std::ios_base::trunc);
+    fs.write(archive.data(), std::streamsize(archive.size()));
+    std::cout << "wrote " << entries.size() << " permutations to " << archivePath.string() << "\n";
+}
+
+void ShaderBuilder::WriteDepfile(const std::wstring& intermediateFolder)
+{
+    if (intermediateFolder.empty())
+        return;
+
+    auto escape = [](const std::filesystem::path& path)
+    {
+        std::string escaped;
+        for (char c : path.generic_string())
+        {
+            if (c == ' ' || c == '#')
+                escaped += '\\';
+            else if (c == '$')
+                escaped += '$';
+            escaped += c;
+        }
+        return escaped;
+    };
+
+    std::ofstream fs(std::filesystem::path(intermediateFolder + c_depFile), std::ios_base::trunc);
+    std::string allSources;
+    for (auto& shader : m_dependencies)
+    {
+        std::string sources = escape(shader.first);
+        for (auto& dependency : shader.second)
+        {
+            sources += " " + escape(dependency);
+        }
+        allSources += " " + sources;
+        for (auto& spv : m_outputs[shader.first])
+        {
+            fs << escape(std::filesystem::absolute(spv).lexically_normal()) << ": " << sources << "\n";
+        }
+    }
+    fs << escape(std::filesystem::absolute(L"../autogen/ShaderData.h").lexically_normal()) << ":" << allSources << "\n";
 }
 
 size_t ShaderBuilder::Compile(PathType path, std::wstring intermediatePath, std::wstring outputPath)
@@ -365,12 +1157,31 @@ size_t ShaderBuilder::Compile(PathType path, std::wstring intermediatePath, std:
         throw(std::runtime_error("file not found"));
     }
 
+    m_currentShader = std::filesystem::absolute(path).lexically_normal();
+    std::vector<std::filesystem::path>& dependencies = m_dependencies[m_currentShader];
+    dependencies.clear();
+
     ShaderConfigInfoMapType shaderInfo;
     std::wstringstream fullFile;;
+    std::vector<std::filesystem::path> includeStack{ m_currentShader };
+    std::set<std::filesystem::path> onceFiles;
+    size_t lineNumber = 0;
     while (!fs.eof())
     {
         std::wstring temp;
         std::getline(fs, temp);
+        ++lineNumber;
+
+        std::wstring include;
+        if (ParseInclude(temp, include))
+        {
+            std::filesystem::path includePath = FindInclude(m_currentShader, include);
+            if (std::find(dependencies.begin(), dependencies.end(), includePath) == dependencies.end())
+                dependencies.push_back(includePath);
+            ExpandIncludes(includePath, fullFile, includeStack, onceFiles);
+            fullFile << "#line " << (lineNumber + 1) << "\n";
+            continue;
+        }
         fullFile << temp << "\n";
 
         std::vector<std::wstring> defines;
@@ -392,7 +1203,7 @@ size_t ShaderBuilder::Compile(PathType path, std::wstring intermediatePath, std:
         if (!std::iswupper(shaderName[0]))
         {
             wchar_t errorMsg[256];
-            swprintf_s(errorMsg, 256, L"%s: Shader %s does not start with upper case", shaderName.c_str(), path);
+            std::swprintf(errorMsg, 256, L"%ls: Shader %ls does not start with upper case", shaderName.c_str(), std::filesystem::path(path).wstring().c_str());
             throw std::runtime_error(wstringToString(errorMsg));
         }
         ProcessConfigInfo(ss, shaderName, shaderInfo);
@@ -410,23 +1221,44 @@ size_t ShaderBuilder::Compile(PathType path, std::wstring intermediatePath, std:
 size_t ShaderBuilder::CompileAll(PathType path, PathType intermediatePath, PathType outputPath)
 {
     size_t compileFailures = 0;
+    const std::wstring intermediatePathStr = std::filesystem::path(intermediatePath).wstring();
+    m_upToDateCount = 0;
+    m_compiledCount = 0;
+    m_timings.clear();
+    QueryCompilerVersion();
+    LoadCache(intermediatePathStr);
+    m_shaderFolder = std::filesystem::absolute(path).lexically_normal();
+    m_dependencies.clear();
+    m_outputs.clear();
+    m_archiveEntries.clear();
+    m_reflections.clear();
+    const std::wstring outputPathStr = std::filesystem::path(outputPath).wstring();
     for (auto& entry : std::filesystem::directory_iterator(path))
     {
+        // shared headers live in subfolders
+        if (!entry.is_regular_file())
+            continue;
         try
         {
             std::cout << "Compiling " << entry.path() << std::endl;
 
-            std::wstring intermediatePathStr{ intermediatePath };
-            std::wstring outputPathStr{ outputPath };
-
             compileFailures += Compile(entry.path().c_str(), intermediatePathStr, outputPathStr);
         }
-        catch (std::runtime_error e)
+        catch (const std::runtime_error& e)
         {
+            // the shader is missing from ShaderData.h, the build has to fail
             std::cout << "Error: " << e.what() << std::endl;
+            ++compileFailures;
         }
     }
-    GenerateCPPHeaders();
-    compileFailures = WaitForAllProcessCompletion();
+    compileFailures += WaitForAllProcessCompletion();
+    // needs the reflection of every permutation
+    compileFailures += GenerateCPPHeaders();
+    SaveCache(intermediatePathStr);
+    WriteDepfile(intermediatePathStr);
+    if (!m_hotReload)
+        WriteArchive(outputPathStr);
+    ReportPermutations(intermediatePathStr);
+    std::cout << m_compiledCount << " permutations compiled, " << m_upToDateCount << " up to date\n";
     return compileFailures;
 }
@@ -6,10 +6,17 @@
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
-#include <Windows.h>
 #include <set>
+#include <mutex>
 
 #include "ShaderIncludes.h"
+#include "ProcessPool.h"
+#include "SpirvReflection.h"
+
+// compiles in process through shaderc (from the vulkan sdk) instead of spawning glslc per permutation
+#ifdef SHADERBUILDER_USE_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
 
 class ShaderBuilder
 {
@@ -17,6 +24,14 @@ public:
   using PathType = const std::filesystem::path::value_type*;
   using BasePathType = std::filesystem::path::value_type;
 
+  // spirv-opt passes run on every permutation, anything but None also strips debug info unless it is asked for
+  enum class Optimization
+  {
+    None,
+    Performance,
+    Size
+  };
+
 private:
   const wchar_t* ShaderTypeToChar[3] =
   {
@@ -36,6 +51,9 @@ private:
     PS_ENTRY_POINT,
     CS_ENTRY_POINT,
     DEFINES,
+    EXCLUSIVE,
+    REQUIRES,
+    PERMUTATIONS,
     INVALID
   };
 
@@ -45,34 +63,124 @@ private:
     std::wstring entryPoint;
     uint32_t shaderNameHash;
     std::vector<std::wstring> defines;
+    // define keys (bit i = defines[i]) to compile, ascending
+    std::vector<uint32_t> permutations;
   }; 
   // need its iteration order to be guarenteed so not using unordered
   using ShaderConfigInfoMapType = std::multimap<ShaderType, ShaderConfigInfo>;
   ShaderConfigInfoMapType m_allShaderInfos;
-  // process Handle, thread handle
-  std::unordered_map<HANDLE, HANDLE> m_processInfo;
+  // glslc invocations (or shaderc compilations), at most one per hardware thread at a time
+  ProcessPool m_compilePool;
+#ifdef SHADERBUILDER_USE_SHADERC
+  shaderc::Compiler m_compiler;
+#endif
+  struct CompileTiming
+  {
+    std::string permutation;
+    double seconds;
+  };
+  // every compiled permutation, only touched by pool callbacks until WaitForAllProcessCompletion
+  std::vector<CompileTiming> m_timings;
+  // glslc --version, or a hash of the shaderc library binary with SHADERBUILDER_USE_SHADERC. part of every
+  // permutation's cache key
+  std::string m_compilerVersion;
+  Optimization m_optimization = Optimization::None;
+  bool m_debugInfo = false;
+  bool m_hotReload = false;
+
+  // permutation name -> hash of everything that went into its .spv, kept in the intermediate folder
+  // permutations are skipped if their hash is unchanged and the .spv is still there, only successful compilations
+  // make it into the new cache
+  std::unordered_map<std::wstring, uint64_t> m_previousCache;
+  std::unordered_map<std::wstring, uint64_t> m_cache;
+  std::mutex m_cacheMutex;
+  static constexpr const wchar_t* c_cacheFile = L"ShaderCache.txt";
+  static constexpr const wchar_t* c_depFile = L"ShaderDeps.d";
+  static constexpr const wchar_t* c_reportFile = L"ShaderReport.csv";
+  // next to every .perm, read back for permutations that are up to date
+  static constexpr const wchar_t* c_reflectionExtension = L".reflect";
+  size_t m_upToDateCount = 0;
+  size_t m_compiledCount = 0;
   std::hash<std::wstring> hasher = {};
 
   std::unordered_set<uint32_t> m_createdPermutations;
 
+  // shader file -> every file it includes (directly or not), in the order they were first included
+  std::map<std::filesystem::path, std::vector<std::filesystem::path>> m_dependencies;
+  // shader file -> the .spv files compiled from it
+  std::map<std::filesystem::path, std::vector<std::wstring>> m_outputs;
+  struct ArchiveInput
+  {
+    ShaderKey key;
+    std::wstring spvPath;
+  };
+  // every permutation of this build, compiled or up to date
+  std::vector<ArchiveInput> m_archiveEntries;
+  // interface of every permutation that compiled (or was up to date), guarded by m_cacheMutex
+  std::map<ShaderKey, SpirvReflection> m_reflections;
+  // the file Compile is working on
+  std::filesystem::path m_currentShader;
+  // include search path after the including file's folder
+  std::filesystem::path m_shaderFolder;
+
+  static std::wstring GetCompilerPath();
+  // glslc flags for m_optimization, always with -g as reflection needs the names. FinishSpirv strips the debug info
+  // again unless m_debugInfo is set
+  std::vector<std::wstring> GetOptimizationArgs() const;
+  // reflects a freshly compiled module into m_reflections and reflectionPath, then strips it and writes it to spvPath
+  // through a temporary file renamed into place. returns an error message, empty on success. safe to call from
+  // several pool threads
+  std::string FinishSpirv(std::vector<uint32_t>& words, ShaderKey key, const std::wstring& reflectionPath, const std::wstring& spvPath);
+  static std::wstring GetTempSpirvPath(const std::wstring& spvPath);
+  void QueryCompilerVersion();
+  void LoadCache(const std::wstring& intermediateFolder);
+  void SaveCache(const std::wstring& intermediateFolder);
+
+  // queues the compilation unless the cached .spv is up to date, failures are counted by WaitForAllProcessCompletion
   size_t CreateCompilationProcess(
     ShaderConfigInfoMapType::value_type& input,
     std::wstring intermediateFolder,
     std::wstring outputFolder,
-    std::wstring shaderName);
+    std::wstring shaderName,
+    const std::wstring& source,
+    ShaderKey key);
 
   void ProcessConfigInfo(std::wstringstream& ss, std::wstring shaderName, ShaderConfigInfoMapType& map);
 
   HeaderType IsHeader(std::wstring input);
 
-  size_t CompilePermutations(
-    ShaderConfigInfoMapType::value_type& input, 
-    const std::wstring origFile, 
-    std::wstring intermediateFolder,
-    std::wstring outputFolder,
-    std::wstring curPermutation, 
-    size_t nextPermutation,
-    std::vector<std::wstring> defines);
+  // returns the include's path if line is an #include directive
+  static bool ParseInclude(const std::wstring& line, std::wstring& include);
+  // appends the file with its includes expanded to output, #line directives keep the line numbers of errors inside
+  // the file correct. files with #pragma once are only expanded once per shader
+  void ExpandIncludes(
+    const std::filesystem::path& file,
+    std::wstringstream& output,
+    std::vector<std::filesystem::path>& includeStack,
+    std::set<std::filesystem::path>& onceFiles);
+  std::filesystem::path FindInclude(const std::filesystem::path& includingFile, const std::wstring& include);
+
+  // instructions in a SPIR-V module, 0 if it isn't one
+  static size_t CountSpirvInstructions(const std::vector<uint32_t>& words);
+  // prints totals and the slowest permutations, writes every permutation's compile time, size and instruction
+  // count to c_reportFile
+  void ReportPermutations(const std::wstring& intermediateFolder);
+
+  // packs every permutation's .spv into ShaderArchiveName in the output folder, see ShaderArchive.h
+  void WriteArchive(const std::wstring& outputFolder);
+
+  // make style rules from every .spv and ShaderData.h to the files they were built from
+  void WriteDepfile(const std::wstring& intermediateFolder);
+
+  // every subset of defines allowed by the rules, or exactly the explicit list if there is one
+  //   Exclusive: A|B|C    at most one of A, B and C
+  //   Requires: A->B+C    A only together with B and C
+  //   Permutations: None, A, A+B
+  static std::vector<uint32_t> SelectPermutations(
+    const std::vector<std::wstring>& defines,
+    const std::vector<std::wstring>& exclusiveGroups,
+    const std::vector<std::wstring>& requirements,
+    const std::vector<std::wstring>& explicitPermutations);
 
   size_t CompilePermutations(
     ShaderConfigInfoMapType::value_type& input, 
@@ -84,14 +192,24 @@ private:
     ShaderConfigInfoMapType::value_type& input,
     const std::wstring origFile,
     std::wstring permutationName,
-    std::wstring intermediateFolder, 
-    std::vector<std::wstring> defines);
+    std::vector<std::wstring> defines,
+    std::wstring& permutationSource);
 
   size_t WaitForAllProcessCompletion();
 
-  void GenerateCPPHeaders();
+  // writes ShaderData.h once everything is compiled, returns how many shaders have permutations that disagree on
+  // their interface (or blocks of the same name with different layouts)
+  size_t GenerateCPPHeaders();
+  // the ShaderStructs namespace of ShaderData.h, a c++ struct with layout checks for every buffer block
+  size_t GenerateBlockStructs(std::wstringstream& fs, const std::vector<SpirvReflection>& shaders);
 
 public:
+  void SetOptimization(Optimization optimization) { m_optimization = optimization; }
+  // keeps OpName/OpLine/OpSource for graphics debuggers, recorded in ShaderData.h as ShaderDebugInfo
+  void SetDebugInfo(bool debugInfo) { m_debugInfo = debugInfo; }
+  // run by a live engine: only the loose .spv files are written, the archive is left alone as the engine has it mapped
+  // and a ShaderData.h that would change counts as a failure, as the engine can't pick up interface changes
+  void SetHotReload(bool hotReload) { m_hotReload = hotReload; }
 
   size_t Compile(PathType path, std::wstring intermediatePath, std::wstring outputPath);
   size_t CompileAll(PathType path, PathType intermediatePath, PathType outputPath);
@@ -0,0 +1,752 @@
+#include "SpirvReflection.h"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+    // from the SPIR-V specification, only what reflection and stripping look at
+    enum : uint32_t
+    {
+        OpSourceContinued = 2,
+        OpSource = 3,
+        OpSourceExtension = 4,
+        OpName = 5,
+        OpMemberName = 6,
+        OpString = 7,
+        OpLine = 8,
+        OpExtInstImport = 11,
+        OpExtInst = 12,
+        OpEntryPoint = 15,
+        OpTypeBool = 20,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpConstant = 43,
+        OpSpecConstant = 50,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72,
+        OpNoLine = 317,
+        OpModuleProcessed = 330,
+        OpTypeAccelerationStructureKHR = 5341,
+    };
+
+    enum : uint32_t
+    {
+        DecorationBlock = 2,
+        DecorationBufferBlock = 3,
+        DecorationRowMajor = 4,
+        DecorationArrayStride = 6,
+        DecorationMatrixStride = 7,
+        DecorationBuiltIn = 11,
+        DecorationLocation = 30,
+        DecorationBinding = 33,
+        DecorationDescriptorSet = 34,
+        DecorationOffset = 35,
+    };
+
+    enum : uint32_t
+    {
+        StorageClassUniformConstant = 0,
+        StorageClassInput = 1,
+        StorageClassUniform = 2,
+        StorageClassPushConstant = 9,
+        StorageClassStorageBuffer = 12,
+    };
+
+    const uint32_t SpirvMagic = 0x07230203;
+    const uint32_t SpirvHeaderWords = 5;
+    const uint32_t ExecutionModelVertex = 0;
+    const uint32_t DimBuffer = 5;
+    const uint32_t DimSubpassData = 6;
+
+    std::string ReadString(const std::vector<uint32_t>& words, size_t word, size_t end)
+    {
+        std::string string;
+        for (; word < end; ++word)
+        {
+            for (uint32_t byte = 0; byte < 4; ++byte)
+            {
+                char c = char((words[word] >> (byte * 8)) & 0xFF);
+                if (!c)
+                    return string;
+                string.push_back(c);
+            }
+        }
+        return string;
+    }
+
+    struct Decorations
+    {
+        bool block = false;
+        bool bufferBlock = false;
+        bool builtIn = false;
+        bool rowMajor = false;
+        bool hasLocation = false;
+        uint32_t location = 0;
+        uint32_t set = 0;
+        uint32_t binding = 0;
+        uint32_t arrayStride = 0;
+        uint32_t matrixStride = 0;
+        bool hasOffset = false;
+        uint32_t offset = 0;
+    };
+
+    // everything the module declares that reflection needs, by result id
+    struct Module
+    {
+        uint32_t executionModel = ~0u;
+        std::unordered_map<uint32_t, std::string> names;
+        std::map<std::pair<uint32_t, uint32_t>, std::string> memberNames;
+        std::unordered_map<uint32_t, Decorations> decorations;
+        std::map<std::pair<uint32_t, uint32_t>, Decorations> memberDecorations;
+        // opcode followed by the operands after the result id
+        std::unordered_map<uint32_t, std::vector<uint32_t>> types;
+        std::unordered_map<uint32_t, uint32_t> constants;
+        struct Variable
+        {
+            uint32_t id;
+            uint32_t type;
+            uint32_t storageClass;
+        };
+        std::vector<Variable> variables;
+
+        const std::vector<uint32_t>* FindType(uint32_t id) const
+        {
+            auto type = types.find(id);
+            return type == types.end() ? nullptr : &type->second;
+        }
+        Decorations GetDecorations(uint32_t id) const
+        {
+            auto decoration = decorations.find(id);
+            return decoration == decorations.end() ? Decorations{} : decoration->second;
+        }
+        Decorations GetMemberDecorations(uint32_t id, uint32_t member) const
+        {
+            auto decoration = memberDecorations.find({ id, member });
+            return decoration == memberDecorations.end() ? Decorations{} : decoration->second;
+        }
+    };
+
+    void Decorate(Decorations& decorations, uint32_t decoration, uint32_t operand)
+    {
+        switch (decoration)
+        {
+        case DecorationBlock: decorations.block = true; break;
+        case DecorationBufferBlock: decorations.bufferBlock = true; break;
+        case DecorationRowMajor: decorations.rowMajor = true; break;
+        case DecorationArrayStride: decorations.arrayStride = operand; break;
+        case DecorationMatrixStride: decorations.matrixStride = operand; break;
+        case DecorationBuiltIn: decorations.builtIn = true; break;
+        case DecorationLocation: decorations.hasLocation = true; decorations.location = operand; break;
+        case DecorationBinding: decorations.binding = operand; break;
+        case DecorationDescriptorSet: decorations.set = operand; break;
+        case DecorationOffset: decorations.hasOffset = true; decorations.offset = operand; break;
+        default: break;
+        }
+    }
+
+    bool ParseModule(const std::vector<uint32_t>& words, Module& module, std::string& error)
+    {
+        if (words.size() < SpirvHeaderWords || words[0] != SpirvMagic)
+        {
+            error = "not a SPIR-V module";
+            return false;
+        }
+        for (size_t word = SpirvHeaderWords; word < words.size();)
+        {
+            const uint32_t opcode = words[word] & 0xFFFF;
+            const uint32_t count = words[word] >> 16;
+            if (!count || word + count > words.size())
+            {
+                error = "truncated SPIR-V instruction";
+                return false;
+            }
+            const uint32_t* operands = &words[word + 1];
+            const size_t end = word + count;
+            switch (opcode)
+            {
+            case OpName:
+                module.names[operands[0]] = ReadString(words, word + 2, end);
+                break;
+            case OpMemberName:
+                module.memberNames[{ operands[0], operands[1] }] = ReadString(words, word + 3, end);
+                break;
+            case OpEntryPoint:
+                if (module.executionModel == ~0u)
+                    module.executionModel = operands[0];
+                break;
+            case OpDecorate:
+                Decorate(module.decorations[operands[0]], operands[1], count > 3 ? operands[2] : 0);
+                break;
+            case OpMemberDecorate:
+                Decorate(module.memberDecorations[{ operands[0], operands[1] }], operands[2], count > 4 ? operands[3] : 0);
+                break;
+            case OpTypeBool:
+            case OpTypeInt:
+            case OpTypeFloat:
+            case OpTypeVector:
+            case OpTypeMatrix:
+            case OpTypeImage:
+            case OpTypeSampler:
+            case OpTypeSampledImage:
+            case OpTypeArray:
+            case OpTypeRuntimeArray:
+            case OpTypeStruct:
+            case OpTypeAccelerationStructureKHR:
+            {
+                std::vector<uint32_t>& type = module.types[operands[0]];
+                type.push_back(opcode);
+                type.insert(type.end(), operands + 1, &words[0] + end);
+                break;
+            }
+            case OpTypePointer:
+                module.types[operands[0]] = { opcode, operands[1], operands[2] };
+                break;
+            case OpConstant:
+            case OpSpecConstant:
+                module.constants[operands[1]] = operands[2];
+                break;
+            case OpVariable:
+                module.variables.push_back({ operands[1], operands[0], operands[2] });
+                break;
+            default:
+                break;
+            }
+            word = end;
+        }
+        return true;
+    }
+
+    class Reflector
+    {
+    public:
+        Reflector(const Module& module, SpirvReflection& reflection) : m_module(module), m_reflection(reflection) {}
+
+        bool Reflect(std::string& error);
+
+    private:
+        const Module& m_module;
+        SpirvReflection& m_reflection;
+        // struct id -> index into m_reflection.blocks
+        std::unordered_map<uint32_t, int32_t> m_blocks;
+
+        uint32_t GetSize(uint32_t typeId, const Decorations& member) const;
+        // layout compatible c++ type and its size, empty if there is none
+        std::pair<std::string, uint32_t> GetCppType(uint32_t typeId, const Decorations& member) const;
+        int32_t AddBlock(uint32_t structId, const std::string& fallbackName, std::string& error);
+        static VkFormat GetVertexFormat(const Module& module, uint32_t typeId);
+    };
+
+    uint32_t Reflector::GetSize(uint32_t typeId, const Decorations& member) const
+    {
+        const std::vector<uint32_t>* type = m_module.FindType(typeId);
+        if (!type)
+            return 0;
+        switch ((*type)[0])
+        {
+        case OpTypeBool: return 4;
+        case OpTypeInt:
+        case OpTypeFloat: return (*type)[1] / 8;
+        case OpTypeVector: return (*type)[2] * GetSize((*type)[1], member);
+        case OpTypeMatrix:
+        {
+            // row major matrices store their rows matrixStride apart
+            const std::vector<uint32_t>* column = m_module.FindType((*type)[1]);
+            const uint32_t vectors = member.rowMajor && column ? (*column)[2] : (*type)[2];
+            return vectors * (member.matrixStride ? member.matrixStride : GetSize((*type)[1], member));
+        }
+        case OpTypeArray:
+        {
+            auto length = m_module.constants.find((*type)[2]);
+            return (length == m_module.constants.end() ? 0 : length->second) * m_module.GetDecorations(typeId).arrayStride;
+        }
+        case OpTypeStruct:
+        {
+            uint32_t size = 0;
+            for (uint32_t i = 1; i < type->size(); ++i)
+            {
+                const Decorations decorations = m_module.GetMemberDecorations(typeId, i - 1);
+                size = std::max(size, decorations.offset + GetSize((*type)[i], decorations));
+            }
+            return size;
+        }
+        default: return 0;
+        }
+    }
+
+    std::pair<std::string, uint32_t> Reflector::GetCppType(uint32_t typeId, const Decorations& member) const
+    {
+        const std::vector<uint32_t>* type = m_module.FindType(typeId);
+        if (!type)
+            return {};
+        switch ((*type)[0])
+        {
+        case OpTypeInt:
+            if ((*type)[1] == 32)
+                return { (*type)[2] ? "int32_t" : "uint32_t", 4 };
+            return {};
+        case OpTypeFloat:
+            if ((*type)[1] == 32)
+                return { "float", 4 };
+            if ((*type)[1] == 64)
+                return { "double", 8 };
+            return {};
+        case OpTypeVector:
+        {
+            const std::vector<uint32_t>* component = m_module.FindType((*type)[1]);
+            const std::string count = std::to_string((*type)[2]);
+            const uint32_t size = GetSize(typeId, member);
+            if (!component)
+                return {};
+            if ((*component)[0] == OpTypeFloat && (*component)[1] == 32)
+                return { "glm::vec" + count, size };
+            if ((*component)[0] == OpTypeFloat && (*component)[1] == 64)
+                return { "glm::dvec" + count, size };
+            if ((*component)[0] == OpTypeInt && (*component)[1] == 32)
+                return { ((*component)[2] ? "glm::ivec" : "glm::uvec") + count, size };
+            return {};
+        }
+        case OpTypeMatrix:
+        {
+            // glm matrices are column major with tightly packed float columns
+            const std::vector<uint32_t>* column = m_module.FindType((*type)[1]);
+            if (member.rowMajor || !column || GetCppType((*type)[1], member).first.compare(0, 8, "glm::vec") != 0)
+                return {};
+            const uint32_t columns = (*type)[2];
+            const uint32_t rows = (*column)[2];
+            if (member.matrixStride != rows * 4)
+                return {};
+            return { "glm::mat" + std::to_string(columns) + (columns == rows ? "" : "x" + std::to_string(rows)), columns * rows * 4 };
+        }
+        default: return {};
+        }
+    }
+
+    int32_t Reflector::AddBlock(uint32_t structId, const std::string& fallbackName, std::string& error)
+    {
+        auto existing = m_blocks.find(structId);
+        if (existing != m_blocks.end())
+            return existing->second;
+
+        const std::vector<uint32_t>* type = m_module.FindType(structId);
+        if (!type || (*type)[0] != OpTypeStruct)
+        {
+            error = fallbackName + " is not a struct";
+            return -1;
+        }
+        SpirvBlock block;
+        auto name = m_module.names.find(structId);
+        block.name = name != m_module.names.end() && !name->second.empty() ? name->second : fallbackName;
+        block.size = 0;
+        for (uint32_t i = 1; i < type->size(); ++i)
+        {
+            const uint32_t memberType = (*type)[i];
+            const Decorations decorations = m_module.GetMemberDecorations(structId, i - 1);
+            if (!decorations.hasOffset)
+            {
+                error = block.name + " has a member without an offset";
+                return -1;
+            }
+            SpirvBlockMember member = {};
+            auto memberName = m_module.memberNames.find({ structId, i - 1 });
+            member.name = memberName != m_module.memberNames.end() && !memberName->second.empty() ? memberName->second : "member" + std::to_string(i - 1);
+            member.offset = decorations.offset;
+            member.size = GetSize(memberType, decorations);
+            member.arrayLength = 1;
+
+            const std::vector<uint32_t>* memberInfo = m_module.FindType(memberType);
+            if (memberInfo && ((*memberInfo)[0] == OpTypeArray || (*memberInfo)[0] == OpTypeRuntimeArray))
+            {
+                member.arrayStride = m_module.GetDecorations(memberType).arrayStride;
+                member.runtimeArray = (*memberInfo)[0] == OpTypeRuntimeArray;
+                if (!member.runtimeArray)
+                {
+                    auto length = m_module.constants.find((*memberInfo)[2]);
+                    member.arrayLength = length == m_module.constants.end() ? 0 : length->second;
+                }
+                // an array of cppType only if the elements are as far apart in c++
+                std::pair<std::string, uint32_t> element = GetCppType((*memberInfo)[1], decorations);
+                if (element.second == member.arrayStride)
+                    member.cppType = element.first;
+            }
+            else
+            {
+                member.cppType = GetCppType(memberType, decorations).first;
+            }
+            if (!member.runtimeArray)
+                block.size = std::max(block.size, member.offset + member.size);
+            block.members.push_back(member);
+        }
+
+        m_reflection.blocks.push_back(block);
+        const int32_t index = int32_t(m_reflection.blocks.size() - 1);
+        m_blocks[structId] = index;
+        return index;
+    }
+
+    VkFormat Reflector::GetVertexFormat(const Module& module, uint32_t typeId)
+    {
+        const std::vector<uint32_t>* type = module.FindType(typeId);
+        if (!type)
+            return VK_FORMAT_UNDEFINED;
+        uint32_t components = 1;
+        if ((*type)[0] == OpTypeVector)
+        {
+            components = (*type)[2];
+            type = module.FindType((*type)[1]);
+        }
+        if (!type || ((*type)[0] != OpTypeInt && (*type)[0] != OpTypeFloat) || components < 1 || components > 4 || (*type)[1] != 32)
+            return VK_FORMAT_UNDEFINED;
+        // the 32 bit formats of every component count are 3 apart, in uint, sint, sfloat order
+        const uint32_t first = (*type)[0] == OpTypeFloat ? VK_FORMAT_R32_SFLOAT : (*type)[2] ? VK_FORMAT_R32_SINT : VK_FORMAT_R32_UINT;
+        return VkFormat(first + (components - 1) * 3);
+    }
+
+    bool Reflector::Reflect(std::string& error)
+    {
+        for (const Module::Variable& variable : m_module.variables)
+        {
+            const std::vector<uint32_t>* pointer = m_module.FindType(variable.type);
+            if (!pointer || (*pointer)[0] != OpTypePointer)
+                continue;
+            const Decorations decorations = m_module.GetDecorations(variable.id);
+
+            if (variable.storageClass == StorageClassInput)
+            {
+                if (m_module.executionModel == ExecutionModelVertex && decorations.hasLocation && !decorations.builtIn)
+                {
+                    const VkFormat format = GetVertexFormat(m_module, (*pointer)[2]);
+                    if (format == VK_FORMAT_UNDEFINED)
+                    {
+                        error = "vertex input at location " + std::to_string(decorations.location) + " has an unsupported type";
+                        return false;
+                    }
+                    m_reflection.vertexInputs.push_back({ decorations.location, format });
+                }
+                continue;
+            }
+            if (variable.storageClass == StorageClassPushConstant)
+            {
+                m_reflection.pushConstantBlock = AddBlock((*pointer)[2], "PushConstants", error);
+                if (m_reflection.pushConstantBlock < 0)
+                    return false;
+                m_reflection.pushConstantSize = m_reflection.blocks[m_reflection.pushConstantBlock].size;
+                continue;
+            }
+            if (variable.storageClass != StorageClassUniform && variable.storageClass != StorageClassStorageBuffer &&
+                variable.storageClass != StorageClassUniformConstant)
+                continue;
+
+            // arrays of descriptors
+            SpirvBinding binding = { decorations.set, decorations.binding, VK_DESCRIPTOR_TYPE_MAX_ENUM, 1, -1 };
+            uint32_t typeId = (*pointer)[2];
+            const std::vector<uint32_t>* type = m_module.FindType(typeId);
+            while (type && ((*type)[0] == OpTypeArray || (*type)[0] == OpTypeRuntimeArray))
+            {
+                if ((*type)[0] == OpTypeRuntimeArray)
+                {
+                    binding.count = 0;
+                }
+                else
+                {
+                    auto length = m_module.constants.find((*type)[2]);
+                    binding.count *= length == m_module.constants.end() ? 1 : length->second;
+                }
+                typeId = (*type)[1];
+                type = m_module.FindType(typeId);
+            }
+            if (!type)
+                continue;
+
+            switch ((*type)[0])
+            {
+            case OpTypeStruct:
+            {
+                const Decorations structDecorations = m_module.GetDecorations(typeId);
+                binding.descriptorType = variable.storageClass == StorageClassUniform && !structDecorations.bufferBlock ?
+                    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                binding.block = AddBlock(typeId, "Set" + std::to_string(binding.set) + "Binding" + std::to_string(binding.binding), error);
+                if (binding.block < 0)
+                    return false;
+                break;
+            }
+            case OpTypeSampledImage: binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; break;
+            case OpTypeSampler: binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER; break;
+            case OpTypeAccelerationStructureKHR: binding.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR; break;
+            case OpTypeImage:
+            {
+                // sampled type, dim, depth, arrayed, ms, sampled
+                const uint32_t dim = (*type)[2];
+                const bool storage = (*type)[6] == 2;
+                if (dim == DimSubpassData)
+                    binding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                else if (dim == DimBuffer)
+                    binding.descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                else
+                    binding.descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                break;
+            }
+            default:
+                continue;
+            }
+            m_reflection.bindings.push_back(binding);
+        }
+
+        std::sort(m_reflection.bindings.begin(), m_reflection.bindings.end(), [](const SpirvBinding& a, const SpirvBinding& b)
+            { return a.set != b.set ? a.set < b.set : a.binding < b.binding; });
+        std::sort(m_reflection.vertexInputs.begin(), m_reflection.vertexInputs.end(), [](const SpirvVertexInput& a, const SpirvVertexInput& b)
+            { return a.location < b.location; });
+        return true;
+    }
+
+    // index of other's block in reflection, added if it isn't there yet
+    int32_t MergeBlock(SpirvReflection& reflection, const SpirvBlock& block, std::string& error)
+    {
+        for (size_t i = 0; i < reflection.blocks.size(); ++i)
+        {
+            if (reflection.blocks[i].name != block.name)
+                continue;
+            if (!SameSpirvBlockLayout(reflection.blocks[i], block))
+            {
+                error = "block " + block.name + " has different layouts";
+                return -1;
+            }
+            return int32_t(i);
+        }
+        reflection.blocks.push_back(block);
+        return int32_t(reflection.blocks.size() - 1);
+    }
+}
+
+bool SameSpirvBlockLayout(const SpirvBlock& a, const SpirvBlock& b)
+{
+    if (a.size != b.size || a.members.size() != b.members.size())
+        return false;
+    for (size_t i = 0; i < a.members.size(); ++i)
+    {
+        const SpirvBlockMember& x = a.members[i];
+        const SpirvBlockMember& y = b.members[i];
+        if (x.name != y.name || x.offset != y.offset || x.size != y.size || x.cppType != y.cppType ||
+            x.arrayLength != y.arrayLength || x.runtimeArray != y.runtimeArray || x.arrayStride != y.arrayStride)
+            return false;
+    }
+    return true;
+}
+
+bool ReflectSpirv(const std::vector<uint32_t>& words, SpirvReflection& reflection, std::string& error)
+{
+    Module module;
+    if (!ParseModule(words, module, error))
+        return false;
+    reflection = {};
+    return Reflector(module, reflection).Reflect(error);
+}
+
+void StripSpirvDebugInfo(std::vector<uint32_t>& words)
+{
+    if (words.size() < SpirvHeaderWords || words[0] != SpirvMagic)
+        return;
+
+    // NonSemantic extended instruction sets only carry debug info (eg. NonSemantic.Shader.DebugInfo.100)
+    std::vector<uint32_t> nonSemanticSets;
+    for (size_t word = SpirvHeaderWords; word < words.size() && (words[word] >> 16); word += words[word] >> 16)
+    {
+        if ((words[word] & 0xFFFF) == OpExtInstImport && ReadString(words, word + 2, word + (words[word] >> 16)).compare(0, 12, "NonSemantic.") == 0)
+            nonSemanticSets.push_back(words[word + 1]);
+    }
+
+    size_t output = SpirvHeaderWords;
+    for (size_t word = SpirvHeaderWords; word < words.size();)
+    {
+        const uint32_t opcode = words[word] & 0xFFFF;
+        const uint32_t count = words[word] >> 16;
+        if (!count || word + count > words.size())
+            break;
+        bool strip = false;
+        switch (opcode)
+        {
+        case OpSourceContinued:
+        case OpSource:
+        case OpSourceExtension:
+        case OpName:
+        case OpMemberName:
+        case OpString:
+        case OpLine:
+        case OpNoLine:
+        case OpModuleProcessed:
+            strip = true;
+            break;
+        case OpExtInstImport:
+            strip = std::find(nonSemanticSets.begin(), nonSemanticSets.end(), words[word + 1]) != nonSemanticSets.end();
+            break;
+        case OpExtInst:
+            strip = count > 3 && std::find(nonSemanticSets.begin(), nonSemanticSets.end(), words[word + 3]) != nonSemanticSets.end();
+            break;
+        default:
+            break;
+        }
+        if (!strip)
+        {
+            std::copy(words.begin() + word, words.begin() + word + count, words.begin() + output);
+            output += count;
+        }
+        word += count;
+    }
+    words.resize(output);
+}
+
+std::string SerializeSpirvReflection(const SpirvReflection& reflection)
+{
+    std::ostringstream ss;
+    for (const SpirvBinding& binding : reflection.bindings)
+    {
+        ss << "binding " << binding.set << " " << binding.binding << " " << uint32_t(binding.descriptorType) << " " << binding.count << " " << binding.block << "\n";
+    }
+    for (const SpirvVertexInput& input : reflection.vertexInputs)
+    {
+        ss << "input " << input.location << " " << uint32_t(input.format) << "\n";
+    }
+    ss << "push " << reflection.pushConstantSize << " " << reflection.pushConstantBlock << "\n";
+    for (const SpirvBlock& block : reflection.blocks)
+    {
+        ss << "block " << block.name << " " << block.size << " " << block.members.size() << "\n";
+        for (const SpirvBlockMember& member : block.members)
+        {
+            ss << "member " << member.name << " " << member.offset << " " << member.size << " " << (member.cppType.empty() ? "-" : member.cppType) << " "
+                << member.arrayLength << " " << member.runtimeArray << " " << member.arrayStride << "\n";
+        }
+    }
+    return ss.str();
+}
+
+bool ParseSpirvReflection(const std::string& text, SpirvReflection& reflection)
+{
+    reflection = {};
+    std::istringstream ss(text);
+    std::string kind;
+    while (ss >> kind)
+    {
+        if (kind == "binding")
+        {
+            SpirvBinding binding = {};
+            uint32_t descriptorType = 0;
+            ss >> binding.set >> binding.binding >> descriptorType >> binding.count >> binding.block;
+            binding.descriptorType = VkDescriptorType(descriptorType);
+            reflection.bindings.push_back(binding);
+        }
+        else if (kind == "input")
+        {
+            SpirvVertexInput input = {};
+            uint32_t format = 0;
+            ss >> input.location >> format;
+            input.format = VkFormat(format);
+            reflection.vertexInputs.push_back(input);
+        }
+        else if (kind == "push")
+        {
+            ss >> reflection.pushConstantSize >> reflection.pushConstantBlock;
+        }
+        else if (kind == "block")
+        {
+            SpirvBlock block = {};
+            size_t memberCount = 0;
+            ss >> block.name >> block.size >> memberCount;
+            for (size_t i = 0; i < memberCount && ss >> kind && kind == "member"; ++i)
+            {
+                SpirvBlockMember member = {};
+                ss >> member.name >> member.offset >> member.size >> member.cppType >> member.arrayLength >> member.runtimeArray >> member.arrayStride;
+                if (member.cppType == "-")
+                    member.cppType.clear();
+                block.members.push_back(member);
+            }
+            if (block.members.size() != memberCount)
+                return false;
+            reflection.blocks.push_back(block);
+        }
+        else
+        {
+            return false;
+        }
+        if (ss.fail())
+            return false;
+    }
+    for (const SpirvBinding& binding : reflection.bindings)
+    {
+        if (binding.block >= int32_t(reflection.blocks.size()))
+            return false;
+    }
+    return reflection.pushConstantBlock < int32_t(reflection.blocks.size());
+}
+
+bool MergeSpirvReflection(SpirvReflection& reflection, const SpirvReflection& other, std::string& error)
+{
+    for (const SpirvBinding& binding : other.bindings)
+    {
+        SpirvBinding merged = binding;
+        if (binding.block >= 0)
+        {
+            merged.block = MergeBlock(reflection, other.blocks[binding.block], error);
+            if (merged.block < 0)
+                return false;
+        }
+        auto existing = std::find_if(reflection.bindings.begin(), reflection.bindings.end(), [&](const SpirvBinding& b)
+            { return b.set == binding.set && b.binding == binding.binding; });
+        if (existing == reflection.bindings.end())
+        {
+            reflection.bindings.push_back(merged);
+            continue;
+        }
+        if (existing->descriptorType != merged.descriptorType || existing->count != merged.count || existing->block != merged.block)
+        {
+            error = "set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) + " is declared differently";
+            return false;
+        }
+    }
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const SpirvBinding& a, const SpirvBinding& b)
+        { return a.set != b.set ? a.set < b.set : a.binding < b.binding; });
+
+    for (const SpirvVertexInput& input : other.vertexInputs)
+    {
+        auto existing = std::find_if(reflection.vertexInputs.begin(), reflection.vertexInputs.end(), [&](const SpirvVertexInput& i)
+            { return i.location == input.location; });
+        if (existing == reflection.vertexInputs.end())
+        {
+            reflection.vertexInputs.push_back(input);
+        }
+        else if (existing->format != input.format)
+        {
+            error = "vertex input at location " + std::to_string(input.location) + " is declared differently";
+            return false;
+        }
+    }
+    std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(), [](const SpirvVertexInput& a, const SpirvVertexInput& b)
+        { return a.location < b.location; });
+
+    if (other.pushConstantBlock >= 0)
+    {
+        const int32_t block = MergeBlock(reflection, other.blocks[other.pushConstantBlock], error);
+        if (block < 0)
+            return false;
+        if (reflection.pushConstantBlock >= 0 && reflection.pushConstantBlock != block)
+        {
+            error = "push constant blocks " + reflection.blocks[reflection.pushConstantBlock].name + " and " + reflection.blocks[block].name + " differ";
+            return false;
+        }
+        reflection.pushConstantBlock = block;
+        reflection.pushConstantSize = other.pushConstantSize;
+    }
+    return true;
+}
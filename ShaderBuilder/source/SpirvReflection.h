@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ShaderIncludes.h"
+
+// the interface of a SPIR-V module, read straight from the binary: descriptor bindings, push constants, vertex
+// inputs and the layout of every buffer block. needs OpName/OpMemberName for the block names, which is why
+// ShaderBuilder always compiles with debug info and strips it afterwards
+struct SpirvBlockMember
+{
+  std::string name;
+  uint32_t offset;
+  uint32_t size;
+  // glm/scalar type with the same layout, empty if there is none (eg. std140 mat3) and the member is kept as bytes
+  std::string cppType;
+  // > 1 for arrays of cppType
+  uint32_t arrayLength;
+  // trailing runtime sized array, size is 0 and arrayStride the size of one element
+  bool runtimeArray;
+  uint32_t arrayStride;
+};
+
+struct SpirvBlock
+{
+  std::string name;
+  // up to the end of the last member, not counting a runtime array
+  uint32_t size;
+  std::vector<SpirvBlockMember> members;
+};
+
+struct SpirvBinding
+{
+  uint32_t set;
+  uint32_t binding;
+  VkDescriptorType descriptorType;
+  // array size, 0 for a runtime sized array
+  uint32_t count;
+  // for uniform and storage buffers, index into SpirvReflection::blocks
+  int32_t block;
+};
+
+struct SpirvVertexInput
+{
+  uint32_t location;
+  VkFormat format;
+};
+
+struct SpirvReflection
+{
+  std::vector<SpirvBinding> bindings;
+  std::vector<SpirvVertexInput> vertexInputs;
+  // 0 without a push constant block
+  uint32_t pushConstantSize = 0;
+  int32_t pushConstantBlock = -1;
+  std::vector<SpirvBlock> blocks;
+};
+
+// returns false with error set if words isn't a module this understands
+bool ReflectSpirv(const std::vector<uint32_t>& words, SpirvReflection& reflection, std::string& error);
+
+// removes OpSource/OpName/OpLine and friends plus NonSemantic debug info, what spirv-opt --strip-debug does
+void StripSpirvDebugInfo(std::vector<uint32_t>& words);
+
+// text form kept next to the .perm files so up to date permutations don't need their .spv reflected again
+std::string SerializeSpirvReflection(const SpirvReflection& reflection);
+bool ParseSpirvReflection(const std::string& text, SpirvReflection& reflection);
+
+bool SameSpirvBlockLayout(const SpirvBlock& a, const SpirvBlock& b);
+
+// adds the bindings, inputs and blocks of other, returns false with error set if they disagree
+bool MergeSpirvReflection(SpirvReflection& reflection, const SpirvReflection& other, std::string& error);
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <sstream>
 #include <filesystem>
+#include <cstring>
 #include "ShaderBuilder.h"
 
 void GenerateDirectory(const char* directory)
@@ -9,18 +10,57 @@ void GenerateDirectory(const char* directory)
     std::filesystem::create_directory(p);
 }
 
+void PrintUsage()
+{
+    std::cout << "usage: ShaderBuilder <shader folder> <intermediate folder> <output folder> [--optimize none|performance|size] [--debug-info] [--hot-reload]\n";
+}
+
 int main(int argc, char* argv[])
 {
     if (argc < 4)
+    {
+        PrintUsage();
         return -1;
+    }
     ShaderBuilder sb;
+    for (int i = 4; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--debug-info"))
+        {
+            sb.SetDebugInfo(true);
+        }
+        else if (!strcmp(argv[i], "--hot-reload"))
+        {
+            sb.SetHotReload(true);
+        }
+        else if (!strcmp(argv[i], "--optimize") && i + 1 < argc && !strcmp(argv[i + 1], "none"))
+        {
+            sb.SetOptimization(ShaderBuilder::Optimization::None);
+            ++i;
+        }
+        else if (!strcmp(argv[i], "--optimize") && i + 1 < argc && !strcmp(argv[i + 1], "performance"))
+        {
+            sb.SetOptimization(ShaderBuilder::Optimization::Performance);
+            ++i;
+        }
+        else if (!strcmp(argv[i], "--optimize") && i + 1 < argc && !strcmp(argv[i + 1], "size"))
+        {
+            sb.SetOptimization(ShaderBuilder::Optimization::Size);
+            ++i;
+        }
+        else
+        {
+            PrintUsage();
+            return -1;
+        }
+    }
     ShaderBuilder::BasePathType** temp;
     temp = new ShaderBuilder::BasePathType * [argc];
     for (int i = 0; i < argc; ++i)
     {
         size_t len = strlen(argv[i]);
         temp[i] = new ShaderBuilder::BasePathType[len + 1];
-        for (int j = 0; j < len + 1; ++j)
+        for (size_t j = 0; j < len + 1; ++j)
         {
             temp[i][j] = argv[i][j];
         }
@@ -4,23 +4,17 @@
 
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
+// per instance, written by the draw list when it merges draws
+layout(location = 2) in uint inObjectIndex;
+// positions are snorm16 within the mesh's bounds, xy scales them back and zw offsets them
+layout(location = 3) in vec4 inPositionScaleBias;
 layout(location = 0) out vec3 fragColor;
 
-// per instance stuff
-// eventual object organisation should be array of structs rather then individual arrays
-layout(binding = 0, set = 0) buffer StorageBuffer {
-	mat4 globalTransform[];
-} sbo;
-
-// probably gonna end up as a camera kind of thing + other per pass stuff
-layout(binding = 0, set = 1) uniform UniformBufferObject {
-    mat4 view;
-    mat4 proj;
-} ubo;
+#include "Include/ObjectData.glslh"
 
 void main() 
 {
-    gl_Position = ubo.proj * ubo.view * sbo.globalTransform[gl_InstanceIndex] * vec4(inPosition, 0.0, 1.0);
+    gl_Position = ubo.proj * ubo.view * sbo.globalTransform[inObjectIndex] * vec4(inPosition * inPositionScaleBias.xy + inPositionScaleBias.zw, 0.0, 1.0);
     fragColor = inColor;
 }
 